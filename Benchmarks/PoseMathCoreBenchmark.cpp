@@ -0,0 +1,251 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseMathCore.h"
+#include "TimelineSearch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace PoseMathCore;
+
+// Times the engine independent pose math without starting Unreal. Run it with
+//
+//   PoseMathCoreBenchmark [--bones=20,100,500,2000] [--iterations=2000]
+//
+// Interpolation, spline interpolation, keyframe search, controller math and export track building are each reported in
+// ns/bone and poses/sec for every skeleton size.
+
+// Keyframes in the benchmark timeline, one per second
+#define BENCHMARK_KEYFRAMES 64
+
+// Frames in the benchmark export, four seconds at 30fps
+#define BENCHMARK_EXPORT_FRAMES 120
+
+namespace
+{
+	typedef std::chrono::steady_clock BenchmarkClock;
+
+	struct BenchmarkPose
+	{
+		PoseView view()
+		{
+			return PoseView{ rotations.data(), translations.data(), (int32_t)rotations.size() };
+		}
+
+		ConstPoseView view() const
+		{
+			return ConstPoseView{ rotations.data(), translations.data(), (int32_t)rotations.size() };
+		}
+
+		std::vector<Quat> rotations;
+		std::vector<Vector3> translations;
+	};
+
+	void makeRandomPose(std::mt19937 &random, int32_t numBones, BenchmarkPose &outPose)
+	{
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> reach(0.0f, 100.0f);
+
+		outPose.rotations.resize(numBones);
+		outPose.translations.resize(numBones);
+		for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			outPose.rotations[boneIndex] = normalized(Quat{ component(random), component(random), component(random), component(random) });
+			outPose.translations[boneIndex] = safeNormal(Vector3{ component(random), component(random), component(random) }) * reach(random);
+		}
+	}
+
+	double secondsSince(const BenchmarkClock::time_point &startTime)
+	{
+		return std::chrono::duration<double>(BenchmarkClock::now() - startTime).count();
+	}
+
+	void reportResult(const char *benchmarkName, int32_t numBones, double seconds, int32_t numPoses)
+	{
+		double nanosecondsPerBone = seconds * 1e9 / ((double)numPoses * numBones);
+		double posesPerSecond = numPoses / seconds;
+		std::printf("%-24s %5d bones %10.2f ns/bone %14.1f poses/sec\n", benchmarkName, numBones, nanosecondsPerBone, posesPerSecond);
+	}
+
+	// The value of a --name=value argument, or null if it wasn't passed
+	const char *findArgument(int argc, char **argv, const char *name)
+	{
+		const size_t nameLength = std::strlen(name);
+		for (int argumentIndex = 1; argumentIndex < argc; argumentIndex++)
+		{
+			if (std::strncmp(argv[argumentIndex], name, nameLength) == 0)
+			{
+				return argv[argumentIndex] + nameLength;
+			}
+		}
+		return nullptr;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::string boneCountList = "20,100,500,2000";
+	if (const char *bonesArgument = findArgument(argc, argv, "--bones="))
+	{
+		boneCountList = bonesArgument;
+	}
+
+	int32_t iterations = 2000;
+	if (const char *iterationsArgument = findArgument(argc, argv, "--iterations="))
+	{
+		iterations = std::atoi(iterationsArgument);
+	}
+	iterations = iterations > 1 ? iterations : 1;
+
+	// Everything the benchmarks produce is folded into this and printed, so none of the work can be optimized away
+	double checksum = 0.0;
+	std::mt19937 random(1234);
+
+	size_t listStart = 0;
+	while (listStart < boneCountList.size())
+	{
+		size_t listEnd = boneCountList.find(',', listStart);
+		listEnd = listEnd == std::string::npos ? boneCountList.size() : listEnd;
+		const int32_t numBones = std::atoi(boneCountList.substr(listStart, listEnd - listStart).c_str());
+		listStart = listEnd + 1;
+		if (numBones <= 0)
+		{
+			continue;
+		}
+
+		std::vector<BenchmarkPose> keyFrames(BENCHMARK_KEYFRAMES);
+		std::vector<float> keyFrameTimes(BENCHMARK_KEYFRAMES);
+		for (int32_t keyFrameIndex = 0; keyFrameIndex < BENCHMARK_KEYFRAMES; keyFrameIndex++)
+		{
+			makeRandomPose(random, numBones, keyFrames[keyFrameIndex]);
+			keyFrameTimes[keyFrameIndex] = (float)keyFrameIndex;
+		}
+
+		BenchmarkPose blendedPose;
+		makeRandomPose(random, numBones, blendedPose);
+
+		// Interpolating between two poses
+		{
+			BenchmarkClock::time_point startTime = BenchmarkClock::now();
+			for (int32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				blendTwoPoses(keyFrames[0].view(), keyFrames[1].view(), (float)iteration / iterations, blendedPose.view());
+			}
+			reportResult("Interpolation", numBones, secondsSince(startTime), iterations);
+			checksum += blendedPose.rotations[0].x;
+		}
+
+		// Spline interpolation between two keys with their tangents already worked out, the way playback uses it
+		{
+			BenchmarkPose firstTangents = keyFrames[1];
+			BenchmarkPose secondTangents = keyFrames[2];
+			const ConstPoseView firstView = keyFrames[0].view();
+			const ConstPoseView secondView = keyFrames[1].view();
+			const ConstPoseView thirdView = keyFrames[2].view();
+			const ConstPoseView fourthView = keyFrames[3].view();
+			computeSplineTangents(&firstView, 0.0f, secondView, 1.0f, &thirdView, 2.0f, firstTangents.view());
+			computeSplineTangents(&secondView, 1.0f, thirdView, 2.0f, &fourthView, 3.0f, secondTangents.view());
+
+			BenchmarkClock::time_point startTime = BenchmarkClock::now();
+			for (int32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				splineBlendPoses(secondView, firstTangents.view(), thirdView, secondTangents.view(), (float)iteration / iterations, 1.0f, blendedPose.view());
+			}
+			reportResult("Spline interpolation", numBones, secondsSince(startTime), iterations);
+			checksum += blendedPose.rotations[0].y;
+
+			startTime = BenchmarkClock::now();
+			for (int32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				computeSplineTangents(&firstView, 0.0f, secondView, 1.0f, &thirdView, 2.0f, firstTangents.view());
+			}
+			reportResult("Spline tangents", numBones, secondsSince(startTime), iterations);
+			checksum += firstTangents.rotations[0].z;
+		}
+
+		// Keyframe search doesn't depend on the number of bones, so report it per lookup
+		{
+			auto getTime = [&keyFrameTimes](int32_t keyFrameIndex) { return keyFrameTimes[keyFrameIndex]; };
+			std::uniform_real_distribution<float> scrubTime(0.0f, (float)BENCHMARK_KEYFRAMES);
+			const int32_t numLookups = iterations * 100;
+			int32_t cursor = 0;
+
+			BenchmarkClock::time_point startTime = BenchmarkClock::now();
+			for (int32_t lookup = 0; lookup < numLookups; lookup++)
+			{
+				cursor = moveCursor(cursor, BENCHMARK_KEYFRAMES, (float)lookup / numLookups * BENCHMARK_KEYFRAMES, getTime);
+				checksum += cursor;
+			}
+			double playbackSeconds = secondsSince(startTime);
+
+			std::vector<float> scrubTimes(numLookups);
+			for (float &time : scrubTimes)
+			{
+				time = scrubTime(random);
+			}
+
+			startTime = BenchmarkClock::now();
+			for (int32_t lookup = 0; lookup < numLookups; lookup++)
+			{
+				cursor = moveCursor(cursor, BENCHMARK_KEYFRAMES, scrubTimes[lookup], getTime);
+				checksum += cursor;
+			}
+			double scrubSeconds = secondsSince(startTime);
+
+			std::printf("%-24s %5d bones %10.2f ns/lookup playing, %.2f ns/lookup scrubbing\n", "Keyframe search", numBones,
+				playbackSeconds * 1e9 / numLookups, scrubSeconds * 1e9 / numLookups);
+		}
+
+		// Dragging every bone of the skeleton once per pose
+		{
+			const BenchmarkPose &startingPose = keyFrames[0];
+			const Vector3 startingDirection{ 1.0f, 0.0f, 0.0f };
+
+			BenchmarkClock::time_point startTime = BenchmarkClock::now();
+			for (int32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+				{
+					Vector3 currentDirection = safeNormal(startingPose.translations[boneIndex]);
+					checksum += dragBoneRotation(startingPose.rotations[boneIndex], startingDirection, currentDirection, 0.1f).w;
+				}
+			}
+			reportResult("Bone drag rotation", numBones, secondsSince(startTime), iterations);
+		}
+
+		// Building export tracks, counted per exported frame
+		{
+			std::vector<ConstPoseView> exportPoses(BENCHMARK_EXPORT_FRAMES);
+			for (int32_t frameIndex = 0; frameIndex < BENCHMARK_EXPORT_FRAMES; frameIndex++)
+			{
+				exportPoses[frameIndex] = keyFrames[frameIndex % BENCHMARK_KEYFRAMES].view();
+			}
+
+			std::vector<Vector3> positionKeys(BENCHMARK_EXPORT_FRAMES);
+			std::vector<Quat> rotationKeys(BENCHMARK_EXPORT_FRAMES);
+			const int32_t exportIterations = iterations / 100 > 3 ? iterations / 100 : 3;
+
+			BenchmarkClock::time_point startTime = BenchmarkClock::now();
+			for (int32_t iteration = 0; iteration < exportIterations; iteration++)
+			{
+				for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+				{
+					gatherBoneTrack(exportPoses.data(), BENCHMARK_EXPORT_FRAMES, boneIndex, positionKeys.data(), rotationKeys.data());
+
+					float maxError;
+					checksum += isConstantPositionTrack(positionKeys.data(), BENCHMARK_EXPORT_FRAMES, 0.01f, maxError) ? 1.0 : 0.0;
+					checksum += isConstantRotationTrack(rotationKeys.data(), BENCHMARK_EXPORT_FRAMES, 0.1f, maxError) ? 1.0 : 0.0;
+				}
+			}
+			reportResult("Export track building", numBones, secondsSince(startTime), exportIterations * BENCHMARK_EXPORT_FRAMES);
+		}
+	}
+
+	std::printf("Benchmark checksum %f\n", checksum);
+	return 0;
+}
@@ -9,6 +9,6 @@ public class PoseCreatorTarget : TargetRules
     {
 		Type = TargetType.Game;
 
-        ExtraModuleNames.AddRange(new string[] { "PoseCreator" });
+        ExtraModuleNames.AddRange(new string[] { "PoseCreator", "PoseMathCore" });
     }
 }
@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "AnimationExporter.h"
+#include "AssetRegistryModule.h"
+#include "../AssetTools/Public/AssetToolsModule.h"
+#include "ModuleManager.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Animation/AnimCompress_RemoveLinearKeys.h"
+#include "PoseCreatorStats.h"
+
+namespace
+{
+	FORCEINLINE float positionError(const FVector &first, const FVector &second)
+	{
+		return FVector::Dist(first, second);
+	}
+
+	FORCEINLINE float rotationErrorDegrees(const FQuat &first, const FQuat &second)
+	{
+		return FMath::RadiansToDegrees(first.AngularDistance(second));
+	}
+
+	// Collapse a constant track to a single key. Every other track keeps a key per frame, raw tracks can't hold anything
+	// in between, so the linear key removal is left to the compression.
+	template<typename KeyType>
+	void reduceTrack(TArray<KeyType> &keys, bool isConstant, float trackError, FKeyReductionStats &stats, float &maxError)
+	{
+		stats.rawKeys += keys.Num();
+
+		if (isConstant)
+		{
+			keys.SetNum(1);
+			stats.constantTracks++;
+			maxError = FMath::Max(maxError, trackError);
+		}
+
+		stats.keptKeys += keys.Num();
+	}
+
+#if WITH_EDITORONLY_DATA
+	// Replace the kept key counts and errors with what the compressed sequence actually holds. The key counts come from
+	// the compressed track offsets and the errors from sampling the compressed tracks at every frame against the poses.
+	void measureCompressedKeys(const FAnimationExportSnapshot &snapshot, UAnimSequence *sequence, FKeyReductionStats &stats)
+	{
+		const int32 numTracks = snapshot.boneNames.Num();
+		const int32 numFrames = snapshot.poses.Num();
+
+		// Only the key lerp formats store a key count per track
+		if (sequence->KeyEncodingFormat == AKF_PerTrackCompression || sequence->CompressedTrackOffsets.Num() != numTracks * 4)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Couldn't read the key counts back from the compressed animation!!"));
+			return;
+		}
+
+		stats.keptKeys = 0;
+		stats.maxPositionError = 0.0f;
+		stats.maxAngleErrorDegrees = 0.0f;
+
+		// Each track stores its translation offset and key count followed by its rotation offset and key count
+		for (int32 trackIndex = 0; trackIndex < numTracks; trackIndex++)
+		{
+			stats.keptKeys += sequence->CompressedTrackOffsets[trackIndex * 4 + 1] + sequence->CompressedTrackOffsets[trackIndex * 4 + 3];
+		}
+
+		const float frameInterval = numFrames > 1 ? sequence->SequenceLength / (numFrames - 1) : 0.0f;
+		for (int32 frameIndex = 0; frameIndex < numFrames; frameIndex++)
+		{
+			const FPoseBuffer &pose = snapshot.poses[frameIndex];
+			for (int32 trackIndex = 0; trackIndex < numTracks; trackIndex++)
+			{
+				FTransform compressedTransform;
+				sequence->GetBoneTransform(compressedTransform, trackIndex, frameIndex * frameInterval, false);
+				stats.maxPositionError = FMath::Max(stats.maxPositionError, positionError(compressedTransform.GetTranslation(), pose.translations[trackIndex]));
+				stats.maxAngleErrorDegrees = FMath::Max(stats.maxAngleErrorDegrees, rotationErrorDegrees(compressedTransform.GetRotation(), pose.rotations[trackIndex]));
+			}
+		}
+	}
+#endif
+}
+
+void AnimationExporter::buildTracks(const FAnimationExportSnapshot &snapshot, TArray<FRawAnimSequenceTrack> &outTracks, FKeyReductionStats &outStats)
+{
+	const int32 numBones = snapshot.boneNames.Num();
+	const int32 numFrames = snapshot.poses.Num();
+	const FKeyReductionSettings &keyReduction = snapshot.keyReduction;
+
+	outTracks.SetNum(numBones);
+
+	// Each bone reports its own stats so the workers never have to share anything
+	TArray<FKeyReductionStats> boneStats;
+	boneStats.SetNum(numBones);
+
+	TArray<PoseMathCore::ConstPoseView> poseViews;
+	poseViews.Reserve(numFrames);
+	for (const FPoseBuffer &pose : snapshot.poses)
+	{
+		poseViews.Add(pose.view());
+	}
+
+	// Every bone's track is independent, so each worker fills whole tracks into buffers sized up front
+	ParallelFor(numBones, [&snapshot, &poseViews, &outTracks, &boneStats, &keyReduction, numFrames](int32 boneIndex)
+	{
+		FRawAnimSequenceTrack &rawTrack = outTracks[boneIndex];
+		rawTrack.PosKeys.SetNumUninitialized(numFrames);
+		rawTrack.RotKeys.SetNumUninitialized(numFrames);
+
+		PoseMathCore::Vector3 *positionKeys = reinterpret_cast<PoseMathCore::Vector3 *>(rawTrack.PosKeys.GetData());
+		PoseMathCore::Quat *rotationKeys = reinterpret_cast<PoseMathCore::Quat *>(rawTrack.RotKeys.GetData());
+		PoseMathCore::gatherBoneTrack(poseViews.GetData(), numFrames, boneIndex, positionKeys, rotationKeys);
+
+		// Poses don't record scale, so it never changes over the animation
+		rawTrack.ScaleKeys.Add(snapshot.boneScales[boneIndex]);
+
+		if (keyReduction.enabled)
+		{
+			FKeyReductionStats &stats = boneStats[boneIndex];
+			float trackError;
+			bool isConstant = PoseMathCore::isConstantPositionTrack(positionKeys, numFrames, keyReduction.maxPositionError, trackError);
+			reduceTrack(rawTrack.PosKeys, isConstant, trackError, stats, stats.maxPositionError);
+			isConstant = PoseMathCore::isConstantRotationTrack(rotationKeys, numFrames, keyReduction.maxAngleErrorDegrees, trackError);
+			reduceTrack(rawTrack.RotKeys, isConstant, trackError, stats, stats.maxAngleErrorDegrees);
+		}
+		else
+		{
+			boneStats[boneIndex].rawKeys = numFrames * 2;
+			boneStats[boneIndex].keptKeys = numFrames * 2;
+		}
+	});
+
+	outStats = FKeyReductionStats();
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		outStats.accumulate(boneStats[boneIndex]);
+	}
+}
+
+UAnimSequence *AnimationExporter::createAnimationAsset(const FAnimationExportSnapshot &snapshot, TArray<FRawAnimSequenceTrack> &&tracks,
+	FKeyReductionStats &inOutStats)
+{
+	check(IsInGameThread());
+
+	USkeleton *skeleton = snapshot.skeleton.Get();
+	if (skeleton == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("The skeleton went away before the animation could be created!!"));
+		return nullptr;
+	}
+
+	// Generate an animation asset
+	FString Name;
+	FString PackageName;
+	FAssetToolsModule& AssetToolsModule = FModuleManager::Get().LoadModuleChecked<FAssetToolsModule>("AssetTools");
+	if (snapshot.assetPackageName.IsEmpty())
+	{
+		AssetToolsModule.Get().CreateUniqueAssetName(skeleton->GetOutermost()->GetName(), TEXT("_GeneratedAnimation"), PackageName, Name);
+	}
+	else
+	{
+		AssetToolsModule.Get().CreateUniqueAssetName(snapshot.assetPackageName, TEXT(""), PackageName, Name);
+	}
+	UAnimationAsset* NewAsset = Cast<UAnimationAsset>(AssetToolsModule.Get().CreateAsset(Name, FPackageName::GetLongPackagePath(PackageName),
+		UAnimSequence::StaticClass(), NULL));
+
+	if (!NewAsset)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Animation could not be created!!"));
+		return nullptr;
+	}
+
+	// Assign a skeletal mesh to the animation
+	NewAsset->SetSkeleton(skeleton);
+	NewAsset->MarkPackageDirty();
+
+	UAnimSequence* NewAnimSequence = Cast<UAnimSequence>(NewAsset);
+
+	if (!NewAnimSequence)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Animation could not be converted to an anim sequence!!"));
+		return nullptr;
+	}
+
+	const int32 NumBones = snapshot.boneNames.Num();
+
+	// Initialize some data for the animation sequence
+	NewAnimSequence->NumFrames = snapshot.poses.Num();
+	NewAnimSequence->SequenceLength = snapshot.poses.Num();
+	NewAnimSequence->RawAnimationData = MoveTemp(tracks);
+	NewAnimSequence->AnimationTrackNames = snapshot.boneNames;
+
+	// The tracks are built straight from the skeleton's bones, so track i always maps to bone i of the skeleton
+	NewAnimSequence->TrackToSkeletonMapTable.Empty(NumBones);
+	NewAnimSequence->TrackToSkeletonMapTable.AddUninitialized(NumBones);
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		NewAnimSequence->TrackToSkeletonMapTable[BoneIndex].BoneTreeIndex = BoneIndex;
+	}
+
+#if WITH_EDITORONLY_DATA
+	// Raw tracks have to keep a key for every frame unless they're constant, so the keys between those are removed
+	// by compressing with linear key removal held to the same tolerances
+	if (snapshot.keyReduction.enabled)
+	{
+		UAnimCompress_RemoveLinearKeys *compressionScheme = NewObject<UAnimCompress_RemoveLinearKeys>(NewAnimSequence);
+		compressionScheme->MaxPosDiff = snapshot.keyReduction.maxPositionError;
+		// The compressor measures rotations with FQuat::Error, which is the angle between them as a fraction of a full turn
+		compressionScheme->MaxAngleDiff = snapshot.keyReduction.maxAngleErrorDegrees / 360.0f;
+		NewAnimSequence->CompressionScheme = compressionScheme;
+	}
+#endif
+
+	// Should recreate track map
+	NewAnimSequence->PostProcessSequence();
+
+#if WITH_EDITORONLY_DATA
+	if (snapshot.keyReduction.enabled)
+	{
+		measureCompressedKeys(snapshot, NewAnimSequence, inOutStats);
+		if (inOutStats.maxPositionError > snapshot.keyReduction.maxPositionError || inOutStats.maxAngleErrorDegrees > snapshot.keyReduction.maxAngleErrorDegrees)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Compressed animation is off by up to %.4f units and %.4f degrees, more than the %.4f units and %.4f degrees allowed!!"),
+				inOutStats.maxPositionError, inOutStats.maxAngleErrorDegrees, snapshot.keyReduction.maxPositionError, snapshot.keyReduction.maxAngleErrorDegrees);
+		}
+	}
+#endif
+
+	// Flag UE4 that the animation has been created so that it will be recognized/able to be saved
+	FAssetRegistryModule::AssetCreated(NewAsset);
+
+	return NewAnimSequence;
+}
+
+void AnimationExporter::exportAsync(FAnimationExportSnapshot &&snapshot, FOnAnimationExported onComplete)
+{
+	// The snapshot is shared between the worker and the game thread halves of the export
+	TSharedRef<FAnimationExportSnapshot, ESPMode::ThreadSafe> sharedSnapshot = MakeShareable(new FAnimationExportSnapshot(MoveTemp(snapshot)));
+
+	AsyncTask(ENamedThreads::AnyThread, [sharedSnapshot, onComplete]()
+	{
+		TSharedRef<TArray<FRawAnimSequenceTrack>, ESPMode::ThreadSafe> tracks = MakeShareable(new TArray<FRawAnimSequenceTrack>());
+		TSharedRef<FKeyReductionStats, ESPMode::ThreadSafe> stats = MakeShareable(new FKeyReductionStats());
+		{
+			POSECREATOR_SCOPE_TIMING_FOR_FRAME(ExportTracks, sharedSnapshot->startFrame);
+			buildTracks(*sharedSnapshot, *tracks, *stats);
+		}
+
+		// Assets can only be created on the game thread
+		AsyncTask(ENamedThreads::GameThread, [sharedSnapshot, tracks, stats, onComplete]()
+		{
+			UAnimSequence *animation;
+			{
+				POSECREATOR_SCOPE_TIMING_FOR_FRAME(ExportAsset, sharedSnapshot->startFrame);
+				animation = createAnimationAsset(*sharedSnapshot, MoveTemp(*tracks), *stats);
+			}
+			onComplete.ExecuteIfBound(animation, *stats);
+		});
+	});
+}
@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+#include "Animation/AnimSequence.h"
+
+// How far the exported tracks are allowed to drift from the recorded poses when redundant keys are removed
+struct FKeyReductionSettings
+{
+	FKeyReductionSettings() :
+		enabled(true),
+		maxPositionError(0.01f),
+		maxAngleErrorDegrees(0.1f)
+	{
+	}
+
+	bool enabled;
+
+	// In world units
+	float maxPositionError;
+
+	float maxAngleErrorDegrees;
+};
+
+// What key reduction did to an export
+struct FKeyReductionStats
+{
+	FKeyReductionStats() :
+		rawKeys(0),
+		keptKeys(0),
+		constantTracks(0),
+		maxPositionError(0.0f),
+		maxAngleErrorDegrees(0.0f)
+	{
+	}
+
+	// Position and rotation keys recorded, and the keys left once the animation has been compressed
+	int32 rawKeys;
+	int32 keptKeys;
+
+	// Position and rotation tracks collapsed down to a single key
+	int32 constantTracks;
+
+	// The largest difference between the compressed animation and the recorded poses
+	float maxPositionError;
+	float maxAngleErrorDegrees;
+
+	float getCompressionRatio() const
+	{
+		return keptKeys > 0 ? (float)rawKeys / keptKeys : 1.0f;
+	}
+
+	void accumulate(const FKeyReductionStats &otherStats)
+	{
+		rawKeys += otherStats.rawKeys;
+		keptKeys += otherStats.keptKeys;
+		constantTracks += otherStats.constantTracks;
+		maxPositionError = FMath::Max(maxPositionError, otherStats.maxPositionError);
+		maxAngleErrorDegrees = FMath::Max(maxAngleErrorDegrees, otherStats.maxAngleErrorDegrees);
+	}
+};
+
+// Called on the game thread once an export has finished, the animation is null if the export failed
+DECLARE_DELEGATE_TwoParams(FOnAnimationExported, UAnimSequence *, const FKeyReductionStats &);
+
+// Everything the exporter needs from the actor, copied so the export can run while the user keeps posing
+struct FAnimationExportSnapshot
+{
+	FAnimationExportSnapshot() :
+		startFrame(GFrameCounter)
+	{
+	}
+
+	// The skeleton the animation is made for
+	TWeakObjectPtr<USkeleton> skeleton;
+
+	// The name of each bone, in the same order as the poses
+	TArray<FName> boneNames;
+
+	// The scale of each bone, poses don't store scale so it's held constant over the animation
+	TArray<FVector> boneScales;
+
+	// The poses to write out, one per frame
+	TArray<FPoseBuffer> poses;
+
+	// How much error removing redundant keys may introduce
+	FKeyReductionSettings keyReduction;
+
+	// Long package name the asset is created under, made unique if it's taken. Empty puts a generated name next to
+	// the skeleton.
+	FString assetPackageName;
+
+	// The frame the snapshot was taken on, the export's timings are filed under it however late they finish
+	uint64 startFrame;
+};
+
+// Turns recorded poses into animation sequence assets. The per-bone tracks are built in parallel on worker threads,
+// only creating and registering the asset happens on the game thread.
+namespace AnimationExporter
+{
+	// Build one raw track per bone from the poses, spread across worker threads. Tracks that stay within the
+	// reduction tolerance for the whole animation are collapsed to a single key.
+	void buildTracks(const FAnimationExportSnapshot &snapshot, TArray<FRawAnimSequenceTrack> &outTracks, FKeyReductionStats &outStats);
+
+	// Create and register an animation sequence asset from prebuilt tracks, must be called on the game thread.
+	// When key reduction is on, the sequence is compressed with linear key removal using the same tolerances, and the
+	// kept keys and errors in the stats are measured from the compressed result.
+	UAnimSequence *createAnimationAsset(const FAnimationExportSnapshot &snapshot, TArray<FRawAnimSequenceTrack> &&tracks,
+		FKeyReductionStats &inOutStats);
+
+	// Build the tracks in the background and create the asset back on the game thread, then call the completion delegate
+	void exportAsync(FAnimationExportSnapshot &&snapshot, FOnAnimationExported onComplete);
+}
@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "BonePicker.h"
+
+// Keep the number of grid cells in proportion to the number of bones so a stretched out skeleton can't blow up the grid
+#define MIN_GRID_CELLS 64
+#define GRID_CELLS_PER_BONE 4
+
+FBonePicker::FBonePicker() :
+	preferredCellSize(10.0f),
+	cellSize(10.0f),
+	gridOrigin(FVector::ZeroVector),
+	gridDimensions(0, 0, 0)
+{
+}
+
+void FBonePicker::setCellSize(float newCellSize)
+{
+	preferredCellSize = FMath::Max(newCellSize, KINDA_SMALL_NUMBER);
+}
+
+FIntVector FBonePicker::getCellCoordinates(const FVector &position) const
+{
+	FVector gridPosition = (position - gridOrigin) / cellSize;
+	return FIntVector(
+		FMath::Clamp(FMath::FloorToInt(gridPosition.X), 0, gridDimensions.X - 1),
+		FMath::Clamp(FMath::FloorToInt(gridPosition.Y), 0, gridDimensions.Y - 1),
+		FMath::Clamp(FMath::FloorToInt(gridPosition.Z), 0, gridDimensions.Z - 1));
+}
+
+void FBonePicker::rebuild(const TArray<FVector> &bonePositions)
+{
+	const int32 numBones = bonePositions.Num();
+	if (numBones == 0)
+	{
+		gridDimensions = FIntVector(0, 0, 0);
+		cellStarts.Reset();
+		sortedBoneIndices.Reset();
+		sortedBonePositions.Reset();
+		return;
+	}
+
+	FBox bounds(bonePositions.GetData(), numBones);
+	FVector extent = bounds.GetSize();
+
+	// Grow the cells until the grid fits in its cell budget
+	const int32 maxCells = FMath::Max(MIN_GRID_CELLS, numBones * GRID_CELLS_PER_BONE);
+	cellSize = preferredCellSize;
+	for (;;)
+	{
+		gridDimensions = FIntVector(
+			FMath::FloorToInt(extent.X / cellSize) + 1,
+			FMath::FloorToInt(extent.Y / cellSize) + 1,
+			FMath::FloorToInt(extent.Z / cellSize) + 1);
+
+		if ((int64)gridDimensions.X * gridDimensions.Y * gridDimensions.Z <= maxCells)
+		{
+			break;
+		}
+		cellSize *= 2.0f;
+	}
+	gridOrigin = bounds.Min;
+
+	// Counting sort the bones into their cells. Each cell first counts its bones, the running sum then turns that into
+	// the end of the cell, and filling the cells from their ends leaves every entry pointing at the start of its cell.
+	const int32 numCells = gridDimensions.X * gridDimensions.Y * gridDimensions.Z;
+	cellStarts.Reset();
+	cellStarts.AddZeroed(numCells + 1);
+	boneCells.SetNumUninitialized(numBones, false);
+
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		int32 cellIndex = getCellIndex(getCellCoordinates(bonePositions[boneIndex]));
+		boneCells[boneIndex] = cellIndex;
+		cellStarts[cellIndex]++;
+	}
+
+	for (int32 cellIndex = 1; cellIndex < numCells; cellIndex++)
+	{
+		cellStarts[cellIndex] += cellStarts[cellIndex - 1];
+	}
+	cellStarts[numCells] = numBones;
+
+	sortedBoneIndices.SetNumUninitialized(numBones, false);
+	sortedBonePositions.SetNumUninitialized(numBones, false);
+
+	// Walk the bones backwards so the bones within a cell stay in skeleton order
+	for (int32 boneIndex = numBones - 1; boneIndex >= 0; boneIndex--)
+	{
+		int32 sortedIndex = --cellStarts[boneCells[boneIndex]];
+		sortedBoneIndices[sortedIndex] = boneIndex;
+		sortedBonePositions[sortedIndex] = bonePositions[boneIndex];
+	}
+}
+
+template<typename VisitorType>
+void FBonePicker::forEachBoneInRadius(const FVector &point, float radius, VisitorType visitor) const
+{
+	if (sortedBoneIndices.Num() == 0)
+	{
+		return;
+	}
+
+	// Skip the query if the sphere doesn't touch the grid at all
+	FVector gridMax = gridOrigin + FVector(gridDimensions) * cellSize;
+	if (point.X + radius < gridOrigin.X || point.Y + radius < gridOrigin.Y || point.Z + radius < gridOrigin.Z ||
+		point.X - radius > gridMax.X || point.Y - radius > gridMax.Y || point.Z - radius > gridMax.Z)
+	{
+		return;
+	}
+
+	const FIntVector minCell = getCellCoordinates(point - FVector(radius));
+	const FIntVector maxCell = getCellCoordinates(point + FVector(radius));
+	const float radiusSquared = radius * radius;
+
+	for (int32 z = minCell.Z; z <= maxCell.Z; z++)
+	{
+		for (int32 y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			// Cells along x are next to each other, so the whole row is one contiguous range of bones
+			int32 rowStart = cellStarts[getCellIndex(FIntVector(minCell.X, y, z))];
+			int32 rowEnd = cellStarts[getCellIndex(FIntVector(maxCell.X, y, z)) + 1];
+
+			for (int32 sortedIndex = rowStart; sortedIndex < rowEnd; sortedIndex++)
+			{
+				float distanceSquared = FVector::DistSquared(point, sortedBonePositions[sortedIndex]);
+				if (distanceSquared <= radiusSquared)
+				{
+					visitor(sortedBoneIndices[sortedIndex], distanceSquared);
+				}
+			}
+		}
+	}
+}
+
+int32 FBonePicker::findNearestBone(const FVector &point, float radius) const
+{
+	int32 nearestBoneIndex = INDEX_NONE;
+	float nearestDistanceSquared = MAX_flt;
+
+	forEachBoneInRadius(point, radius, [&](int32 boneIndex, float distanceSquared)
+	{
+		// Ties go to the bone that comes first in the skeleton so picking is stable from frame to frame
+		if (distanceSquared < nearestDistanceSquared || (distanceSquared == nearestDistanceSquared && boneIndex < nearestBoneIndex))
+		{
+			nearestDistanceSquared = distanceSquared;
+			nearestBoneIndex = boneIndex;
+		}
+	});
+
+	return nearestBoneIndex;
+}
+
+void FBonePicker::findBonesInRadius(const FVector &point, float radius, TArray<int32> &outBoneIndices) const
+{
+	outBoneIndices.Reset();
+
+	forEachBoneInRadius(point, radius, [&](int32 boneIndex, float distanceSquared)
+	{
+		outBoneIndices.Add(boneIndex);
+	});
+}
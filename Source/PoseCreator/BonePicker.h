@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseCreator.h"
+
+// Uniform grid over the bone positions of a skeleton, used to find the bones near the controllers without any
+// collision or overlap events. The grid is cheap enough to rebuild every frame after the pose has been updated.
+class FBonePicker
+{
+public:
+	FBonePicker();
+
+	// The preferred size of a grid cell, the grid grows its cells when the bones are spread too far apart for it
+	void setCellSize(float newCellSize);
+
+	// Rebuild the grid over the given bone positions, memory is reused between rebuilds
+	void rebuild(const TArray<FVector> &bonePositions);
+
+	// The closest bone within the radius of the point, INDEX_NONE if there isn't one
+	int32 findNearestBone(const FVector &point, float radius) const;
+
+	// Every bone within the radius of the point
+	void findBonesInRadius(const FVector &point, float radius, TArray<int32> &outBoneIndices) const;
+
+private:
+	// Call the visitor with the index and squared distance of every bone within the radius of the point
+	template<typename VisitorType>
+	void forEachBoneInRadius(const FVector &point, float radius, VisitorType visitor) const;
+
+	FIntVector getCellCoordinates(const FVector &position) const;
+
+	int32 getCellIndex(const FIntVector &cellCoordinates) const
+	{
+		return (cellCoordinates.Z * gridDimensions.Y + cellCoordinates.Y) * gridDimensions.X + cellCoordinates.X;
+	}
+
+	// The requested cell size and the one the current grid was actually built with
+	float preferredCellSize;
+	float cellSize;
+
+	// Where the grid starts and how many cells it has along each axis
+	FVector gridOrigin;
+	FIntVector gridDimensions;
+
+	// For each cell, where its bones start in sortedBoneIndices, with one extra entry marking the end of the last cell
+	TArray<int32> cellStarts;
+
+	// Bone indices grouped by cell, with their positions stored in the same order
+	TArray<int32> sortedBoneIndices;
+	TArray<FVector> sortedBonePositions;
+
+	// The cell each bone landed in during the last rebuild
+	TArray<int32> boneCells;
+};
@@ -1,28 +1,22 @@
 #pragma once
 
 #include "PoseCreator.h"
+#include "PoseBuffer.h"
+#include "PoseQuantization.h"
 #include "DataStructures.generated.h"
 
-USTRUCT()
-struct FBoneInfo
-{
-	GENERATED_BODY()
-
-	UPROPERTY()
-	FRotator rotation;
-	UPROPERTY()
-	FVector position;
-	UPROPERTY()
-	FName name;
-};
-
 USTRUCT()
 struct FKeyFrame
 {
 	GENERATED_BODY()
 
-	UPROPERTY()
-	TArray<FBoneInfo> boneTransforms;
+	// The pose of the skeleton at this keyframe, empty while the timeline stores quantized keyframes
+	FPoseBuffer pose;
+	// The pose packed down, only filled in while the timeline stores quantized keyframes
+	FQuantizedPose quantizedPose;
+	// Spline tangents of the pose, only filled in while a full precision timeline is interpolating with splines.
+	// Quantized timelines work them out from the neighbouring keys instead
+	FPoseBuffer tangents;
 	UPROPERTY()
 	float keyFrameTime;
-};
\ No newline at end of file
+};
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "IKChainSolver.h"
+
+namespace
+{
+	// Turn a direction toward a desired one, going no further than the maximum angle
+	FVector limitDirection(const FVector &referenceDirection, const FVector &desiredDirection, float maxAngleRadians)
+	{
+		float cosAngle = FVector::DotProduct(referenceDirection, desiredDirection);
+		if (cosAngle >= FMath::Cos(maxAngleRadians))
+		{
+			return desiredDirection;
+		}
+
+		FVector rotationAxis = FVector::CrossProduct(referenceDirection, desiredDirection).GetSafeNormal();
+		if (rotationAxis.IsZero())
+		{
+			// The directions are opposite, any axis perpendicular to the reference will do
+			FVector unusedAxis;
+			referenceDirection.FindBestAxisVectors(rotationAxis, unusedAxis);
+		}
+		return FQuat(rotationAxis, maxAngleRadians).RotateVector(referenceDirection);
+	}
+}
+
+FIKChainSolver::FIKChainSolver() :
+	chainLength(0.0f),
+	hasPreviousSolution(false),
+	lastError(0.0f)
+{
+}
+
+bool FIKChainSolver::setChain(const FPoseableBoneHandles &boneHandles, int32 endBoneIndex, int32 numChainBones)
+{
+	clearChain();
+
+	// Walk up from the end bone, then flip the chain around so it runs from its base
+	int32 boneIndex = endBoneIndex;
+	chainBones.Add(boneIndex);
+	for (int32 chainIndex = 0; chainIndex < numChainBones; chainIndex++)
+	{
+		boneIndex = boneHandles.getParentIndex(boneIndex);
+		if (boneIndex == INDEX_NONE)
+		{
+			break;
+		}
+		chainBones.Add(boneIndex);
+	}
+
+	if (!hasChain())
+	{
+		clearChain();
+		return false;
+	}
+
+	const int32 numJoints = chainBones.Num();
+	for (int32 jointIndex = 0; jointIndex < numJoints / 2; jointIndex++)
+	{
+		chainBones.Swap(jointIndex, numJoints - 1 - jointIndex);
+	}
+
+	// Bone lengths don't change while posing, so they're measured once for the whole drag
+	jointLocations.SetNumUninitialized(numJoints);
+	for (int32 jointIndex = 0; jointIndex < numJoints; jointIndex++)
+	{
+		jointLocations[jointIndex] = boneHandles.getBoneWorldLocation(chainBones[jointIndex]);
+	}
+
+	boneLengths.SetNumUninitialized(numJoints - 1);
+	for (int32 jointIndex = 0; jointIndex < numJoints - 1; jointIndex++)
+	{
+		boneLengths[jointIndex] = FVector::Dist(jointLocations[jointIndex], jointLocations[jointIndex + 1]);
+		chainLength += boneLengths[jointIndex];
+	}
+
+	return true;
+}
+
+void FIKChainSolver::clearChain()
+{
+	chainBones.Reset();
+	boneLengths.Reset();
+	jointLocations.Reset();
+	chainLength = 0.0f;
+	hasPreviousSolution = false;
+	lastError = 0.0f;
+}
+
+void FIKChainSolver::iterate(const FVector &baseLocation, const FVector &targetLocation, float maxBendRadians)
+{
+	const int32 numJoints = jointLocations.Num();
+
+	// Backward: put the end on the target and drag every joint along behind it
+	jointLocations[numJoints - 1] = targetLocation;
+	for (int32 jointIndex = numJoints - 2; jointIndex >= 0; jointIndex--)
+	{
+		FVector direction = (jointLocations[jointIndex] - jointLocations[jointIndex + 1]).GetSafeNormal();
+		jointLocations[jointIndex] = jointLocations[jointIndex + 1] + direction * boneLengths[jointIndex];
+	}
+
+	// Forward: pin the base back in place and lay the bones out from it, bending each joint no further than the limit
+	jointLocations[0] = baseLocation;
+	FVector previousDirection = FVector::ZeroVector;
+	for (int32 jointIndex = 1; jointIndex < numJoints; jointIndex++)
+	{
+		FVector direction = (jointLocations[jointIndex] - jointLocations[jointIndex - 1]).GetSafeNormal();
+		if (direction.IsZero())
+		{
+			direction = previousDirection.IsZero() ? FVector::ForwardVector : previousDirection;
+		}
+		else if (!previousDirection.IsZero())
+		{
+			direction = limitDirection(previousDirection, direction, maxBendRadians);
+		}
+
+		jointLocations[jointIndex] = jointLocations[jointIndex - 1] + direction * boneLengths[jointIndex - 1];
+		previousDirection = direction;
+	}
+}
+
+int32 FIKChainSolver::solve(FPoseableBoneHandles &boneHandles, const FVector &targetLocation, const FIKSolverSettings &settings)
+{
+	if (!hasChain())
+	{
+		return 0;
+	}
+
+	const int32 numJoints = chainBones.Num();
+	const FVector baseLocation = boneHandles.getBoneWorldLocation(chainBones[0]);
+
+	// Warm start from the last solution, following the base of the chain if something above it moved
+	if (hasPreviousSolution)
+	{
+		FVector baseOffset = baseLocation - jointLocations[0];
+		for (int32 jointIndex = 0; jointIndex < numJoints; jointIndex++)
+		{
+			jointLocations[jointIndex] += baseOffset;
+		}
+	}
+
+	const double deadline = FPlatformTime::Seconds() + settings.timeBudgetSeconds;
+	int32 iterations = 0;
+	lastError = FVector::Dist(jointLocations[numJoints - 1], targetLocation);
+
+	while (lastError > settings.tolerance && iterations < settings.maxIterations)
+	{
+		iterate(baseLocation, targetLocation, settings.maxBendRadians);
+		iterations++;
+		lastError = FVector::Dist(jointLocations[numJoints - 1], targetLocation);
+
+		// Out of reach targets are as close as they'll get once the chain is stretched out toward them
+		if (FVector::Dist(baseLocation, targetLocation) >= chainLength || FPlatformTime::Seconds() >= deadline)
+		{
+			break;
+		}
+	}
+	hasPreviousSolution = true;
+
+	// Turn each bone of the chain to point at its solved child joint, bases first since turning a bone moves its children
+	for (int32 jointIndex = 0; jointIndex < numJoints - 1; jointIndex++)
+	{
+		int32 boneIndex = chainBones[jointIndex];
+		FVector currentDirection = (boneHandles.getBoneWorldLocation(chainBones[jointIndex + 1]) - boneHandles.getBoneWorldLocation(boneIndex)).GetSafeNormal();
+		FVector solvedDirection = (jointLocations[jointIndex + 1] - jointLocations[jointIndex]).GetSafeNormal();
+		if (currentDirection.IsZero() || solvedDirection.IsZero())
+		{
+			continue;
+		}
+
+		FQuat newRotation = FQuat::FindBetweenNormals(currentDirection, solvedDirection) * boneHandles.getBoneWorldRotation(boneIndex);
+		boneHandles.setBoneWorldRotation(boneIndex, newRotation);
+	}
+
+	return iterations;
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseableBoneHandles.h"
+
+// Limits that keep a solve inside its slice of the frame
+struct FIKSolverSettings
+{
+	FIKSolverSettings() :
+		maxIterations(10),
+		tolerance(0.1f),
+		timeBudgetSeconds(0.0005f),
+		maxBendRadians(PI * 0.8f)
+	{
+	}
+
+	// Iterations are capped even when the budget would allow more
+	int32 maxIterations;
+
+	// The solve stops once the end of the chain is this close to the target
+	float tolerance;
+
+	// The solve stops after the iteration that runs over this
+	float timeBudgetSeconds;
+
+	// How far each joint can bend away from the direction of the bone before it
+	float maxBendRadians;
+};
+
+// FABRIK solver for a chain of bones ending in the dragged bone. Each solve starts from the previous solution, moved
+// along with the base of the chain, so a target that only moves a little converges in an iteration or two.
+class FIKChainSolver
+{
+public:
+	FIKChainSolver();
+
+	// Set up a chain from the end bone up through the given number of its parents, returns false if the end bone has
+	// no parent to rotate
+	bool setChain(const FPoseableBoneHandles &boneHandles, int32 endBoneIndex, int32 numChainBones);
+
+	void clearChain();
+
+	bool hasChain() const
+	{
+		return chainBones.Num() >= 2;
+	}
+
+	// Move the end of the chain toward the target and rotate the chain's bones to match, returns the number of
+	// iterations used
+	int32 solve(FPoseableBoneHandles &boneHandles, const FVector &targetLocation, const FIKSolverSettings &settings);
+
+	// How far the end of the chain was from the target after the last solve
+	float getLastError() const
+	{
+		return lastError;
+	}
+
+private:
+	// One FABRIK iteration: pull the chain to the target from its end, then back to its base
+	void iterate(const FVector &baseLocation, const FVector &targetLocation, float maxBendRadians);
+
+	// Bones of the chain from its base to its end
+	TArray<int32> chainBones;
+
+	// The length of each bone of the chain, bone i runs from joint i to joint i + 1
+	TArray<float> boneLengths;
+	float chainLength;
+
+	// Joint locations being solved, kept from one solve to warm start the next
+	TArray<FVector> jointLocations;
+	bool hasPreviousSolution;
+
+	float lastError;
+};
@@ -0,0 +1,333 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "KeyframeTimeline.h"
+#include "PoseBlending.h"
+#include "TimelineSearch.h"
+
+FKeyframeTimeline::FKeyframeTimeline() :
+	interpolation(ETimelineInterpolation::Linear),
+	storage(EKeyFrameStorage::Full),
+	playbackCursor(0)
+{
+}
+
+int32 FKeyframeTimeline::lowerBound(float keyFrameTime) const
+{
+	return PoseMathCore::lowerBound(keyFrames.Num(), keyFrameTime, [this](int32 keyFrameIndex) { return keyFrames[keyFrameIndex].keyFrameTime; });
+}
+
+int32 FKeyframeTimeline::findKeyFrame(float keyFrameTime) const
+{
+	int32 keyFrameIndex = lowerBound(keyFrameTime);
+	if (keyFrameIndex < keyFrames.Num() && keyFrames[keyFrameIndex].keyFrameTime == keyFrameTime)
+	{
+		return keyFrameIndex;
+	}
+	return INDEX_NONE;
+}
+
+int32 FKeyframeTimeline::setKeyFrame(float keyFrameTime, FPoseBuffer &&pose, bool &overwroteExistingKeyFrame)
+{
+	int32 keyFrameIndex = lowerBound(keyFrameTime);
+
+	overwroteExistingKeyFrame = keyFrameIndex < keyFrames.Num() && keyFrames[keyFrameIndex].keyFrameTime == keyFrameTime;
+	if (!overwroteExistingKeyFrame)
+	{
+		keyFrames.InsertDefaulted(keyFrameIndex);
+		keyFrames[keyFrameIndex].keyFrameTime = keyFrameTime;
+	}
+	if (storage == EKeyFrameStorage::Quantized)
+	{
+		PoseQuantization::quantizePose(pose, quantizationFormat, keyFrames[keyFrameIndex].quantizedPose);
+	}
+	else
+	{
+		Swap(keyFrames[keyFrameIndex].pose, pose);
+	}
+
+	keyFrameChanged(keyFrameIndex);
+	return keyFrameIndex;
+}
+
+void FKeyframeTimeline::readKeyFramePose(int32 keyFrameIndex, FPoseBuffer &outPose) const
+{
+	if (storage == EKeyFrameStorage::Quantized)
+	{
+		PoseQuantization::dequantizePose(keyFrames[keyFrameIndex].quantizedPose, quantizationFormat, outPose);
+	}
+	else
+	{
+		outPose.copyFrom(keyFrames[keyFrameIndex].pose);
+	}
+}
+
+void FKeyframeTimeline::writeKeyFramePose(int32 keyFrameIndex, const FPoseBuffer &pose)
+{
+	if (storage == EKeyFrameStorage::Quantized)
+	{
+		PoseQuantization::quantizePose(pose, quantizationFormat, keyFrames[keyFrameIndex].quantizedPose);
+	}
+	else
+	{
+		keyFrames[keyFrameIndex].pose.copyFrom(pose);
+	}
+
+	keyFrameChanged(keyFrameIndex);
+}
+
+const FPoseBuffer &FKeyframeTimeline::getUnpackedPose(int32 keyFrameIndex, int32 scratchIndex) const
+{
+	if (storage != EKeyFrameStorage::Quantized)
+	{
+		return keyFrames[keyFrameIndex].pose;
+	}
+
+	PoseQuantization::dequantizePose(keyFrames[keyFrameIndex].quantizedPose, quantizationFormat, unpackedPoses[scratchIndex]);
+	return unpackedPoses[scratchIndex];
+}
+
+void FKeyframeTimeline::setStorage(EKeyFrameStorage newStorage, const FPoseQuantizationFormat &newFormat)
+{
+	// Quantized keyframes have to be unpacked with the range they were packed with before it changes
+	if (storage == EKeyFrameStorage::Quantized)
+	{
+		for (FKeyFrame &keyFrame : keyFrames)
+		{
+			PoseQuantization::dequantizePose(keyFrame.quantizedPose, quantizationFormat, keyFrame.pose);
+			keyFrame.quantizedPose = FQuantizedPose();
+		}
+	}
+
+	storage = newStorage;
+	quantizationFormat = newFormat;
+
+	if (storage == EKeyFrameStorage::Quantized)
+	{
+		for (FKeyFrame &keyFrame : keyFrames)
+		{
+			PoseQuantization::quantizePose(keyFrame.pose, quantizationFormat, keyFrame.quantizedPose);
+			keyFrame.pose = FPoseBuffer();
+			keyFrame.tangents = FPoseBuffer();
+		}
+	}
+
+	// Full precision tangents follow the poses as they come out of storage
+	updateTangents(0, keyFrames.Num() - 1);
+}
+
+SIZE_T FKeyframeTimeline::getAllocatedSize() const
+{
+	SIZE_T allocatedSize = keyFrames.GetAllocatedSize();
+	for (const FKeyFrame &keyFrame : keyFrames)
+	{
+		allocatedSize += keyFrame.pose.getAllocatedSize() + keyFrame.quantizedPose.getAllocatedSize() + keyFrame.tangents.getAllocatedSize();
+	}
+	return allocatedSize;
+}
+
+void FKeyframeTimeline::removeKeyFrame(int32 keyFrameIndex, FPoseBuffer &outPose)
+{
+	if (storage == EKeyFrameStorage::Quantized)
+	{
+		PoseQuantization::dequantizePose(keyFrames[keyFrameIndex].quantizedPose, quantizationFormat, outPose);
+	}
+	else
+	{
+		Swap(outPose, keyFrames[keyFrameIndex].pose);
+	}
+
+	keyFrames.RemoveAt(keyFrameIndex, 1, false);
+
+	// The keys on either side are now each other's neighbours
+	updateTangents(keyFrameIndex - 1, keyFrameIndex);
+}
+
+void FKeyframeTimeline::keyFrameChanged(int32 keyFrameIndex)
+{
+	// A key's tangents only depend on it and its neighbours, so nothing further away changes
+	updateTangents(keyFrameIndex - 1, keyFrameIndex + 1);
+}
+
+void FKeyframeTimeline::setInterpolation(ETimelineInterpolation newInterpolation)
+{
+	if (newInterpolation == interpolation)
+	{
+		return;
+	}
+	interpolation = newInterpolation;
+
+	if (interpolation == ETimelineInterpolation::Spline)
+	{
+		updateTangents(0, keyFrames.Num() - 1);
+	}
+	else
+	{
+		for (FKeyFrame &keyFrame : keyFrames)
+		{
+			keyFrame.tangents = FPoseBuffer();
+		}
+	}
+}
+
+void FKeyframeTimeline::updateTangents(int32 firstKeyFrameIndex, int32 lastKeyFrameIndex)
+{
+	if (interpolation != ETimelineInterpolation::Spline || storage == EKeyFrameStorage::Quantized)
+	{
+		return;
+	}
+
+	firstKeyFrameIndex = FMath::Max(firstKeyFrameIndex, 0);
+	lastKeyFrameIndex = FMath::Min(lastKeyFrameIndex, keyFrames.Num() - 1);
+
+	for (int32 keyFrameIndex = firstKeyFrameIndex; keyFrameIndex <= lastKeyFrameIndex; keyFrameIndex++)
+	{
+		const bool hasPrevious = keyFrameIndex > 0;
+		const bool hasNext = keyFrameIndex + 1 < keyFrames.Num();
+		const FPoseBuffer *previousPose = hasPrevious ? &getUnpackedPose(keyFrameIndex - 1, 0) : nullptr;
+		const FPoseBuffer *nextPose = hasNext ? &getUnpackedPose(keyFrameIndex + 1, 2) : nullptr;
+		const FPoseBuffer &pose = getUnpackedPose(keyFrameIndex, 1);
+		FKeyFrame &keyFrame = keyFrames[keyFrameIndex];
+
+		PoseBlending::computeSplineTangents(
+			previousPose, hasPrevious ? keyFrames[keyFrameIndex - 1].keyFrameTime : 0.0f,
+			pose, keyFrame.keyFrameTime,
+			nextPose, hasNext ? keyFrames[keyFrameIndex + 1].keyFrameTime : 0.0f,
+			keyFrame.tangents);
+	}
+}
+
+void FKeyframeTimeline::empty(TFunctionRef<void(FPoseBuffer &&)> releasePose, TFunctionRef<void(FQuantizedPose &&)> releaseQuantizedPose)
+{
+	for (FKeyFrame &keyFrame : keyFrames)
+	{
+		releasePose(MoveTemp(keyFrame.pose));
+		releasePose(MoveTemp(keyFrame.tangents));
+		releaseQuantizedPose(MoveTemp(keyFrame.quantizedPose));
+	}
+	keyFrames.Reset();
+	playbackCursor = 0;
+}
+
+bool FKeyframeTimeline::findPreviousAndNextKeyFrames(float timeToCheck, int32 &previousKeyFrameIndex, int32 &nextKeyFrameIndex) const
+{
+	if (keyFrames.Num() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No keyframes saved!!!"));
+		previousKeyFrameIndex = INDEX_NONE;
+		nextKeyFrameIndex = INDEX_NONE;
+		return false;
+	}
+
+	// Playback and small scrubs land on the same key as last time or one of its neighbours
+	playbackCursor = PoseMathCore::moveCursor(playbackCursor, keyFrames.Num(), timeToCheck,
+		[this](int32 keyFrameIndex) { return keyFrames[keyFrameIndex].keyFrameTime; });
+
+	previousKeyFrameIndex = FMath::Max(playbackCursor - 1, 0);
+
+	if (playbackCursor == keyFrames.Num())
+	{
+		nextKeyFrameIndex = INDEX_NONE;
+		return false;
+	}
+
+	nextKeyFrameIndex = playbackCursor;
+	return true;
+}
+
+bool FKeyframeTimeline::evaluate(float timeToEvaluate, FPoseBuffer &outPose) const
+{
+	// Find the two frames to interpolate between for this time in the animation
+	int32 previousFrameIndex;
+	int32 nextFrameIndex;
+	bool nextFrameFound = findPreviousAndNextKeyFrames(timeToEvaluate, previousFrameIndex, nextFrameIndex);
+
+	if (previousFrameIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const FKeyFrame &previousFrame = keyFrames[previousFrameIndex];
+
+	// If the next frame can't be found just hold the last frame, and at or before the first keyframe there is nothing
+	// to interpolate
+	if (!nextFrameFound || previousFrameIndex == nextFrameIndex)
+	{
+		readKeyFramePose(previousFrameIndex, outPose);
+		return true;
+	}
+
+	const FKeyFrame &nextFrame = keyFrames[nextFrameIndex];
+
+	// Find out how much we need to interpolate these guys
+	float timeDifference = nextFrame.keyFrameTime - previousFrame.keyFrameTime;
+	float timePastFirstFrame = timeToEvaluate - previousFrame.keyFrameTime;
+
+	if (timeDifference == 0.0f)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Found two frames with the same time!"));
+		return false;
+	}
+
+	if (getKeyFrameNumBones(previousFrameIndex) != getKeyFrameNumBones(nextFrameIndex))
+	{
+		UE_LOG(LogTemp, Error, TEXT("The two poses to interpolate don't have the same number of bones"));
+		readKeyFramePose(previousFrameIndex, outPose);
+		return true;
+	}
+
+	// Check to see if any interpolation is needed
+	float percentageOfNextPose = timePastFirstFrame / timeDifference;
+	if (percentageOfNextPose == 0.0f)
+	{
+		readKeyFramePose(previousFrameIndex, outPose);
+	}
+	else if (percentageOfNextPose == 1.0f)
+	{
+		readKeyFramePose(nextFrameIndex, outPose);
+	}
+	else if (interpolation == ETimelineInterpolation::Spline && storage == EKeyFrameStorage::Quantized)
+	{
+		splineBlendQuantized(previousFrameIndex, percentageOfNextPose, outPose);
+	}
+	else if (interpolation == ETimelineInterpolation::Spline)
+	{
+		PoseBlending::splineBlendPoses(previousFrame.pose, previousFrame.tangents, nextFrame.pose, nextFrame.tangents, percentageOfNextPose,
+			timeDifference, outPose);
+	}
+	else if (storage == EKeyFrameStorage::Quantized)
+	{
+		// Unpacked bone by bone as they're blended, the keyframes never have to be unpacked in full
+		PoseBlending::blendQuantizedPoses(previousFrame.quantizedPose, nextFrame.quantizedPose, quantizationFormat, percentageOfNextPose, outPose);
+	}
+	else
+	{
+		PoseBlending::blendTwoPoses(previousFrame.pose, nextFrame.pose, percentageOfNextPose, outPose);
+	}
+	return true;
+}
+
+void FKeyframeTimeline::splineBlendQuantized(int32 previousKeyFrameIndex, float alpha, FPoseBuffer &outPose) const
+{
+	const int32 nextKeyFrameIndex = previousKeyFrameIndex + 1;
+	const float previousTime = keyFrames[previousKeyFrameIndex].keyFrameTime;
+	const float nextTime = keyFrames[nextKeyFrameIndex].keyFrameTime;
+
+	// A key's tangents only need it and its neighbours, so the two keys either side of the segment are enough. Keys
+	// with a different number of bones are treated like the end of the timeline.
+	const int32 numBones = getKeyFrameNumBones(previousKeyFrameIndex);
+	const bool hasBefore = previousKeyFrameIndex > 0 && getKeyFrameNumBones(previousKeyFrameIndex - 1) == numBones;
+	const bool hasAfter = nextKeyFrameIndex + 1 < keyFrames.Num() && getKeyFrameNumBones(nextKeyFrameIndex + 1) == numBones;
+
+	const FPoseBuffer *beforePose = hasBefore ? &getUnpackedPose(previousKeyFrameIndex - 1, 0) : nullptr;
+	const FPoseBuffer &previousPose = getUnpackedPose(previousKeyFrameIndex, 1);
+	const FPoseBuffer &nextPose = getUnpackedPose(nextKeyFrameIndex, 2);
+	const FPoseBuffer *afterPose = hasAfter ? &getUnpackedPose(nextKeyFrameIndex + 1, 3) : nullptr;
+
+	PoseBlending::computeSplineTangents(beforePose, hasBefore ? keyFrames[previousKeyFrameIndex - 1].keyFrameTime : 0.0f,
+		previousPose, previousTime, &nextPose, nextTime, unpackedTangents[0]);
+	PoseBlending::computeSplineTangents(&previousPose, previousTime, nextPose, nextTime,
+		afterPose, hasAfter ? keyFrames[nextKeyFrameIndex + 1].keyFrameTime : 0.0f, unpackedTangents[1]);
+
+	PoseBlending::splineBlendPoses(previousPose, unpackedTangents[0], nextPose, unpackedTangents[1], alpha, nextTime - previousTime, outPose);
+}
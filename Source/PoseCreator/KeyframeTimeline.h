@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "DataStructures.h"
+
+// How poses are interpolated between keyframes
+enum class ETimelineInterpolation : uint8
+{
+	// Blend the two neighbouring keyframes, the motion changes speed abruptly at every key
+	Linear,
+	// Catmull-Rom translations and SQUAD rotations through every keyframe, smooth across keys
+	Spline
+};
+
+// How keyframe poses are kept in memory
+enum class EKeyFrameStorage : uint8
+{
+	// Full precision floats, 28 bytes a bone
+	Full,
+	// Smallest three rotations and translations across a range around the first bone, bit packed at whatever depth
+	// keeps them within the timeline's precision. Spline tangents aren't stored, they're worked out from the
+	// neighbouring keys as they're needed.
+	Quantized
+};
+
+// Keyframes kept sorted by time. Neighbouring keyframes are found with a binary search, and a cursor remembers the
+// last lookup so playing forward or scrubbing a little only has to look at the keys next to the previous result.
+class FKeyframeTimeline
+{
+public:
+	FKeyframeTimeline();
+
+	int32 numKeyFrames() const
+	{
+		return keyFrames.Num();
+	}
+
+	float getKeyFrameTime(int32 keyFrameIndex) const
+	{
+		return keyFrames[keyFrameIndex].keyFrameTime;
+	}
+
+	int32 getKeyFrameNumBones(int32 keyFrameIndex) const
+	{
+		return storage == EKeyFrameStorage::Quantized ? keyFrames[keyFrameIndex].quantizedPose.numBones() : keyFrames[keyFrameIndex].pose.numBones();
+	}
+
+	// Copy a keyframe's pose out, unpacking it if it's quantized
+	void readKeyFramePose(int32 keyFrameIndex, FPoseBuffer &outPose) const;
+
+	// Replace a keyframe's pose, packing it if keyframes are quantized
+	void writeKeyFramePose(int32 keyFrameIndex, const FPoseBuffer &pose);
+
+	EKeyFrameStorage getStorage() const
+	{
+		return storage;
+	}
+
+	// Repack every keyframe for the new storage. Quantized keyframes are packed in the given format, translations are
+	// stored as offsets from the first bone across its range and anything outside of it is clamped.
+	void setStorage(EKeyFrameStorage newStorage, const FPoseQuantizationFormat &newFormat);
+
+	// Memory used by the keyframes and their tangents
+	SIZE_T getAllocatedSize() const;
+
+	ETimelineInterpolation getInterpolation() const
+	{
+		return interpolation;
+	}
+
+	// Switching to splines works out the tangents of every keyframe, after that only the keys next to an edit are redone
+	void setInterpolation(ETimelineInterpolation newInterpolation);
+
+	// Find the keyframe at exactly this time, INDEX_NONE if there isn't one
+	int32 findKeyFrame(float keyFrameTime) const;
+
+	// Add a keyframe at the given time, overwriting the pose of an existing keyframe at that exact time. With full
+	// precision storage an overwritten pose is swapped back into the passed in pose so its memory can be reused,
+	// otherwise that pose is left empty. Quantized storage packs the pose and leaves it as it was. Returns the index of
+	// the keyframe.
+	int32 setKeyFrame(float keyFrameTime, FPoseBuffer &&pose, bool &overwroteExistingKeyFrame);
+
+	// Remove a keyframe, handing its pose back through outPose. With full precision storage the keyframe's memory is
+	// swapped into outPose, quantized storage unpacks into it.
+	void removeKeyFrame(int32 keyFrameIndex, FPoseBuffer &outPose);
+
+	// Remove every keyframe, passing each full precision pose and tangent buffer to releasePose and each quantized pose
+	// to releaseQuantizedPose so their memory can be reused. The keyframe array keeps its capacity.
+	void empty(TFunctionRef<void(FPoseBuffer &&)> releasePose, TFunctionRef<void(FQuantizedPose &&)> releaseQuantizedPose);
+
+	// Make room for a number of keyframes up front
+	void reserve(int32 numKeyFramesToReserve)
+	{
+		keyFrames.Reserve(numKeyFramesToReserve);
+	}
+
+	// Find the keyframes surrounding the given time. The next keyframe is the first one at or after the time and the
+	// previous keyframe is the last one before it, or the first keyframe if there is none before it.
+	// Returns false if there is no keyframe at or after the time, in which case only the previous index is set.
+	bool findPreviousAndNextKeyFrames(float timeToCheck, int32 &previousKeyFrameIndex, int32 &nextKeyFrameIndex) const;
+
+	// Interpolate the pose at the given time between its neighbouring keyframes, holding the first and last keyframes
+	// outside of the timeline. Returns false if there is no pose to evaluate. Doesn't touch anything but the output
+	// pose, the playback cursor and the unpacking scratch, so it's safe to run off the game thread while the timeline
+	// isn't being edited.
+	bool evaluate(float timeToEvaluate, FPoseBuffer &outPose) const;
+
+private:
+	// Index of the first keyframe at or after the given time, the number of keyframes if there is none
+	int32 lowerBound(float keyFrameTime) const;
+
+	// Recompute the spline tangents of the keyframes in the given range, clamped to the timeline. Quantized keyframes
+	// don't keep any.
+	void updateTangents(int32 firstKeyFrameIndex, int32 lastKeyFrameIndex);
+
+	// Spline blend between a keyframe and the next one, working the tangents out from the keys on either side
+	void splineBlendQuantized(int32 previousKeyFrameIndex, float alpha, FPoseBuffer &outPose) const;
+
+	// Update whatever depends on a keyframe's pose after it was changed
+	void keyFrameChanged(int32 keyFrameIndex);
+
+	// A keyframe's full precision pose, unpacked into one of the scratch poses if it's quantized
+	const FPoseBuffer &getUnpackedPose(int32 keyFrameIndex, int32 scratchIndex) const;
+
+	// Keyframes sorted by time, no two keyframes share the same time
+	TArray<FKeyFrame> keyFrames;
+
+	ETimelineInterpolation interpolation;
+
+	EKeyFrameStorage storage;
+	FPoseQuantizationFormat quantizationFormat;
+
+	// Scratch for unpacking quantized keyframes and their tangents. Used by evaluate and by edits, which never run at
+	// the same time.
+	mutable FPoseBuffer unpackedPoses[4];
+	mutable FPoseBuffer unpackedTangents[2];
+
+	// The lower bound found by the last lookup
+	mutable int32 playbackCursor;
+};
@@ -0,0 +1,254 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "MirrorTable.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// Name fragments that mark a side, each paired with the other side's
+	struct FSideTag
+	{
+		const TCHAR *left;
+		const TCHAR *right;
+	};
+
+	const FSideTag suffixTags[] =
+	{
+		{ TEXT("_l"), TEXT("_r") },
+		{ TEXT("_L"), TEXT("_R") },
+		{ TEXT(".l"), TEXT(".r") },
+		{ TEXT(".L"), TEXT(".R") },
+	};
+
+	const FSideTag prefixTags[] =
+	{
+		{ TEXT("l_"), TEXT("r_") },
+		{ TEXT("L_"), TEXT("R_") },
+	};
+
+	const FSideTag wordTags[] =
+	{
+		{ TEXT("Left"), TEXT("Right") },
+		{ TEXT("left"), TEXT("right") },
+		{ TEXT("LEFT"), TEXT("RIGHT") },
+	};
+
+	FORCEINLINE FQuat reflectRotation(const FQuat &rotation, const FQuat &reflection)
+	{
+		return FQuat(rotation.X * reflection.X, rotation.Y * reflection.Y, rotation.Z * reflection.Z, rotation.W * reflection.W);
+	}
+}
+
+FMirrorTable::FMirrorTable() :
+	rotationReflection(FQuat::Identity),
+	locationReflection(FVector(1.0f)),
+	numBonePairs(0)
+{
+}
+
+FName FMirrorTable::findMirrorName(const FString &boneName)
+{
+	for (const FSideTag &tag : suffixTags)
+	{
+		if (boneName.EndsWith(tag.left, ESearchCase::CaseSensitive))
+		{
+			return FName(*(boneName.LeftChop(FCString::Strlen(tag.left)) + tag.right));
+		}
+		if (boneName.EndsWith(tag.right, ESearchCase::CaseSensitive))
+		{
+			return FName(*(boneName.LeftChop(FCString::Strlen(tag.right)) + tag.left));
+		}
+	}
+
+	for (const FSideTag &tag : prefixTags)
+	{
+		if (boneName.StartsWith(tag.left, ESearchCase::CaseSensitive))
+		{
+			return FName(*(tag.right + boneName.RightChop(FCString::Strlen(tag.left))));
+		}
+		if (boneName.StartsWith(tag.right, ESearchCase::CaseSensitive))
+		{
+			return FName(*(tag.left + boneName.RightChop(FCString::Strlen(tag.right))));
+		}
+	}
+
+	for (const FSideTag &tag : wordTags)
+	{
+		if (boneName.Contains(tag.left, ESearchCase::CaseSensitive))
+		{
+			return FName(*boneName.Replace(tag.left, tag.right, ESearchCase::CaseSensitive));
+		}
+		if (boneName.Contains(tag.right, ESearchCase::CaseSensitive))
+		{
+			return FName(*boneName.Replace(tag.right, tag.left, ESearchCase::CaseSensitive));
+		}
+	}
+
+	return NAME_None;
+}
+
+void FMirrorTable::build(const FReferenceSkeleton &skeleton, EAxis::Type mirrorAxis, const TMap<FName, FName> &pairOverrides)
+{
+	const int32 numBones = skeleton.GetNum();
+	mirrorBones.SetNumUninitialized(numBones);
+	rotationCorrections.SetNumUninitialized(numBones);
+	numBonePairs = 0;
+
+	// Reflecting across the plane the axis is normal to flips that coordinate of locations, and the other two
+	// components of a rotation's axis
+	locationReflection = FVector(1.0f);
+	rotationReflection = FQuat(-1.0f, -1.0f, -1.0f, 1.0f);
+	switch (mirrorAxis)
+	{
+	case EAxis::Y:
+		locationReflection.Y = -1.0f;
+		rotationReflection.Y = 1.0f;
+		break;
+	case EAxis::Z:
+		locationReflection.Z = -1.0f;
+		rotationReflection.Z = 1.0f;
+		break;
+	default:
+		locationReflection.X = -1.0f;
+		rotationReflection.X = 1.0f;
+		break;
+	}
+
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		mirrorBones[boneIndex] = INDEX_NONE;
+	}
+
+	// Overrides first, then whatever the names say about the bones that are left
+	for (const TPair<FName, FName> &pairOverride : pairOverrides)
+	{
+		int32 firstBone = skeleton.FindBoneIndex(pairOverride.Key);
+		int32 secondBone = skeleton.FindBoneIndex(pairOverride.Value);
+		if (firstBone == INDEX_NONE || secondBone == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Mirror override %s <-> %s names a bone the skeleton doesn't have!!!"), *pairOverride.Key.ToString(), *pairOverride.Value.ToString());
+			continue;
+		}
+		mirrorBones[firstBone] = secondBone;
+		mirrorBones[secondBone] = firstBone;
+	}
+
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		if (mirrorBones[boneIndex] != INDEX_NONE)
+		{
+			continue;
+		}
+
+		FName mirrorName = findMirrorName(skeleton.GetBoneName(boneIndex).ToString());
+		int32 mirrorBone = mirrorName != NAME_None ? skeleton.FindBoneIndex(mirrorName) : INDEX_NONE;
+		if (mirrorBone != INDEX_NONE && mirrorBones[mirrorBone] == INDEX_NONE)
+		{
+			mirrorBones[boneIndex] = mirrorBone;
+			mirrorBones[mirrorBone] = boneIndex;
+		}
+	}
+
+	// Bones the names couldn't place take the child in the same spot under the mirrored parent, so an unnamed chain
+	// under a sided bone still pairs up. Parents come before children, so a parent is always settled first.
+	TArray<int32> childSlots;
+	childSlots.SetNumZeroed(numBones);
+	TArray<int32> slotInParent;
+	slotInParent.SetNumUninitialized(numBones);
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		int32 parentIndex = skeleton.GetParentIndex(boneIndex);
+		slotInParent[boneIndex] = parentIndex != INDEX_NONE ? childSlots[parentIndex]++ : 0;
+	}
+
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		if (mirrorBones[boneIndex] != INDEX_NONE)
+		{
+			continue;
+		}
+
+		mirrorBones[boneIndex] = boneIndex;
+
+		int32 parentIndex = skeleton.GetParentIndex(boneIndex);
+		int32 mirrorParent = parentIndex != INDEX_NONE ? mirrorBones[parentIndex] : INDEX_NONE;
+		if (mirrorParent == INDEX_NONE || mirrorParent == parentIndex)
+		{
+			continue;
+		}
+
+		for (int32 otherBone = mirrorParent + 1; otherBone < numBones; otherBone++)
+		{
+			if (skeleton.GetParentIndex(otherBone) == mirrorParent && slotInParent[otherBone] == slotInParent[boneIndex])
+			{
+				if (mirrorBones[otherBone] == INDEX_NONE)
+				{
+					mirrorBones[boneIndex] = otherBone;
+					mirrorBones[otherBone] = boneIndex;
+				}
+				break;
+			}
+		}
+	}
+
+	// The reference pose in component space gives each bone's correction for its mirror bone's axes
+	const TArray<FTransform> &localPose = skeleton.GetRefBonePose();
+	TArray<FQuat> referenceRotations;
+	referenceRotations.SetNumUninitialized(numBones);
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		int32 parentIndex = skeleton.GetParentIndex(boneIndex);
+		referenceRotations[boneIndex] = parentIndex == INDEX_NONE ? localPose[boneIndex].GetRotation() : referenceRotations[parentIndex] * localPose[boneIndex].GetRotation();
+	}
+
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		int32 mirrorBone = mirrorBones[boneIndex];
+		rotationCorrections[boneIndex] = reflectRotation(referenceRotations[mirrorBone], rotationReflection).Inverse() * referenceRotations[boneIndex];
+		if (mirrorBone > boneIndex)
+		{
+			numBonePairs++;
+		}
+	}
+}
+
+void FMirrorTable::mirrorPose(FPoseBuffer &pose, const FTransform &componentToWorld) const
+{
+	check(pose.numBones() == mirrorBones.Num());
+
+	const FQuat componentRotation = componentToWorld.GetRotation();
+	const FQuat inverseComponentRotation = componentRotation.Inverse();
+	const int32 numBones = mirrorBones.Num();
+
+	FQuat *rotations = pose.rotations.GetData();
+	FVector *translations = pose.translations.GetData();
+
+	// Each pair is mirrored together from the old values of both bones, which lets the pose be mirrored in place
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		const int32 mirrorBone = mirrorBones[boneIndex];
+		if (mirrorBone < boneIndex)
+		{
+			continue;
+		}
+
+		FQuat rotation = reflectRotation(inverseComponentRotation * rotations[boneIndex], rotationReflection);
+		FQuat mirrorRotation = reflectRotation(inverseComponentRotation * rotations[mirrorBone], rotationReflection);
+		FVector location = componentToWorld.InverseTransformPosition(translations[boneIndex]) * locationReflection;
+		FVector mirrorLocation = componentToWorld.InverseTransformPosition(translations[mirrorBone]) * locationReflection;
+
+		rotations[boneIndex] = componentRotation * mirrorRotation * rotationCorrections[boneIndex];
+		translations[boneIndex] = componentToWorld.TransformPosition(mirrorLocation);
+		rotations[mirrorBone] = componentRotation * rotation * rotationCorrections[mirrorBone];
+		translations[mirrorBone] = componentToWorld.TransformPosition(location);
+	}
+}
+
+void FMirrorTable::mirrorPoses(FPoseBuffer *const *poses, int32 numPoses, const FTransform &componentToWorld) const
+{
+	ParallelFor(numPoses, [this, poses, &componentToWorld](int32 poseIndex)
+	{
+		mirrorPose(*poses[poseIndex], componentToWorld);
+	});
+}
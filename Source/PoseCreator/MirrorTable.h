@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+
+// Left/right pairing of a skeleton's bones and everything needed to mirror a pose across the skeleton's mirror plane,
+// worked out once so mirroring is a flat pass over the bones. Bones are paired by their names (_l/_r, l_/r_,
+// Left/Right and so on), bones the names don't pair up follow their parent's pairing by their place among its
+// children, and overrides take priority over both. Bones without a pair mirror onto themselves.
+class FMirrorTable
+{
+public:
+	FMirrorTable();
+
+	// Pair up the skeleton's bones, the mirror axis is the component space axis that flips sides.
+	// Overrides are pairs of bone names, each one is paired both ways.
+	void build(const FReferenceSkeleton &skeleton, EAxis::Type mirrorAxis, const TMap<FName, FName> &pairOverrides);
+
+	bool isBuilt() const
+	{
+		return mirrorBones.Num() > 0;
+	}
+
+	// The bone on the other side, the bone itself for bones in the middle
+	int32 getMirrorBone(int32 boneIndex) const
+	{
+		return mirrorBones[boneIndex];
+	}
+
+	// How many left/right pairs were found
+	int32 numPairs() const
+	{
+		return numBonePairs;
+	}
+
+	// Mirror a pose in place. Poses are in world space, the component to world transform gives the frame the mirror
+	// axis is in.
+	void mirrorPose(FPoseBuffer &pose, const FTransform &componentToWorld) const;
+
+	// Mirror a batch of poses in place, spread across worker threads
+	void mirrorPoses(FPoseBuffer *const *poses, int32 numPoses, const FTransform &componentToWorld) const;
+
+private:
+	// Find the other side's name for a bone name, NAME_None if the name doesn't say which side it's on
+	static FName findMirrorName(const FString &boneName);
+
+	// Per bone: the bone on the other side
+	TArray<int32> mirrorBones;
+
+	// Per bone: the rotation that takes the reflected reference rotation of the mirror bone to this bone's reference
+	// rotation, which makes up for left and right bones having their axes set up differently
+	FPoseRotationArray rotationCorrections;
+
+	// Multiplying a quaternion by this reflects its rotation across the mirror plane, and a location by the vector
+	FQuat rotationReflection;
+	FVector locationReflection;
+
+	int32 numBonePairs;
+};
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseBlending.h"
+#include "PoseMath.h"
+
+void PoseBlending::blendTwoPoses(const FPoseBuffer &firstPose, const FPoseBuffer &secondPose, float alpha, FPoseBuffer &outPose,
+	EPoseBlendMode blendMode)
+{
+	check(firstPose.numBones() == secondPose.numBones());
+
+	outPose.setNumBones(firstPose.numBones());
+
+	if (blendMode == EPoseBlendMode::SphericalLerp)
+	{
+		PoseMathCore::slerpTwoPoses(firstPose.view(), secondPose.view(), alpha, outPose.view());
+	}
+	else
+	{
+		PoseMathCore::blendTwoPoses(firstPose.view(), secondPose.view(), alpha, outPose.view());
+	}
+}
+
+void PoseBlending::blendQuantizedPoses(const FQuantizedPose &firstPose, const FQuantizedPose &secondPose,
+	const FPoseQuantizationFormat &format, float alpha, FPoseBuffer &outPose)
+{
+	check(firstPose.numBones() == secondPose.numBones());
+
+	const int32 numBones = firstPose.numBones();
+	outPose.setNumBones(numBones);
+
+	FQuat *outRotations = outPose.rotations.GetData();
+	FVector *outTranslations = outPose.translations.GetData();
+
+	// Dequantizing is linear, so blending the packed translation steps is the same as blending the translations
+	const FVector origin = FMath::Lerp(firstPose.origin, secondPose.origin, alpha);
+	const FVector translationOrigin = origin + format.offsetRange.minimum;
+
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		FQuat firstRotation;
+		FQuat secondRotation;
+		uint32 firstSteps[3];
+		uint32 secondSteps[3];
+		PoseQuantization::readBone(firstPose, format, boneIndex, firstRotation, firstSteps);
+		PoseQuantization::readBone(secondPose, format, boneIndex, secondRotation, secondSteps);
+		outRotations[boneIndex] = PoseMath::fromCore(PoseMathCore::nlerp(PoseMath::toCore(firstRotation), PoseMath::toCore(secondRotation), alpha));
+
+		const FVector steps(
+			FMath::Lerp((float)firstSteps[0], (float)secondSteps[0], alpha),
+			FMath::Lerp((float)firstSteps[1], (float)secondSteps[1], alpha),
+			FMath::Lerp((float)firstSteps[2], (float)secondSteps[2], alpha));
+		outTranslations[boneIndex] = translationOrigin + steps * format.offsetRange.step;
+	}
+
+	// The first bone is the origin itself
+	if (numBones > 0)
+	{
+		outTranslations[0] = origin;
+	}
+}
+
+void PoseBlending::blendWeightedPoses(const FPoseBuffer *const *poses, const float *weights, int32 numPoses, FPoseBuffer &outPose)
+{
+	check(numPoses > 0);
+
+	const int32 numBones = poses[0]->numBones();
+	outPose.setNumBones(numBones);
+
+	TArray<PoseMathCore::ConstPoseView, TInlineAllocator<8>> poseViews;
+	poseViews.Reserve(numPoses);
+	for (int32 poseIndex = 0; poseIndex < numPoses; poseIndex++)
+	{
+		check(poses[poseIndex]->numBones() == numBones);
+		check(poses[poseIndex] != &outPose);
+		poseViews.Add(poses[poseIndex]->view());
+	}
+
+	PoseMathCore::blendWeightedPoses(poseViews.GetData(), weights, numPoses, outPose.view());
+}
+
+void PoseBlending::computeSplineTangents(const FPoseBuffer *previousPose, float previousTime, const FPoseBuffer &pose, float time,
+	const FPoseBuffer *nextPose, float nextTime, FPoseBuffer &outTangents)
+{
+	outTangents.setNumBones(pose.numBones());
+
+	const PoseMathCore::ConstPoseView previousView = previousPose != nullptr ? previousPose->view() : PoseMathCore::ConstPoseView();
+	const PoseMathCore::ConstPoseView nextView = nextPose != nullptr ? nextPose->view() : PoseMathCore::ConstPoseView();
+	PoseMathCore::computeSplineTangents(previousPose != nullptr ? &previousView : nullptr, previousTime, pose.view(), time,
+		nextPose != nullptr ? &nextView : nullptr, nextTime, outTangents.view());
+}
+
+void PoseBlending::splineBlendPoses(const FPoseBuffer &firstPose, const FPoseBuffer &firstTangents, const FPoseBuffer &secondPose,
+	const FPoseBuffer &secondTangents, float alpha, float segmentDuration, FPoseBuffer &outPose)
+{
+	check(firstPose.numBones() == secondPose.numBones());
+	check(firstTangents.numBones() == firstPose.numBones() && secondTangents.numBones() == secondPose.numBones());
+	check(&outPose != &firstPose && &outPose != &secondPose);
+
+	outPose.setNumBones(firstPose.numBones());
+	PoseMathCore::splineBlendPoses(firstPose.view(), firstTangents.view(), secondPose.view(), secondTangents.view(), alpha, segmentDuration,
+		outPose.view());
+}
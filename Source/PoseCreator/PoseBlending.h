@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+#include "PoseQuantization.h"
+
+// How rotations are blended between poses
+enum class EPoseBlendMode : uint8
+{
+	// Shortest path normalized lerp, cheap and vectorized, the right choice for playback and scrubbing
+	NormalizedLerp,
+	// Shortest path spherical lerp, constant angular velocity but noticeably more expensive
+	SphericalLerp
+};
+
+// Whole pose blending on pose buffers. All of them write into a caller provided pose so that repeated blends reuse the
+// same memory. The kernels themselves are in PoseMathCore, apart from the quantized blend which needs the engine's
+// quantization.
+namespace PoseBlending
+{
+	// Blend from the first pose to the second one, alpha of 0 gives the first pose and 1 gives the second.
+	// The output may be one of the inputs.
+	void blendTwoPoses(const FPoseBuffer &firstPose, const FPoseBuffer &secondPose, float alpha, FPoseBuffer &outPose,
+		EPoseBlendMode blendMode = EPoseBlendMode::NormalizedLerp);
+
+	// The same normalized lerp as blendTwoPoses straight from two quantized poses, each bone is unpacked as it's
+	// blended so the poses are never unpacked in full
+	void blendQuantizedPoses(const FQuantizedPose &firstPose, const FQuantizedPose &secondPose,
+		const FPoseQuantizationFormat &format, float alpha, FPoseBuffer &outPose);
+
+	// Weighted blend of any number of poses. Weights are normalized, rotations are blended along the shortest path
+	// relative to the first pose. The output must not be one of the inputs.
+	void blendWeightedPoses(const FPoseBuffer *const *poses, const float *weights, int32 numPoses, FPoseBuffer &outPose);
+
+	// Work out the spline tangents of a keyframe from its neighbours, either of which may be null at the ends of the
+	// timeline. Rotations get the SQUAD control quaternion and translations the Catmull-Rom tangent per second.
+	void computeSplineTangents(const FPoseBuffer *previousPose, float previousTime, const FPoseBuffer &pose, float time,
+		const FPoseBuffer *nextPose, float nextTime, FPoseBuffer &outTangents);
+
+	// Spline blend between two keyframes using their tangents from computeSplineTangents, the segment duration is the
+	// time between the keyframes. SQUAD is evaluated with normalized lerps so it stays about as cheap as the linear blend.
+	// The output must not be one of the inputs.
+	void splineBlendPoses(const FPoseBuffer &firstPose, const FPoseBuffer &firstTangents, const FPoseBuffer &secondPose,
+		const FPoseBuffer &secondTangents, float alpha, float segmentDuration, FPoseBuffer &outPose);
+}
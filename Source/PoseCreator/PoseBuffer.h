@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseCreator.h"
+#include "PoseMathCore.h"
+
+// Pose data is kept in 16 byte aligned arrays so the blending code can load it straight into vector registers
+typedef TArray<FQuat, TAlignedHeapAllocator<16>> FPoseRotationArray;
+typedef TArray<FVector, TAlignedHeapAllocator<16>> FPoseTranslationArray;
+
+// Engine pose arrays are handed straight to the pose math core, so its types have to match the engine's
+static_assert(sizeof(FQuat) == sizeof(PoseMathCore::Quat) && sizeof(FVector) == sizeof(PoseMathCore::Vector3),
+	"The pose math core types must be laid out like FQuat and FVector");
+
+// A single pose of the skeleton stored as a structure of arrays. Entry i of each array belongs to bone i of the
+// skeleton's reference bone info, so bone names are never stored per pose.
+struct FPoseBuffer
+{
+	// The rotation of every bone
+	FPoseRotationArray rotations;
+
+	// The translation of every bone
+	FPoseTranslationArray translations;
+
+	int32 numBones() const
+	{
+		return rotations.Num();
+	}
+
+	// Resize the pose to hold the given number of bones, existing allocations are kept when shrinking
+	void setNumBones(int32 newNumBones)
+	{
+		rotations.SetNumUninitialized(newNumBones, false);
+		translations.SetNumUninitialized(newNumBones, false);
+	}
+
+	// Copy another pose into this one, reusing this pose's memory when it is big enough
+	void copyFrom(const FPoseBuffer &otherPose)
+	{
+		setNumBones(otherPose.numBones());
+		FMemory::Memcpy(rotations.GetData(), otherPose.rotations.GetData(), otherPose.numBones() * sizeof(FQuat));
+		FMemory::Memcpy(translations.GetData(), otherPose.translations.GetData(), otherPose.numBones() * sizeof(FVector));
+	}
+
+	// The pose for the pose math core, which works on the arrays in place
+	PoseMathCore::PoseView view()
+	{
+		return PoseMathCore::PoseView{ reinterpret_cast<PoseMathCore::Quat *>(rotations.GetData()),
+			reinterpret_cast<PoseMathCore::Vector3 *>(translations.GetData()), numBones() };
+	}
+
+	PoseMathCore::ConstPoseView view() const
+	{
+		return PoseMathCore::ConstPoseView{ reinterpret_cast<const PoseMathCore::Quat *>(rotations.GetData()),
+			reinterpret_cast<const PoseMathCore::Vector3 *>(translations.GetData()), numBones() };
+	}
+
+	// Memory used by the pose data
+	SIZE_T getAllocatedSize() const
+	{
+		return rotations.GetAllocatedSize() + translations.GetAllocatedSize();
+	}
+};
@@ -6,7 +6,7 @@ public class PoseCreator : ModuleRules
 {
 	public PoseCreator(ReadOnlyTargetRules Target) : base(Target)
     {
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "PoseMathCore" });
 
         //PrivateDependencyModuleNames.AddRange(new string[] { "AssetTools" });
 
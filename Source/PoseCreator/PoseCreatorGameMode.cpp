@@ -3,8 +3,19 @@
 #include "PoseCreator.h"
 #include "PoseCreatorGameMode.h"
 #include "PoseCreatorCharacter.h"
+#include "PoseReplicationComponent.h"
 
 APoseCreatorGameMode::APoseCreatorGameMode()
 {
 
 }
+
+void APoseCreatorGameMode::PostLogin(APlayerController *NewPlayer)
+{
+	Super::PostLogin(NewPlayer);
+
+	// Clients can only call the server on things they own, so the component lives on the player's own controller
+	UPoseReplicationComponent *poseReplication = NewObject<UPoseReplicationComponent>(NewPlayer);
+	poseReplication->SetIsReplicated(true);
+	poseReplication->RegisterComponent();
+}
@@ -10,6 +10,9 @@ class APoseCreatorGameMode : public AGameMode
 
 public:
 	APoseCreatorGameMode();
+
+	// Gives each player the component their pose edits go to the server through
+	virtual void PostLogin(APlayerController *NewPlayer) override;
 };
 
 
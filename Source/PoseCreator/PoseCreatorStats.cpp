@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseCreatorStats.h"
+#include "Misc/FileHelper.h"
+
+DEFINE_STAT(STAT_PoseCreator_UpdateBoneReferences);
+DEFINE_STAT(STAT_PoseCreator_BoneDrag);
+DEFINE_STAT(STAT_PoseCreator_KeyFrameCapture);
+DEFINE_STAT(STAT_PoseCreator_TimelineEvaluation);
+DEFINE_STAT(STAT_PoseCreator_ApplyEvaluatedPose);
+DEFINE_STAT(STAT_PoseCreator_ExportSnapshot);
+DEFINE_STAT(STAT_PoseCreator_ExportTracks);
+DEFINE_STAT(STAT_PoseCreator_ExportAsset);
+
+DEFINE_STAT(STAT_PoseCreator_BonesUpdated);
+DEFINE_STAT(STAT_PoseCreator_EvaluationBufferGrowth);
+DEFINE_STAT(STAT_PoseCreator_PosePoolAllocations);
+DEFINE_STAT(STAT_PoseCreator_ReplicatedBytes);
+
+namespace
+{
+	const TCHAR *timingNames[] =
+	{
+		TEXT("UpdateBoneReferencesMs"),
+		TEXT("BoneDragMs"),
+		TEXT("KeyFrameCaptureMs"),
+		TEXT("TimelineEvaluationMs"),
+		TEXT("ApplyEvaluatedPoseMs"),
+		TEXT("ExportSnapshotMs"),
+		TEXT("ExportTracksMs"),
+		TEXT("ExportAssetMs"),
+	};
+	static_assert(ARRAY_COUNT(timingNames) == (int32)EPoseCreatorTiming::Count, "Every timing needs a CSV column");
+
+	struct FTimingFrame
+	{
+		uint64 frameNumber;
+		uint32 cycles[(int32)EPoseCreatorTiming::Count];
+		int32 bonesUpdated;
+		int32 evaluationBufferGrowth;
+	};
+
+	FCriticalSection timingLock;
+	TArray<FTimingFrame> capturedFrames;
+
+	// The captured frame for the given frame number, adding it in order if it isn't there yet. Work from other
+	// threads finishes a few frames late at most, so the search only has to walk back from the end. Must hold the lock.
+	FTimingFrame &getFrame(uint64 frameNumber)
+	{
+		int32 insertIndex = capturedFrames.Num();
+		while (insertIndex > 0 && capturedFrames[insertIndex - 1].frameNumber >= frameNumber)
+		{
+			if (capturedFrames[insertIndex - 1].frameNumber == frameNumber)
+			{
+				return capturedFrames[insertIndex - 1];
+			}
+			insertIndex--;
+		}
+
+		capturedFrames.InsertZeroed(insertIndex);
+		capturedFrames[insertIndex].frameNumber = frameNumber;
+		return capturedFrames[insertIndex];
+	}
+
+	void startTimingCaptureCommand()
+	{
+		FPoseCreatorTimings::startCapture();
+	}
+
+	void stopTimingCaptureCommand(const TArray<FString> &args)
+	{
+		FString filePath = args.Num() > 0 ? args[0] : FPaths::ProfilingDir() / TEXT("PoseCreatorTimings.csv");
+		FPoseCreatorTimings::stopCapture(filePath);
+	}
+
+	FAutoConsoleCommand startTimingCaptureConsoleCommand(
+		TEXT("PoseCreator.StartTimingCapture"),
+		TEXT("Start recording per-frame timings of the posing pipeline"),
+		FConsoleCommandDelegate::CreateStatic(&startTimingCaptureCommand));
+
+	FAutoConsoleCommand stopTimingCaptureConsoleCommand(
+		TEXT("PoseCreator.StopTimingCapture"),
+		TEXT("Stop recording posing timings and write them to a CSV file, by default Saved/Profiling/PoseCreatorTimings.csv"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&stopTimingCaptureCommand));
+}
+
+FThreadSafeBool FPoseCreatorTimings::capturing(false);
+
+void FPoseCreatorTimings::startCapture()
+{
+	FScopeLock lock(&timingLock);
+	capturedFrames.Reset();
+	capturing = true;
+}
+
+bool FPoseCreatorTimings::stopCapture(const FString &filePath)
+{
+	FScopeLock lock(&timingLock);
+	capturing = false;
+
+	FString csv = TEXT("Frame");
+	for (int32 timingIndex = 0; timingIndex < (int32)EPoseCreatorTiming::Count; timingIndex++)
+	{
+		csv += TEXT(",");
+		csv += timingNames[timingIndex];
+	}
+	csv += TEXT(",BonesUpdated,EvaluationBufferGrowth\n");
+
+	for (int32 frameIndex = 0; frameIndex < capturedFrames.Num(); frameIndex++)
+	{
+		const FTimingFrame &frame = capturedFrames[frameIndex];
+		csv += FString::Printf(TEXT("%llu"), frame.frameNumber);
+		for (int32 timingIndex = 0; timingIndex < (int32)EPoseCreatorTiming::Count; timingIndex++)
+		{
+			csv += FString::Printf(TEXT(",%.4f"), FPlatformTime::ToMilliseconds(frame.cycles[timingIndex]));
+		}
+		csv += FString::Printf(TEXT(",%d,%d\n"), frame.bonesUpdated, frame.evaluationBufferGrowth);
+	}
+
+	int32 numFrames = capturedFrames.Num();
+	capturedFrames.Empty();
+
+	if (!FFileHelper::SaveStringToFile(csv, *filePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't write the posing timings to %s"), *filePath);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Wrote %d frames of posing timings to %s"), numFrames, *filePath);
+	return true;
+}
+
+void FPoseCreatorTimings::addTime(EPoseCreatorTiming timing, uint32 cycles, uint64 frameNumber)
+{
+	FScopeLock lock(&timingLock);
+	if (capturing)
+	{
+		getFrame(frameNumber).cycles[(int32)timing] += cycles;
+	}
+}
+
+void FPoseCreatorTimings::addBonesUpdated(int32 numBones)
+{
+	INC_DWORD_STAT_BY(STAT_PoseCreator_BonesUpdated, numBones);
+
+	if (capturing)
+	{
+		FScopeLock lock(&timingLock);
+		getFrame(GFrameCounter).bonesUpdated += numBones;
+	}
+}
+
+void FPoseCreatorTimings::addEvaluationBufferGrowth(int32 numGrowths, uint64 frameNumber)
+{
+	INC_DWORD_STAT_BY(STAT_PoseCreator_EvaluationBufferGrowth, numGrowths);
+
+	if (capturing)
+	{
+		FScopeLock lock(&timingLock);
+		getFrame(frameNumber).evaluationBufferGrowth += numGrowths;
+	}
+}
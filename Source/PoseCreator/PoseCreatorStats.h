@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseCreator.h"
+#include "HAL/ThreadSafeBool.h"
+
+DECLARE_STATS_GROUP(TEXT("PoseCreator"), STATGROUP_PoseCreator, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update bone references"), STAT_PoseCreator_UpdateBoneReferences, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Bone drag"), STAT_PoseCreator_BoneDrag, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Keyframe capture"), STAT_PoseCreator_KeyFrameCapture, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Timeline evaluation"), STAT_PoseCreator_TimelineEvaluation, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Apply evaluated pose"), STAT_PoseCreator_ApplyEvaluatedPose, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Export snapshot"), STAT_PoseCreator_ExportSnapshot, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Export tracks"), STAT_PoseCreator_ExportTracks, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Export asset"), STAT_PoseCreator_ExportAsset, STATGROUP_PoseCreator, POSECREATOR_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bones updated"), STAT_PoseCreator_BonesUpdated, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Evaluation buffer growth"), STAT_PoseCreator_EvaluationBufferGrowth, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pose pool allocations"), STAT_PoseCreator_PosePoolAllocations, STATGROUP_PoseCreator, POSECREATOR_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Replicated bytes"), STAT_PoseCreator_ReplicatedBytes, STATGROUP_PoseCreator, POSECREATOR_API);
+
+// Every timed part of the posing pipeline, in the order they appear in the timing CSV
+enum class EPoseCreatorTiming : uint8
+{
+	UpdateBoneReferences,
+	BoneDrag,
+	KeyFrameCapture,
+	TimelineEvaluation,
+	ApplyEvaluatedPose,
+	ExportSnapshot,
+	ExportTracks,
+	ExportAsset,
+	Count
+};
+
+// Per-frame timings of the posing pipeline that can be written out to a CSV file for offline analysis. Capturing is
+// started and stopped with the PoseCreator.StartTimingCapture and PoseCreator.StopTimingCapture console commands.
+// Timings can be added from any thread, they're only locked while a capture is running. Each sample is filed under
+// the frame that started the work, so work finishing on another thread a few frames later still lines up.
+class POSECREATOR_API FPoseCreatorTimings
+{
+public:
+	static bool isCapturing()
+	{
+		return capturing;
+	}
+
+	static void startCapture();
+
+	// Stop capturing and write the captured frames out, returns false if the file couldn't be written
+	static bool stopCapture(const FString &filePath);
+
+	static void addTime(EPoseCreatorTiming timing, uint32 cycles, uint64 frameNumber);
+	static void addBonesUpdated(int32 numBones);
+
+	// How many times evaluation had to grow the capacity of its output pose buffers, the only memory it allocates
+	static void addEvaluationBufferGrowth(int32 numGrowths, uint64 frameNumber);
+
+private:
+	static FThreadSafeBool capturing;
+};
+
+// Times a scope for the stat group, external profilers and the timing CSV
+class FPoseCreatorTimingScope
+{
+public:
+	FPoseCreatorTimingScope(EPoseCreatorTiming inTiming, const TCHAR *eventName, uint64 inFrameNumber) :
+		timing(inTiming),
+		frameNumber(inFrameNumber),
+		startCycles(FPlatformTime::Cycles())
+	{
+#if !UE_BUILD_SHIPPING
+		FPlatformMisc::BeginNamedEvent(FColor::Turquoise, eventName);
+#endif
+	}
+
+	~FPoseCreatorTimingScope()
+	{
+#if !UE_BUILD_SHIPPING
+		FPlatformMisc::EndNamedEvent();
+#endif
+		if (FPoseCreatorTimings::isCapturing())
+		{
+			FPoseCreatorTimings::addTime(timing, FPlatformTime::Cycles() - startCycles, frameNumber);
+		}
+	}
+
+private:
+	EPoseCreatorTiming timing;
+	uint64 frameNumber;
+	uint32 startCycles;
+};
+
+// Time the rest of the scope as one of the posing pipeline's timings, filed under the current frame
+#define POSECREATOR_SCOPE_TIMING(Timing) \
+	POSECREATOR_SCOPE_TIMING_FOR_FRAME(Timing, GFrameCounter)
+
+// The same for work running on another thread, filed under the frame that kicked it off
+#define POSECREATOR_SCOPE_TIMING_FOR_FRAME(Timing, FrameNumber) \
+	SCOPE_CYCLE_COUNTER(STAT_PoseCreator_##Timing); \
+	FPoseCreatorTimingScope PREPROCESSOR_JOIN(poseCreatorTimingScope, __LINE__)(EPoseCreatorTiming::Timing, TEXT(#Timing), FrameNumber)
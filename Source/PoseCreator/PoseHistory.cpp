@@ -0,0 +1,243 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseHistory.h"
+
+// Default to 16MB of history
+#define DEFAULT_HISTORY_MEMORY_BUDGET (16 * 1024 * 1024)
+
+// How many dropped edits are kept around for reuse
+#define HISTORY_MAX_FREE_EDITS 32
+
+FPoseHistory::FPoseHistory() :
+	memoryBudget(DEFAULT_HISTORY_MEMORY_BUDGET),
+	allocatedSize(0),
+	freeEditsSize(0)
+{
+	freeEdits.Reserve(HISTORY_MAX_FREE_EDITS);
+}
+
+void FPoseHistory::setMemoryBudget(SIZE_T newMemoryBudget)
+{
+	memoryBudget = newMemoryBudget;
+	compact();
+}
+
+void FPoseHistory::recordBoneEdit(const FPoseBuffer &localPoseBefore, const FPoseBuffer &localPoseAfter)
+{
+	check(localPoseBefore.numBones() == localPoseAfter.numBones());
+
+	FPoseEdit *newEdit = acquireEdit(EPoseEditType::BoneRotations);
+
+	for (int32 boneIndex = 0; boneIndex < localPoseBefore.numBones(); boneIndex++)
+	{
+		if (localPoseBefore.rotations[boneIndex] != localPoseAfter.rotations[boneIndex])
+		{
+			newEdit->boneIndices.Add(boneIndex);
+			newEdit->boneRotations.Add(localPoseBefore.rotations[boneIndex]);
+		}
+	}
+
+	// Nothing actually moved, so there's nothing to undo
+	if (newEdit->boneIndices.Num() == 0)
+	{
+		recycleEdit(TUniquePtr<FPoseEdit>(newEdit));
+		return;
+	}
+
+	pushEdit(newEdit);
+}
+
+void FPoseHistory::recordActorMove(const FVector &previousActorLocation)
+{
+	FPoseEdit *newEdit = acquireEdit(EPoseEditType::ActorMove);
+	newEdit->actorLocation = previousActorLocation;
+	pushEdit(newEdit);
+}
+
+void FPoseHistory::recordKeyFrameAdded(float keyFrameTime, bool appendedAnimationPose)
+{
+	FPoseEdit *newEdit = acquireEdit(EPoseEditType::KeyFrameAdded);
+	newEdit->keyFrameTime = keyFrameTime;
+	newEdit->appendedAnimationPose = appendedAnimationPose;
+	pushEdit(newEdit);
+}
+
+void FPoseHistory::recordKeyFrameOverwritten(float keyFrameTime, const FPoseBuffer &previousPose, const FPoseBuffer &newPose, bool appendedAnimationPose)
+{
+	check(previousPose.numBones() == newPose.numBones());
+
+	FPoseEdit *newEdit = acquireEdit(EPoseEditType::KeyFrameOverwritten);
+	newEdit->keyFrameTime = keyFrameTime;
+	newEdit->appendedAnimationPose = appendedAnimationPose;
+
+	for (int32 boneIndex = 0; boneIndex < previousPose.numBones(); boneIndex++)
+	{
+		if (previousPose.rotations[boneIndex] != newPose.rotations[boneIndex] ||
+			previousPose.translations[boneIndex] != newPose.translations[boneIndex])
+		{
+			newEdit->boneIndices.Add(boneIndex);
+			newEdit->boneRotations.Add(previousPose.rotations[boneIndex]);
+			newEdit->boneTranslations.Add(previousPose.translations[boneIndex]);
+		}
+	}
+
+	pushEdit(newEdit);
+}
+
+bool FPoseHistory::undo(TFunctionRef<void(FPoseEdit &)> applyFunction)
+{
+	if (!canUndo())
+	{
+		return false;
+	}
+
+	redoEdits.Add(undoEdits.Pop(false));
+	applyEdit(*redoEdits.Last(), applyFunction);
+	return true;
+}
+
+bool FPoseHistory::redo(TFunctionRef<void(FPoseEdit &)> applyFunction)
+{
+	if (!canRedo())
+	{
+		return false;
+	}
+
+	undoEdits.Add(redoEdits.Pop(false));
+	applyEdit(*undoEdits.Last(), applyFunction);
+	return true;
+}
+
+void FPoseHistory::applyEdit(FPoseEdit &edit, TFunctionRef<void(FPoseEdit &)> applyFunction)
+{
+	// Undoing an added keyframe hands its pose over to the edit, so the size can change
+	allocatedSize -= edit.getAllocatedSize();
+	applyFunction(edit);
+	allocatedSize += edit.getAllocatedSize();
+}
+
+void FPoseHistory::empty()
+{
+	for (int32 editIndex = 0; editIndex < undoEdits.Num(); editIndex++)
+	{
+		recycleEdit(MoveTemp(undoEdits[editIndex]));
+	}
+	for (int32 editIndex = 0; editIndex < redoEdits.Num(); editIndex++)
+	{
+		recycleEdit(MoveTemp(redoEdits[editIndex]));
+	}
+	undoEdits.Reset();
+	redoEdits.Reset();
+	allocatedSize = 0;
+}
+
+FPoseEdit *FPoseHistory::acquireEdit(EPoseEditType type)
+{
+	FPoseEdit *edit;
+	if (freeEdits.Num() > 0)
+	{
+		edit = freeEdits.Pop(false).Release();
+		freeEditsSize -= edit->getAllocatedSize();
+	}
+	else
+	{
+		edit = new FPoseEdit();
+	}
+
+	// The arrays keep their memory, everything else goes back to how a new edit starts out
+	edit->type = type;
+	edit->boneIndices.Reset();
+	edit->boneRotations.Reset();
+	edit->boneTranslations.Reset();
+	edit->actorLocation = FVector::ZeroVector;
+	edit->keyFrameTime = 0.0f;
+	edit->appendedAnimationPose = false;
+	edit->removedKeyFramePose.setNumBones(0);
+	return edit;
+}
+
+void FPoseHistory::recycleEdit(TUniquePtr<FPoseEdit> &&edit)
+{
+	if (freeEdits.Num() < HISTORY_MAX_FREE_EDITS)
+	{
+		freeEditsSize += edit->getAllocatedSize();
+		freeEdits.Add(MoveTemp(edit));
+	}
+	edit.Reset();
+}
+
+void FPoseHistory::pushEdit(FPoseEdit *newEdit)
+{
+	// A new edit branches off from the current state, so nothing that was undone can be redone anymore
+	for (int32 editIndex = 0; editIndex < redoEdits.Num(); editIndex++)
+	{
+		allocatedSize -= redoEdits[editIndex]->getAllocatedSize();
+		recycleEdit(MoveTemp(redoEdits[editIndex]));
+	}
+	redoEdits.Reset();
+
+	allocatedSize += newEdit->getAllocatedSize();
+	undoEdits.Add(TUniquePtr<FPoseEdit>(newEdit));
+
+	compact();
+}
+
+void FPoseHistory::compact()
+{
+	// Always keep the latest edit around, no matter how big it is
+	while (allocatedSize > memoryBudget && undoEdits.Num() > 1)
+	{
+		if (!mergeOldestEdits())
+		{
+			allocatedSize -= undoEdits[0]->getAllocatedSize();
+			recycleEdit(MoveTemp(undoEdits[0]));
+			undoEdits.RemoveAt(0, 1, false);
+		}
+	}
+}
+
+bool FPoseHistory::mergeOldestEdits()
+{
+	if (undoEdits.Num() < 2)
+	{
+		return false;
+	}
+
+	// Keyframe edits each touch the timeline differently, so they're only ever dropped
+	FPoseEdit &oldestEdit = *undoEdits[0];
+	const FPoseEdit &nextEdit = *undoEdits[1];
+	if (oldestEdit.type != nextEdit.type ||
+		(oldestEdit.type != EPoseEditType::BoneRotations && oldestEdit.type != EPoseEditType::ActorMove))
+	{
+		return false;
+	}
+
+	allocatedSize -= oldestEdit.getAllocatedSize() + nextEdit.getAllocatedSize();
+
+	switch (oldestEdit.type)
+	{
+	case EPoseEditType::BoneRotations:
+	{
+		// Undoing both edits has to bring back the state from before the oldest one. Bones the oldest edit changed already
+		// hold that state, bones only the next edit changed were untouched before it so its values are just as good.
+		for (int32 nextBoneIndex = 0; nextBoneIndex < nextEdit.boneIndices.Num(); nextBoneIndex++)
+		{
+			if (!oldestEdit.boneIndices.Contains(nextEdit.boneIndices[nextBoneIndex]))
+			{
+				oldestEdit.boneIndices.Add(nextEdit.boneIndices[nextBoneIndex]);
+				oldestEdit.boneRotations.Add(nextEdit.boneRotations[nextBoneIndex]);
+			}
+		}
+		break;
+	}
+	default:
+		// The location from before the oldest move is all that's needed
+		break;
+	}
+
+	recycleEdit(MoveTemp(undoEdits[1]));
+	undoEdits.RemoveAt(1, 1, false);
+	allocatedSize += oldestEdit.getAllocatedSize();
+	return true;
+}
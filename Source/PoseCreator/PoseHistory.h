@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+
+enum class EPoseEditType : uint8
+{
+	// Local rotations of some of the bones changed
+	BoneRotations,
+	// The whole actor was moved
+	ActorMove,
+	// A keyframe was added to the timeline
+	KeyFrameAdded,
+	// The pose of an existing keyframe was replaced
+	KeyFrameOverwritten
+};
+
+// One undoable edit. Edits only store the state on the other side of the edit for the bones that actually changed,
+// so undoing and redoing are the same operation: swap the stored state with the current one.
+struct FPoseEdit
+{
+	EPoseEditType type;
+
+	// The bones the edit changed, along with their rotations (and translations for keyframes) on the other side of it
+	TArray<int32> boneIndices;
+	TArray<FQuat> boneRotations;
+	TArray<FVector> boneTranslations;
+
+	// The actor location on the other side of a move
+	FVector actorLocation;
+
+	// The time of the keyframe that was added or overwritten
+	float keyFrameTime;
+
+	// Whether recording the keyframe also appended a pose to the animation being recorded
+	bool appendedAnimationPose;
+
+	// Holds the pose of an added keyframe while the add is undone
+	FPoseBuffer removedKeyFramePose;
+
+	FPoseEdit() :
+		type(EPoseEditType::BoneRotations),
+		actorLocation(FVector::ZeroVector),
+		keyFrameTime(0.0f),
+		appendedAnimationPose(false)
+	{
+	}
+
+	SIZE_T getAllocatedSize() const
+	{
+		return sizeof(FPoseEdit) + boneIndices.GetAllocatedSize() + boneRotations.GetAllocatedSize() +
+			boneTranslations.GetAllocatedSize() + removedKeyFramePose.getAllocatedSize();
+	}
+};
+
+// Undo and redo stacks for pose edits. The history is kept under a memory budget, when it goes over the oldest edits
+// are merged together and dropped once they can't be merged any further. Dropped edits are kept for reuse, so once
+// the history has warmed up recording an edit only allocates when it touches more bones than any before it.
+class FPoseHistory
+{
+public:
+	FPoseHistory();
+
+	void setMemoryBudget(SIZE_T newMemoryBudget);
+
+	// Record a change to the local rotations of the skeleton, only the bones that differ between the poses are stored
+	void recordBoneEdit(const FPoseBuffer &localPoseBefore, const FPoseBuffer &localPoseAfter);
+
+	// Record the actor moving away from a location
+	void recordActorMove(const FVector &previousActorLocation);
+
+	// Record a keyframe being added to the timeline
+	void recordKeyFrameAdded(float keyFrameTime, bool appendedAnimationPose);
+
+	// Record the pose of an existing keyframe being replaced
+	void recordKeyFrameOverwritten(float keyFrameTime, const FPoseBuffer &previousPose, const FPoseBuffer &newPose, bool appendedAnimationPose);
+
+	bool canUndo() const
+	{
+		return undoEdits.Num() > 0;
+	}
+
+	bool canRedo() const
+	{
+		return redoEdits.Num() > 0;
+	}
+
+	// Move the latest edit over to the redo stack, applyFunction swaps the edit's state with the current one.
+	// Returns false if there's nothing to undo.
+	bool undo(TFunctionRef<void(FPoseEdit &)> applyFunction);
+
+	// Move the latest undone edit back over to the undo stack, applyFunction swaps the edit's state with the current one.
+	// Returns false if there's nothing to redo.
+	bool redo(TFunctionRef<void(FPoseEdit &)> applyFunction);
+
+	void empty();
+
+	// Memory held by the undo and redo stacks along with the edits kept around for reuse
+	SIZE_T getAllocatedSize() const
+	{
+		return allocatedSize + freeEditsSize;
+	}
+
+private:
+	// A cleared out edit of the given type, reusing a dropped edit's memory when there is one
+	FPoseEdit *acquireEdit(EPoseEditType type);
+
+	// Hold onto a dropped edit so its arrays can be reused by the next one
+	void recycleEdit(TUniquePtr<FPoseEdit> &&edit);
+
+	// Add a new edit to the undo stack, clearing out anything that could have been redone
+	void pushEdit(FPoseEdit *newEdit);
+
+	// Apply an edit, keeping track of any memory it picks up or lets go of along the way
+	void applyEdit(FPoseEdit &edit, TFunctionRef<void(FPoseEdit &)> applyFunction);
+
+	// Merge and drop the oldest edits until the history fits in its budget
+	void compact();
+
+	// Fold the second oldest edit into the oldest one, returns false if the two can't be merged
+	bool mergeOldestEdits();
+
+	// Undoable edits, oldest first
+	TArray<TUniquePtr<FPoseEdit>> undoEdits;
+
+	// Undone edits, the next one to redo last
+	TArray<TUniquePtr<FPoseEdit>> redoEdits;
+
+	// Dropped edits waiting to be reused
+	TArray<TUniquePtr<FPoseEdit>> freeEdits;
+
+	SIZE_T memoryBudget;
+	SIZE_T allocatedSize;
+	SIZE_T freeEditsSize;
+};
@@ -0,0 +1,397 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseLibrary.h"
+#include "Async/ParallelFor.h"
+
+// Leaves hold a handful of poses so the search doesn't spend its time walking the tree
+#define POSE_LIBRARY_LEAF_SIZE 8
+
+// How many poses can be waiting to be indexed before a search rebuilds the tree
+#define POSE_LIBRARY_MAX_UNINDEXED_POSES 256
+
+// How many poses are looked at to pick the feature a node splits along
+#define POSE_LIBRARY_SPLIT_SAMPLES 64
+
+namespace
+{
+	struct FPoseLibrarySearchEntry
+	{
+		FPoseLibrarySearchEntry() {}
+
+		FPoseLibrarySearchEntry(int32 inNodeIndex, float inDistanceBound) :
+			nodeIndex(inNodeIndex),
+			distanceBound(inDistanceBound)
+		{
+		}
+
+		int32 nodeIndex;
+
+		// No pose under the node can be closer than this
+		float distanceBound;
+	};
+
+	struct FCloserSearchEntry
+	{
+		FORCEINLINE bool operator()(const FPoseLibrarySearchEntry &first, const FPoseLibrarySearchEntry &second) const
+		{
+			return first.distanceBound < second.distanceBound;
+		}
+	};
+}
+
+FPoseLibrary::FPoseLibrary() :
+	numIndexedSlots(0),
+	rootBoneIndex(0),
+	featureScale(1.0f),
+	featuresOutOfDate(true),
+	maxLeafChecks(0)
+{
+}
+
+void FPoseLibrary::setFeatureBones(const TArray<int32> &newFeatureBones, int32 newRootBoneIndex)
+{
+	featureBones = newFeatureBones;
+	rootBoneIndex = newRootBoneIndex;
+	featuresOutOfDate = true;
+}
+
+int32 FPoseLibrary::addPose(const FPoseBuffer &pose)
+{
+	if (poses.Num() > 0 && pose.numBones() != poses[0].numBones())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Pose has %d bones but the library holds poses with %d bones"), pose.numBones(), poses[0].numBones());
+		return INDEX_NONE;
+	}
+
+	int32 poseIndex = poses.AddDefaulted();
+	poses[poseIndex].copyFrom(pose);
+
+	// New poses go after the indexed ones until the next rebuild picks them up
+	if (!featuresOutOfDate)
+	{
+		features.AddUninitialized(numFeatures());
+		computeFeatures(pose, features.GetData() + poseIndex * numFeatures());
+		slotPoses.Add(poseIndex);
+	}
+
+	return poseIndex;
+}
+
+void FPoseLibrary::empty()
+{
+	poses.Empty();
+	features.Empty();
+	slotPoses.Empty();
+	treeNodes.Empty();
+	numIndexedSlots = 0;
+	featuresOutOfDate = true;
+}
+
+void FPoseLibrary::computeFeatures(const FPoseBuffer &pose, float *outFeatures) const
+{
+	const FVector rootLocation = pose.translations[rootBoneIndex];
+	const FQuat inverseRootRotation = pose.rotations[rootBoneIndex].Inverse();
+
+	for (int32 featureBoneIndex = 0; featureBoneIndex < resolvedFeatureBones.Num(); featureBoneIndex++)
+	{
+		FVector boneOffset = inverseRootRotation.RotateVector(pose.translations[resolvedFeatureBones[featureBoneIndex]] - rootLocation) * featureScale;
+		outFeatures[featureBoneIndex * 3 + 0] = boneOffset.X;
+		outFeatures[featureBoneIndex * 3 + 1] = boneOffset.Y;
+		outFeatures[featureBoneIndex * 3 + 2] = boneOffset.Z;
+	}
+}
+
+void FPoseLibrary::refreshFeatures()
+{
+	featuresOutOfDate = false;
+	treeNodes.Reset();
+	numIndexedSlots = 0;
+	resolvedFeatureBones.Reset();
+
+	const int32 numLibraryPoses = poses.Num();
+	if (numLibraryPoses == 0)
+	{
+		features.Reset();
+		slotPoses.Reset();
+		featuresOutOfDate = true;
+		return;
+	}
+
+	// The root is always at the origin of the features so there's no point comparing it
+	const int32 numBones = poses[0].numBones();
+	rootBoneIndex = FMath::Clamp(rootBoneIndex, 0, numBones - 1);
+	for (int32 featureBoneIndex = 0; featureBoneIndex < featureBones.Num(); featureBoneIndex++)
+	{
+		int32 boneIndex = featureBones[featureBoneIndex];
+		if (boneIndex >= 0 && boneIndex < numBones && boneIndex != rootBoneIndex)
+		{
+			resolvedFeatureBones.AddUnique(boneIndex);
+		}
+	}
+	if (resolvedFeatureBones.Num() == 0)
+	{
+		for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			if (boneIndex != rootBoneIndex)
+			{
+				resolvedFeatureBones.Add(boneIndex);
+			}
+		}
+	}
+
+	// Measure the skeleton by how far its bones reach from the root in the first pose
+	const FPoseBuffer &firstPose = poses[0];
+	float skeletonSize = 0.0f;
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		skeletonSize = FMath::Max(skeletonSize, FVector::Dist(firstPose.translations[boneIndex], firstPose.translations[rootBoneIndex]));
+	}
+	featureScale = 1.0f / FMath::Max(skeletonSize, KINDA_SMALL_NUMBER);
+
+	features.SetNumUninitialized(numLibraryPoses * numFeatures());
+	slotPoses.SetNumUninitialized(numLibraryPoses);
+	ParallelFor(numLibraryPoses, [this](int32 poseIndex)
+	{
+		computeFeatures(poses[poseIndex], features.GetData() + poseIndex * numFeatures());
+		slotPoses[poseIndex] = poseIndex;
+	});
+}
+
+void FPoseLibrary::build()
+{
+	if (featuresOutOfDate)
+	{
+		refreshFeatures();
+	}
+
+	treeNodes.Reset();
+	numIndexedSlots = slotPoses.Num();
+	if (numIndexedSlots > 0)
+	{
+		buildNode(0, numIndexedSlots);
+	}
+}
+
+int32 FPoseLibrary::buildNode(int32 firstSlot, int32 numSlots)
+{
+	int32 nodeIndex = treeNodes.AddUninitialized();
+	FTreeNode leaf;
+	leaf.splitFeature = INDEX_NONE;
+	leaf.splitValue = 0.0f;
+	leaf.children[0] = INDEX_NONE;
+	leaf.children[1] = INDEX_NONE;
+	leaf.firstSlot = firstSlot;
+	leaf.numSlots = numSlots;
+	treeNodes[nodeIndex] = leaf;
+
+	if (numSlots <= POSE_LIBRARY_LEAF_SIZE)
+	{
+		return nodeIndex;
+	}
+
+	// Split along the feature that varies the most over a sample of the poses
+	const int32 sampleStep = FMath::Max(1, numSlots / POSE_LIBRARY_SPLIT_SAMPLES);
+	int32 splitFeature = INDEX_NONE;
+	float widestSpread = 0.0f;
+	for (int32 feature = 0; feature < numFeatures(); feature++)
+	{
+		float minValue = MAX_flt;
+		float maxValue = -MAX_flt;
+		for (int32 slot = firstSlot; slot < firstSlot + numSlots; slot += sampleStep)
+		{
+			float value = getSlotFeatures(slot)[feature];
+			minValue = FMath::Min(minValue, value);
+			maxValue = FMath::Max(maxValue, value);
+		}
+
+		if (maxValue - minValue > widestSpread)
+		{
+			widestSpread = maxValue - minValue;
+			splitFeature = feature;
+		}
+	}
+
+	// Every sampled pose is the same, splitting wouldn't separate anything
+	if (splitFeature == INDEX_NONE)
+	{
+		return nodeIndex;
+	}
+
+	const int32 numFirstHalf = numSlots / 2;
+	selectMedian(firstSlot, numSlots, splitFeature);
+
+	treeNodes[nodeIndex].splitFeature = splitFeature;
+	treeNodes[nodeIndex].splitValue = getSlotFeatures(firstSlot + numFirstHalf)[splitFeature];
+
+	int32 firstChild = buildNode(firstSlot, numFirstHalf);
+	int32 secondChild = buildNode(firstSlot + numFirstHalf, numSlots - numFirstHalf);
+	treeNodes[nodeIndex].children[0] = firstChild;
+	treeNodes[nodeIndex].children[1] = secondChild;
+	return nodeIndex;
+}
+
+void FPoseLibrary::selectMedian(int32 firstSlot, int32 numSlots, int32 feature)
+{
+	const int32 medianSlot = firstSlot + numSlots / 2;
+	int32 low = firstSlot;
+	int32 high = firstSlot + numSlots - 1;
+
+	// Quickselect, only the side holding the median is partitioned further
+	while (low < high)
+	{
+		const float pivot = getSlotFeatures((low + high) / 2)[feature];
+		int32 left = low;
+		int32 right = high;
+
+		while (left <= right)
+		{
+			while (getSlotFeatures(left)[feature] < pivot)
+			{
+				left++;
+			}
+			while (getSlotFeatures(right)[feature] > pivot)
+			{
+				right--;
+			}
+			if (left <= right)
+			{
+				swapSlots(left, right);
+				left++;
+				right--;
+			}
+		}
+
+		if (medianSlot <= right)
+		{
+			high = right;
+		}
+		else if (medianSlot >= left)
+		{
+			low = left;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+void FPoseLibrary::swapSlots(int32 firstSlot, int32 secondSlot)
+{
+	float *firstFeatures = features.GetData() + firstSlot * numFeatures();
+	float *secondFeatures = features.GetData() + secondSlot * numFeatures();
+	for (int32 feature = 0; feature < numFeatures(); feature++)
+	{
+		Swap(firstFeatures[feature], secondFeatures[feature]);
+	}
+	Swap(slotPoses[firstSlot], slotPoses[secondSlot]);
+}
+
+float FPoseLibrary::featureDistanceSquared(const float *first, const float *second, float cutoff) const
+{
+	float distanceSquared = 0.0f;
+	for (int32 feature = 0; feature < numFeatures(); feature += 3)
+	{
+		float x = first[feature] - second[feature];
+		float y = first[feature + 1] - second[feature + 1];
+		float z = first[feature + 2] - second[feature + 2];
+		distanceSquared += x * x + y * y + z * z;
+
+		if (distanceSquared >= cutoff)
+		{
+			break;
+		}
+	}
+	return distanceSquared;
+}
+
+int32 FPoseLibrary::findNearestPose(const FPoseBuffer &pose, float *outDistance)
+{
+	if (featuresOutOfDate || slotPoses.Num() - numIndexedSlots > POSE_LIBRARY_MAX_UNINDEXED_POSES)
+	{
+		build();
+	}
+
+	if (slotPoses.Num() == 0 || pose.numBones() != poses[0].numBones())
+	{
+		return INDEX_NONE;
+	}
+
+	TArray<float, TInlineAllocator<256>> queryFeatures;
+	queryFeatures.SetNumUninitialized(numFeatures());
+	computeFeatures(pose, queryFeatures.GetData());
+
+	float bestDistanceSquared = MAX_flt;
+	int32 bestSlot = INDEX_NONE;
+
+	auto checkSlots = [this, &queryFeatures, &bestDistanceSquared, &bestSlot](int32 firstSlot, int32 numSlots)
+	{
+		for (int32 slot = firstSlot; slot < firstSlot + numSlots; slot++)
+		{
+			float distanceSquared = featureDistanceSquared(queryFeatures.GetData(), getSlotFeatures(slot), bestDistanceSquared);
+			if (distanceSquared < bestDistanceSquared)
+			{
+				bestDistanceSquared = distanceSquared;
+				bestSlot = slot;
+			}
+		}
+	};
+
+	// Best bin first: always carry on from the unexplored branch that could hold the closest pose, and stop once no
+	// branch can beat the best pose found or the leaf budget runs out
+	if (treeNodes.Num() > 0)
+	{
+		TArray<FPoseLibrarySearchEntry, TInlineAllocator<64>> searchQueue;
+		searchQueue.HeapPush(FPoseLibrarySearchEntry(0, 0.0f), FCloserSearchEntry());
+		int32 leafChecks = 0;
+
+		while (searchQueue.Num() > 0)
+		{
+			FPoseLibrarySearchEntry entry;
+			searchQueue.HeapPop(entry, FCloserSearchEntry(), false);
+			if (entry.distanceBound >= bestDistanceSquared)
+			{
+				break;
+			}
+
+			// Walk down to the leaf on the query's side, queueing up the other side of every split on the way
+			const FTreeNode *node = &treeNodes[entry.nodeIndex];
+			while (!node->isLeaf())
+			{
+				float splitDistance = queryFeatures[node->splitFeature] - node->splitValue;
+				int32 nearChild = splitDistance < 0.0f ? node->children[0] : node->children[1];
+				int32 farChild = splitDistance < 0.0f ? node->children[1] : node->children[0];
+
+				float farBound = FMath::Max(entry.distanceBound, splitDistance * splitDistance);
+				if (farBound < bestDistanceSquared)
+				{
+					searchQueue.HeapPush(FPoseLibrarySearchEntry(farChild, farBound), FCloserSearchEntry());
+				}
+				node = &treeNodes[nearChild];
+			}
+
+			checkSlots(node->firstSlot, node->numSlots);
+
+			leafChecks++;
+			if (maxLeafChecks > 0 && leafChecks >= maxLeafChecks)
+			{
+				break;
+			}
+		}
+	}
+
+	// Poses added since the last build aren't in the tree yet
+	checkSlots(numIndexedSlots, slotPoses.Num() - numIndexedSlots);
+
+	if (bestSlot == INDEX_NONE)
+	{
+		return INDEX_NONE;
+	}
+
+	if (outDistance != nullptr)
+	{
+		*outDistance = FMath::Sqrt(bestDistanceSquared);
+	}
+	return slotPoses[bestSlot];
+}
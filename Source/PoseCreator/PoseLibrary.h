@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+
+// A library of saved poses that can quickly find the stored pose closest to a given one. Each pose is turned into a
+// feature vector of bone locations relative to the root bone, scaled by the size of the skeleton, and the features are
+// indexed by a k-d tree. Poses added after the tree was built are checked linearly until the next rebuild.
+class FPoseLibrary
+{
+public:
+	FPoseLibrary();
+
+	// The bones poses are compared by, an empty list compares every bone. The root bone is what the other bones are
+	// measured from, so the comparison doesn't care where the skeleton is standing or which way it's facing.
+	void setFeatureBones(const TArray<int32> &newFeatureBones, int32 newRootBoneIndex);
+
+	// Limit how many leaves of the tree a search looks at, trading exactness for speed. Zero or less searches exactly.
+	void setMaxLeafChecks(int32 newMaxLeafChecks)
+	{
+		maxLeafChecks = newMaxLeafChecks;
+	}
+
+	// Add a pose to the library, returns its index
+	int32 addPose(const FPoseBuffer &pose);
+
+	int32 numPoses() const
+	{
+		return poses.Num();
+	}
+
+	const FPoseBuffer &getPose(int32 poseIndex) const
+	{
+		return poses[poseIndex];
+	}
+
+	void empty();
+
+	// Index every pose in the library, searches do this on their own once enough poses are waiting to be indexed
+	void build();
+
+	// The library pose closest to the given one, INDEX_NONE if the library is empty
+	int32 findNearestPose(const FPoseBuffer &pose, float *outDistance = nullptr);
+
+private:
+	struct FTreeNode
+	{
+		// Interior nodes split their points along one feature
+		int32 splitFeature;
+		float splitValue;
+		int32 children[2];
+
+		// Leaves own a range of feature slots
+		int32 firstSlot;
+		int32 numSlots;
+
+		bool isLeaf() const
+		{
+			return children[0] == INDEX_NONE;
+		}
+	};
+
+	int32 numFeatures() const
+	{
+		return resolvedFeatureBones.Num() * 3;
+	}
+
+	const float *getSlotFeatures(int32 slot) const
+	{
+		return features.GetData() + slot * numFeatures();
+	}
+
+	// Write out the feature vector of a pose
+	void computeFeatures(const FPoseBuffer &pose, float *outFeatures) const;
+
+	// Work out which bones are compared and how big the skeleton is, then recompute the features of every pose
+	void refreshFeatures();
+
+	// Split the slots in [firstSlot, firstSlot + numSlots) into a subtree, returns the index of its root node
+	int32 buildNode(int32 firstSlot, int32 numSlots);
+
+	// Move the slot with the median value of a feature into the middle of the range, with smaller values before it
+	void selectMedian(int32 firstSlot, int32 numSlots, int32 feature);
+
+	void swapSlots(int32 firstSlot, int32 secondSlot);
+
+	// Squared distance between two feature vectors, giving up once it's past the cutoff
+	float featureDistanceSquared(const float *first, const float *second, float cutoff) const;
+
+	// Every pose in the order it was added
+	TArray<FPoseBuffer> poses;
+
+	// Feature vectors in tree order, with the poses that haven't been indexed yet after the indexed ones
+	TArray<float> features;
+
+	// Which pose each feature slot belongs to
+	TArray<int32> slotPoses;
+
+	// The tree over the indexed slots, node 0 is the root
+	TArray<FTreeNode> treeNodes;
+	int32 numIndexedSlots;
+
+	// The bones the features are built from, as requested and as actually used
+	TArray<int32> featureBones;
+	TArray<int32> resolvedFeatureBones;
+	int32 rootBoneIndex;
+
+	// Bone offsets are divided by this so the features don't depend on the size of the skeleton
+	float featureScale;
+
+	// Whether the features need to be recomputed before the next search
+	bool featuresOutOfDate;
+
+	int32 maxLeafChecks;
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseCreator.h"
+#include "PoseMathCore.h"
+
+// Engine type wrappers around the controller driven bone math in PoseMathCore, which is tested and measured on its own
+namespace PoseMath
+{
+	FORCEINLINE PoseMathCore::Vector3 toCore(const FVector &vector)
+	{
+		return PoseMathCore::Vector3{ vector.X, vector.Y, vector.Z };
+	}
+
+	FORCEINLINE PoseMathCore::Quat toCore(const FQuat &quat)
+	{
+		return PoseMathCore::Quat{ quat.X, quat.Y, quat.Z, quat.W };
+	}
+
+	FORCEINLINE FVector fromCore(const PoseMathCore::Vector3 &vector)
+	{
+		return FVector(vector.x, vector.y, vector.z);
+	}
+
+	FORCEINLINE FQuat fromCore(const PoseMathCore::Quat &quat)
+	{
+		return FQuat(quat.x, quat.y, quat.z, quat.w);
+	}
+
+	// See PoseMathCore::dragBoneRotation
+	FORCEINLINE FQuat dragBoneRotation(const FQuat &startingRotation, const FVector &startingDirection, const FVector &currentDirection, float twistRadians)
+	{
+		return fromCore(PoseMathCore::dragBoneRotation(toCore(startingRotation), toCore(startingDirection), toCore(currentDirection), twistRadians));
+	}
+
+	// See PoseMathCore::twoHandRotation
+	FORCEINLINE FQuat twoHandRotation(const FQuat &startingRotation, const FVector &startingHandsVector, const FVector &currentHandsVector)
+	{
+		return fromCore(PoseMathCore::twoHandRotation(toCore(startingRotation), toCore(startingHandsVector), toCore(currentHandsVector)));
+	}
+
+	// See PoseMathCore::flattenHandsVector
+	FORCEINLINE FVector flattenHandsVector(const FVector &handsVector)
+	{
+		return fromCore(PoseMathCore::flattenHandsVector(toCore(handsVector)));
+	}
+}
@@ -0,0 +1,321 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseMathBenchmarkCommandlet.h"
+#include "KeyframeTimeline.h"
+#include "AnimationExporter.h"
+#include "PoseQuantization.h"
+
+// Keyframes in the benchmark timeline, one per second
+#define BENCHMARK_KEYFRAMES 64
+
+// Frames in the benchmark export, four seconds at 30fps
+#define BENCHMARK_EXPORT_FRAMES 120
+
+namespace
+{
+	void makeRandomPose(FRandomStream &random, int32 numBones, FPoseBuffer &outPose)
+	{
+		outPose.setNumBones(numBones);
+		for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			outPose.rotations[boneIndex] = FRotator(random.FRandRange(-180.0f, 180.0f), random.FRandRange(-180.0f, 180.0f), random.FRandRange(-180.0f, 180.0f)).Quaternion();
+			outPose.translations[boneIndex] = random.GetUnitVector() * random.FRandRange(0.0f, 100.0f);
+		}
+	}
+
+	// Logs a failed check and counts it, the checks keep going so one run shows everything that's wrong
+	void checkResult(bool passed, const TCHAR *checkName, int32 &numFailures)
+	{
+		if (!passed)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Check failed: %s!!!"), checkName);
+			numFailures++;
+		}
+	}
+
+	bool rotationsMatch(const FQuat &first, const FQuat &second, float toleranceDegrees = 0.01f)
+	{
+		return FMath::RadiansToDegrees(first.AngularDistance(second)) <= toleranceDegrees;
+	}
+
+	bool posesMatch(const FPoseBuffer &first, const FPoseBuffer &second, float toleranceDegrees, float tolerance)
+	{
+		if (first.numBones() != second.numBones())
+		{
+			return false;
+		}
+
+		for (int32 boneIndex = 0; boneIndex < first.numBones(); boneIndex++)
+		{
+			if (!rotationsMatch(first.rotations[boneIndex], second.rotations[boneIndex], toleranceDegrees) ||
+				!first.translations[boneIndex].Equals(second.translations[boneIndex], tolerance))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Two bone pose turned around up and moved along forward, the second bone sits above the first
+	void makeTurnedPose(float angleDegrees, float forwardDistance, FPoseBuffer &outPose)
+	{
+		outPose.setNumBones(2);
+		for (int32 boneIndex = 0; boneIndex < 2; boneIndex++)
+		{
+			outPose.rotations[boneIndex] = FQuat(FVector::UpVector, FMath::DegreesToRadians(angleDegrees));
+			outPose.translations[boneIndex] = FVector(forwardDistance, 0.0f, 10.0f * boneIndex);
+		}
+	}
+
+	// A timeline with a key a second turned and moved by each of the amounts
+	void makeTurnedTimeline(const float *amounts, int32 numKeyFrames, FKeyframeTimeline &outTimeline)
+	{
+		for (int32 keyFrameIndex = 0; keyFrameIndex < numKeyFrames; keyFrameIndex++)
+		{
+			FPoseBuffer keyFramePose;
+			makeTurnedPose(amounts[keyFrameIndex], amounts[keyFrameIndex], keyFramePose);
+
+			bool overwroteKeyFrame;
+			outTimeline.setKeyFrame((float)keyFrameIndex, MoveTemp(keyFramePose), overwroteKeyFrame);
+		}
+	}
+
+	// Make sure the timeline gives known answers before timing it, returns the number of checks that failed
+	int32 runCorrectnessChecks()
+	{
+		int32 numFailures = 0;
+
+		// Two keyframes two seconds apart, the second turned a quarter turn around up and moved along forward
+		FPoseBuffer firstPose;
+		FPoseBuffer secondPose;
+		FPoseBuffer halfwayPose;
+		firstPose.setNumBones(2);
+		secondPose.setNumBones(2);
+		halfwayPose.setNumBones(2);
+		for (int32 boneIndex = 0; boneIndex < 2; boneIndex++)
+		{
+			firstPose.rotations[boneIndex] = FQuat::Identity;
+			firstPose.translations[boneIndex] = FVector(0.0f, 0.0f, 10.0f * boneIndex);
+			secondPose.rotations[boneIndex] = FQuat(FVector::UpVector, HALF_PI);
+			secondPose.translations[boneIndex] = FVector(10.0f, 0.0f, 10.0f * boneIndex);
+			halfwayPose.rotations[boneIndex] = FQuat(FVector::UpVector, HALF_PI * 0.5f);
+			halfwayPose.translations[boneIndex] = FVector(5.0f, 0.0f, 10.0f * boneIndex);
+		}
+
+		FKeyframeTimeline timeline;
+		bool overwroteKeyFrame;
+		timeline.setKeyFrame(0.0f, FPoseBuffer(firstPose), overwroteKeyFrame);
+		timeline.setKeyFrame(2.0f, FPoseBuffer(secondPose), overwroteKeyFrame);
+
+		FPoseBuffer evaluatedPose;
+		checkResult(timeline.evaluate(0.0f, evaluatedPose) && posesMatch(evaluatedPose, firstPose, 0.01f, KINDA_SMALL_NUMBER), TEXT("Evaluate at first key"), numFailures);
+		checkResult(timeline.evaluate(2.0f, evaluatedPose) && posesMatch(evaluatedPose, secondPose, 0.01f, KINDA_SMALL_NUMBER), TEXT("Evaluate at second key"), numFailures);
+		checkResult(timeline.evaluate(1.0f, evaluatedPose) && posesMatch(evaluatedPose, halfwayPose, 0.01f, KINDA_SMALL_NUMBER), TEXT("Evaluate between keys"), numFailures);
+		checkResult(timeline.evaluate(5.0f, evaluatedPose) && posesMatch(evaluatedPose, secondPose, 0.01f, KINDA_SMALL_NUMBER), TEXT("Evaluate past the last key"), numFailures);
+
+		// Splines still pass through every key
+		timeline.setInterpolation(ETimelineInterpolation::Spline);
+		checkResult(timeline.evaluate(0.0f, evaluatedPose) && posesMatch(evaluatedPose, firstPose, 0.01f, KINDA_SMALL_NUMBER), TEXT("Spline at first key"), numFailures);
+		checkResult(timeline.evaluate(2.0f, evaluatedPose) && posesMatch(evaluatedPose, secondPose, 0.01f, KINDA_SMALL_NUMBER), TEXT("Spline at second key"), numFailures);
+		timeline.setInterpolation(ETimelineInterpolation::Linear);
+
+		// Evenly spaced keys turning around one axis and moving along one line leave the spline nothing to smooth out,
+		// so between the keys it has to match the linear blend
+		{
+			const float evenAmounts[] = { 0.0f, 30.0f, 60.0f, 90.0f };
+			FKeyframeTimeline evenTimeline;
+			makeTurnedTimeline(evenAmounts, ARRAY_COUNT(evenAmounts), evenTimeline);
+
+			const float sampleTimes[] = { 0.25f, 1.5f, 2.75f };
+			FPoseBuffer linearPose;
+			bool splineMatchesLinear = true;
+			for (float sampleTime : sampleTimes)
+			{
+				evenTimeline.setInterpolation(ETimelineInterpolation::Linear);
+				evenTimeline.evaluate(sampleTime, linearPose);
+				evenTimeline.setInterpolation(ETimelineInterpolation::Spline);
+				splineMatchesLinear &= evenTimeline.evaluate(sampleTime, evaluatedPose) && posesMatch(evaluatedPose, linearPose, 0.01f, KINDA_SMALL_NUMBER);
+			}
+			checkResult(splineMatchesLinear, TEXT("Spline through evenly spaced keys"), numFailures);
+		}
+
+		// Unevenly spaced keys at 0, 20, 80 and 90. Halfway between the middle two keys the SQUAD control points are at
+		// 10 and 92.5 degrees, which puts the rotation at 50.625 degrees, and the Catmull-Rom tangents of 40 and 35 a
+		// second put the translation at 50.625 as well. The linear blend would give 50.
+		FPoseBuffer unevenPose;
+		makeTurnedPose(50.625f, 50.625f, unevenPose);
+		{
+			const float unevenAmounts[] = { 0.0f, 20.0f, 80.0f, 90.0f };
+			FKeyframeTimeline unevenTimeline;
+			makeTurnedTimeline(unevenAmounts, ARRAY_COUNT(unevenAmounts), unevenTimeline);
+			unevenTimeline.setInterpolation(ETimelineInterpolation::Spline);
+			checkResult(unevenTimeline.evaluate(1.5f, evaluatedPose) && posesMatch(evaluatedPose, unevenPose, 0.01f, 1e-3f),
+				TEXT("Spline between unevenly spaced keys"), numFailures);
+		}
+
+		// Packed keyframes stay within the error the quantization promises
+		// The format is picked from the precision asked for, so the keys have to come back within it
+		FPoseQuantizationFormat format;
+		checkResult(FPoseQuantizationFormat::findFormat(FBox(FVector(-20.0f), FVector(20.0f)), 0.01f, FMath::DegreesToRadians(0.05f), format) &&
+			format.rotationBits < QUANTIZED_POSE_MAX_ROTATION_BITS && format.offsetRange.bits < QUANTIZED_TRANSLATION_MAX_BITS,
+			TEXT("Quantization format"), numFailures);
+		timeline.setStorage(EKeyFrameStorage::Quantized, format);
+		checkResult(timeline.evaluate(2.0f, evaluatedPose) && posesMatch(evaluatedPose, secondPose, 0.05f, 0.01f), TEXT("Quantized key"), numFailures);
+		checkResult(timeline.evaluate(1.0f, evaluatedPose) && posesMatch(evaluatedPose, halfwayPose, 0.05f, 0.01f), TEXT("Quantized between keys"), numFailures);
+
+		// Quantized splines work their tangents out on the fly, and still pass through every key
+		timeline.setInterpolation(ETimelineInterpolation::Spline);
+		checkResult(timeline.evaluate(2.0f, evaluatedPose) && posesMatch(evaluatedPose, secondPose, 0.05f, 0.01f), TEXT("Quantized spline at key"), numFailures);
+		timeline.setInterpolation(ETimelineInterpolation::Linear);
+
+		// Between the keys of the uneven timeline the quantized spline has to follow the full precision one, in the first
+		// segment with no key before it, the middle one with keys on both sides and the last one with no key after it.
+		// Errors in the neighbouring keys reach the tangents as well, so it's allowed twice the precision of a key.
+		{
+			const float unevenAmounts[] = { 0.0f, 20.0f, 80.0f, 90.0f };
+			FKeyframeTimeline unevenTimeline;
+			makeTurnedTimeline(unevenAmounts, ARRAY_COUNT(unevenAmounts), unevenTimeline);
+			unevenTimeline.setInterpolation(ETimelineInterpolation::Spline);
+
+			FPoseQuantizationFormat unevenFormat;
+			const bool foundFormat = FPoseQuantizationFormat::findFormat(FBox(FVector(-100.0f), FVector(100.0f)), 0.01f,
+				FMath::DegreesToRadians(0.05f), unevenFormat);
+
+			const float sampleTimes[] = { 0.25f, 0.5f, 1.25f, 1.5f, 1.75f, 2.5f, 2.75f };
+			FPoseBuffer fullPrecisionPoses[ARRAY_COUNT(sampleTimes)];
+			bool evaluatedFullPrecision = true;
+			for (int32 sampleIndex = 0; sampleIndex < ARRAY_COUNT(sampleTimes); sampleIndex++)
+			{
+				evaluatedFullPrecision &= unevenTimeline.evaluate(sampleTimes[sampleIndex], fullPrecisionPoses[sampleIndex]);
+			}
+
+			unevenTimeline.setStorage(EKeyFrameStorage::Quantized, unevenFormat);
+			bool quantizedMatchesFullPrecision = foundFormat && evaluatedFullPrecision;
+			for (int32 sampleIndex = 0; sampleIndex < ARRAY_COUNT(sampleTimes); sampleIndex++)
+			{
+				quantizedMatchesFullPrecision &= unevenTimeline.evaluate(sampleTimes[sampleIndex], evaluatedPose) &&
+					posesMatch(evaluatedPose, fullPrecisionPoses[sampleIndex], 0.1f, 0.02f);
+			}
+			checkResult(quantizedMatchesFullPrecision, TEXT("Quantized spline between keys"), numFailures);
+			checkResult(unevenTimeline.evaluate(1.5f, evaluatedPose) && posesMatch(evaluatedPose, unevenPose, 0.1f, 0.02f),
+				TEXT("Quantized spline between unevenly spaced keys"), numFailures);
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Correctness checks %s, %d failed"), numFailures == 0 ? TEXT("passed") : TEXT("FAILED"), numFailures);
+		return numFailures;
+	}
+
+	void reportResult(const TCHAR *benchmarkName, int32 numBones, double seconds, int32 numPoses)
+	{
+		double nanosecondsPerBone = seconds * 1e9 / ((double)numPoses * numBones);
+		double posesPerSecond = numPoses / seconds;
+		UE_LOG(LogTemp, Display, TEXT("%-24s %5d bones %10.2f ns/bone %14.1f poses/sec"), benchmarkName, numBones, nanosecondsPerBone, posesPerSecond);
+	}
+}
+
+UPoseMathBenchmarkCommandlet::UPoseMathBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer) :
+	Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UPoseMathBenchmarkCommandlet::Main(const FString &Params)
+{
+	FString boneCountList = TEXT("20,100,500,2000");
+	FParse::Value(*Params, TEXT("bones="), boneCountList);
+
+	int32 iterations = 2000;
+	FParse::Value(*Params, TEXT("iterations="), iterations);
+	iterations = FMath::Max(iterations, 1);
+
+	TArray<FString> boneCounts;
+	boneCountList.ParseIntoArray(boneCounts, TEXT(","));
+
+	// Timing math that gives the wrong answer is no use, so bail out before benchmarking if any check fails
+	if (runCorrectnessChecks() > 0)
+	{
+		return 1;
+	}
+
+	// Everything the benchmarks produce is folded into this and logged, so none of the work can be optimized away
+	float checksum = 0.0f;
+	FRandomStream random(1234);
+
+	for (int32 boneCountIndex = 0; boneCountIndex < boneCounts.Num(); boneCountIndex++)
+	{
+		const int32 numBones = FCString::Atoi(*boneCounts[boneCountIndex]);
+		if (numBones <= 0)
+		{
+			continue;
+		}
+
+		FKeyframeTimeline timeline;
+		timeline.reserve(BENCHMARK_KEYFRAMES);
+		for (int32 keyFrameIndex = 0; keyFrameIndex < BENCHMARK_KEYFRAMES; keyFrameIndex++)
+		{
+			FPoseBuffer keyFramePose;
+			makeRandomPose(random, numBones, keyFramePose);
+
+			bool overwroteKeyFrame;
+			timeline.setKeyFrame((float)keyFrameIndex, MoveTemp(keyFramePose), overwroteKeyFrame);
+		}
+
+		// Search and interpolation together, the way playback uses them
+		{
+			FPoseBuffer evaluatedPose;
+
+			double startTime = FPlatformTime::Seconds();
+			for (int32 iteration = 0; iteration < iterations; iteration++)
+			{
+				timeline.evaluate((float)iteration / iterations * BENCHMARK_KEYFRAMES, evaluatedPose);
+			}
+			reportResult(TEXT("Timeline evaluation"), numBones, FPlatformTime::Seconds() - startTime, iterations);
+			checksum += evaluatedPose.rotations[0].Y;
+
+			// The same again with the keyframes packed down, random bones are within 200 units of the first one
+			timeline.setStorage(EKeyFrameStorage::Quantized, FPoseQuantizationFormat(FTranslationQuantizationRange(FBox(FVector(-200.0f), FVector(200.0f))),
+				QUANTIZED_QUAT_COMPONENT_BITS));
+
+			startTime = FPlatformTime::Seconds();
+			for (int32 iteration = 0; iteration < iterations; iteration++)
+			{
+				timeline.evaluate((float)iteration / iterations * BENCHMARK_KEYFRAMES, evaluatedPose);
+			}
+			reportResult(TEXT("Quantized evaluation"), numBones, FPlatformTime::Seconds() - startTime, iterations);
+			checksum += evaluatedPose.rotations[0].Y;
+
+			timeline.setStorage(EKeyFrameStorage::Full, FPoseQuantizationFormat());
+		}
+
+		// Building export tracks, counted per exported frame
+		{
+			FAnimationExportSnapshot snapshot;
+			snapshot.boneNames.SetNum(numBones);
+			snapshot.boneScales.Init(FVector(1.0f), numBones);
+			snapshot.poses.SetNum(BENCHMARK_EXPORT_FRAMES);
+			for (int32 frameIndex = 0; frameIndex < BENCHMARK_EXPORT_FRAMES; frameIndex++)
+			{
+				timeline.evaluate((float)frameIndex / BENCHMARK_EXPORT_FRAMES * BENCHMARK_KEYFRAMES, snapshot.poses[frameIndex]);
+			}
+
+			const int32 exportIterations = FMath::Max(iterations / 100, 3);
+			TArray<FRawAnimSequenceTrack> tracks;
+			FKeyReductionStats stats;
+
+			double startTime = FPlatformTime::Seconds();
+			for (int32 iteration = 0; iteration < exportIterations; iteration++)
+			{
+				AnimationExporter::buildTracks(snapshot, tracks, stats);
+			}
+			reportResult(TEXT("Export track building"), numBones, FPlatformTime::Seconds() - startTime, exportIterations * BENCHMARK_EXPORT_FRAMES);
+			checksum += stats.keptKeys;
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Benchmark checksum %f"), checksum);
+	return 0;
+}
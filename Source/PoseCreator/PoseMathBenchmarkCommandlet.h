@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "PoseMathBenchmarkCommandlet.generated.h"
+
+// Times the parts of the posing math that need the engine, without loading a map or creating any actors. Run it with
+//
+//   UE4Editor-Cmd PoseCreator.uproject -run=PoseMathBenchmark -nullrhi [-bones=20,100,500,2000] [-iterations=2000]
+//
+// Timeline evaluation, with full precision and quantized keyframes, and export track building are reported in ns/bone
+// and poses/sec for every skeleton size. The timeline is checked against known answers first, and the commandlet
+// fails without timing anything if any check is off. The engine independent math underneath, blending, keyframe
+// search, controller math and track building, has its own tests and benchmark in PoseMathCore that build with CMake
+// and run without Unreal.
+UCLASS()
+class UPoseMathBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UPoseMathBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer);
+
+	virtual int32 Main(const FString &Params) override;
+};
@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PosePool.h"
+#include "PoseCreatorStats.h"
+
+FPosePool::FPosePool() :
+	numFramePosesUsed(0)
+{
+	freePoses.Reserve(POSE_POOL_MAX_FREE_POSES);
+	freeQuantizedPoses.Reserve(POSE_POOL_MAX_FREE_POSES);
+}
+
+FPoseBuffer FPosePool::acquire(int32 numBones)
+{
+	FPoseBuffer pose;
+
+	// Any free pose will do, setNumBones only reallocates if it's too small
+	if (freePoses.Num() > 0)
+	{
+		pose = freePoses.Pop(false);
+	}
+
+	if (pose.rotations.Max() < numBones || pose.translations.Max() < numBones)
+	{
+		INC_DWORD_STAT(STAT_PoseCreator_PosePoolAllocations);
+	}
+	pose.setNumBones(numBones);
+	return pose;
+}
+
+void FPosePool::release(FPoseBuffer &&pose)
+{
+	if (freePoses.Num() < POSE_POOL_MAX_FREE_POSES && pose.rotations.Max() > 0)
+	{
+		freePoses.Add(MoveTemp(pose));
+	}
+	pose = FPoseBuffer();
+}
+
+FQuantizedPose FPosePool::acquireQuantized(int32 numBones, const FPoseQuantizationFormat &format)
+{
+	FQuantizedPose pose;
+	if (freeQuantizedPoses.Num() > 0)
+	{
+		pose = freeQuantizedPoses.Pop(false);
+	}
+
+	// Quantizing sets the size, so only the room is made here
+	const int32 numWords = format.getNumWords(numBones);
+	if (pose.packedBones.Max() < numWords)
+	{
+		INC_DWORD_STAT(STAT_PoseCreator_PosePoolAllocations);
+		pose.packedBones.Reserve(numWords);
+	}
+	return pose;
+}
+
+void FPosePool::release(FQuantizedPose &&pose)
+{
+	if (freeQuantizedPoses.Num() < POSE_POOL_MAX_FREE_POSES && pose.packedBones.Max() > 0)
+	{
+		freeQuantizedPoses.Add(MoveTemp(pose));
+	}
+	pose = FQuantizedPose();
+}
+
+FPoseBuffer &FPosePool::getFramePose(int32 numBones)
+{
+	if (numFramePosesUsed == framePoses.Num())
+	{
+		framePoses.Add(new FPoseBuffer());
+	}
+
+	FPoseBuffer &pose = framePoses[numFramePosesUsed++];
+	if (pose.rotations.Max() < numBones || pose.translations.Max() < numBones)
+	{
+		INC_DWORD_STAT(STAT_PoseCreator_PosePoolAllocations);
+	}
+	pose.setNumBones(numBones);
+	return pose;
+}
+
+SIZE_T FPosePool::getAllocatedSize() const
+{
+	SIZE_T allocatedSize = freePoses.GetAllocatedSize() + freeQuantizedPoses.GetAllocatedSize() + framePoses.GetAllocatedSize();
+	for (const FPoseBuffer &pose : freePoses)
+	{
+		allocatedSize += pose.getAllocatedSize();
+	}
+	for (const FQuantizedPose &pose : freeQuantizedPoses)
+	{
+		allocatedSize += pose.getAllocatedSize();
+	}
+	for (int32 poseIndex = 0; poseIndex < framePoses.Num(); poseIndex++)
+	{
+		allocatedSize += sizeof(FPoseBuffer) + framePoses[poseIndex].getAllocatedSize();
+	}
+	return allocatedSize;
+}
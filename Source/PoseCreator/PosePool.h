@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+#include "PoseQuantization.h"
+
+// How many released poses the pool holds onto, anything past this goes back to the allocator
+#define POSE_POOL_MAX_FREE_POSES 64
+
+// Recycles pose buffers so posing and playback don't go to the allocator once they've warmed up. Poses that outlive
+// the frame, like keyframes, are acquired and released. Scratch poses that only live for the frame are borrowed with
+// getFramePose and all handed back at once by resetFrame. Quantized poses are recycled the same way. Game thread only.
+class FPosePool
+{
+public:
+	FPosePool();
+
+	// A pose sized for the given number of bones, reusing a released pose's memory when there is one
+	FPoseBuffer acquire(int32 numBones);
+
+	// Hand a pose's memory back to the pool
+	void release(FPoseBuffer &&pose);
+
+	// A quantized pose with room for the given number of bones in the format, reusing a released one's memory when
+	// there is one
+	FQuantizedPose acquireQuantized(int32 numBones, const FPoseQuantizationFormat &format);
+
+	void release(FQuantizedPose &&pose);
+
+	// A scratch pose sized for the given number of bones that stays valid until the next resetFrame
+	FPoseBuffer &getFramePose(int32 numBones);
+
+	// Make every scratch pose available again, call once per frame
+	void resetFrame()
+	{
+		numFramePosesUsed = 0;
+	}
+
+	SIZE_T getAllocatedSize() const;
+
+private:
+	TArray<FPoseBuffer> freePoses;
+	TArray<FQuantizedPose> freeQuantizedPoses;
+
+	// Scratch poses are allocated individually so references to them survive the array growing
+	TIndirectArray<FPoseBuffer> framePoses;
+	int32 numFramePosesUsed;
+};
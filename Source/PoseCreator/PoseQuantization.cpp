@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseQuantization.h"
+
+bool FPoseQuantizationFormat::findFormat(const FBox &offsetBounds, float maxPositionError, float maxAngleError, FPoseQuantizationFormat &outFormat)
+{
+	int32 rotationBits = QUANTIZED_POSE_MIN_BITS;
+	while (rotationBits < QUANTIZED_POSE_MAX_ROTATION_BITS && PoseQuantization::getMaxRotationError(rotationBits) > maxAngleError)
+	{
+		rotationBits++;
+	}
+
+	int32 translationBits = QUANTIZED_POSE_MIN_BITS;
+	while (translationBits < QUANTIZED_TRANSLATION_MAX_BITS && FTranslationQuantizationRange(offsetBounds, translationBits).getMaxError() > maxPositionError)
+	{
+		translationBits++;
+	}
+
+	outFormat = FPoseQuantizationFormat(FTranslationQuantizationRange(offsetBounds, translationBits), rotationBits);
+	return PoseQuantization::getMaxRotationError(rotationBits) <= maxAngleError && outFormat.offsetRange.getMaxError() <= maxPositionError;
+}
+
+void PoseQuantization::quantizePose(const FPoseBuffer &pose, const FPoseQuantizationFormat &format, FQuantizedPose &outPose)
+{
+	const int32 numBones = pose.numBones();
+	outPose.origin = numBones > 0 ? pose.translations[0] : FVector::ZeroVector;
+	outPose.numPackedBones = numBones;
+
+	// Bits are or'd in, so the words start out zeroed. Reset keeps the memory of a reused pose.
+	outPose.packedBones.Reset();
+	outPose.packedBones.AddZeroed(format.getNumWords(numBones));
+	uint32 *words = outPose.packedBones.GetData();
+
+	uint32 bitOffset = 0;
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		uint32 stored[3];
+		const int32 largestIndex = quantizeRotationComponents(pose.rotations[boneIndex], format.rotationBits, stored);
+		writeBits(words, bitOffset, largestIndex, 2);
+		bitOffset += 2;
+		for (int32 componentIndex = 0; componentIndex < 3; componentIndex++)
+		{
+			writeBits(words, bitOffset, stored[componentIndex], format.rotationBits);
+			bitOffset += format.rotationBits;
+		}
+
+		uint32 steps[3];
+		quantizeTranslationSteps(pose.translations[boneIndex] - outPose.origin, format.offsetRange, steps);
+		for (int32 axisIndex = 0; axisIndex < 3; axisIndex++)
+		{
+			writeBits(words, bitOffset, steps[axisIndex], format.offsetRange.bits);
+			bitOffset += format.offsetRange.bits;
+		}
+	}
+}
+
+void PoseQuantization::dequantizePose(const FQuantizedPose &pose, const FPoseQuantizationFormat &format, FPoseBuffer &outPose)
+{
+	const int32 numBones = pose.numBones();
+	outPose.setNumBones(numBones);
+
+	const FVector translationOrigin = pose.origin + format.offsetRange.minimum;
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		uint32 steps[3];
+		readBone(pose, format, boneIndex, outPose.rotations[boneIndex], steps);
+		outPose.translations[boneIndex] = translationOrigin + FVector(steps[0], steps[1], steps[2]) * format.offsetRange.step;
+	}
+
+	// The first bone is the origin, keep it exact rather than off by however it rounded
+	if (numBones > 0)
+	{
+		outPose.translations[0] = pose.origin;
+	}
+}
@@ -0,0 +1,314 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+
+// Bits stored for each of the three smallest quaternion components
+#define QUANTIZED_QUAT_COMPONENT_BITS 15
+#define QUANTIZED_QUAT_COMPONENT_MAX ((1 << QUANTIZED_QUAT_COMPONENT_BITS) - 1)
+
+// The three smallest components of a unit quaternion lie within +-1/sqrt(2), so they're stored over a range of sqrt(2)
+#define QUANTIZED_QUAT_RANGE 1.41421356f
+
+// Most bits a translation axis or a packed pose's rotation component can be stored in
+#define QUANTIZED_TRANSLATION_MAX_BITS 16
+#define QUANTIZED_POSE_MAX_ROTATION_BITS 16
+
+// Fewest bits a packed pose will go down to, anything coarser is no use for posing
+#define QUANTIZED_POSE_MIN_BITS 6
+
+// A rotation packed into 48 bits with the smallest three method. The largest component is dropped and rebuilt from
+// the other three, which always lie within +-1/sqrt(2), and its index takes up the remaining bits. The dropped
+// component is made positive first, q and -q being the same rotation.
+struct FQuantizedQuat
+{
+	uint16 packed[3];
+
+	friend FArchive &operator<<(FArchive &Ar, FQuantizedQuat &quat)
+	{
+		Ar << quat.packed[0] << quat.packed[1] << quat.packed[2];
+		return Ar;
+	}
+};
+
+// A translation packed into 16 bits per axis across a known range
+struct FQuantizedTranslation
+{
+	uint16 packed[3];
+
+	friend FArchive &operator<<(FArchive &Ar, FQuantizedTranslation &translation)
+	{
+		Ar << translation.packed[0] << translation.packed[1] << translation.packed[2];
+		return Ar;
+	}
+};
+
+// Range that translations are quantized across, along with the step sizes it works out to for the number of bits
+// stored per axis
+struct FTranslationQuantizationRange
+{
+	FTranslationQuantizationRange() :
+		minimum(FVector::ZeroVector),
+		step(FVector(1.0f)),
+		inverseStep(FVector(1.0f)),
+		bits(QUANTIZED_TRANSLATION_MAX_BITS),
+		maxSteps((1 << QUANTIZED_TRANSLATION_MAX_BITS) - 1)
+	{
+	}
+
+	explicit FTranslationQuantizationRange(const FBox &bounds, int32 inBits = QUANTIZED_TRANSLATION_MAX_BITS) :
+		minimum(bounds.Min),
+		bits(inBits),
+		maxSteps((1 << inBits) - 1)
+	{
+		step = bounds.GetSize().ComponentMax(FVector(KINDA_SMALL_NUMBER)) / (float)maxSteps;
+		inverseStep = FVector(1.0f) / step;
+	}
+
+	// The largest distance a quantized translation inside the range can be off by
+	float getMaxError() const
+	{
+		return step.Size() * 0.5f;
+	}
+
+	FVector minimum;
+	FVector step;
+	FVector inverseStep;
+	int32 bits;
+	int32 maxSteps;
+};
+
+// How many bits a packed pose spends on each bone, picked per timeline from how far off its keyframes may be
+struct FPoseQuantizationFormat
+{
+	FPoseQuantizationFormat() :
+		rotationBits(QUANTIZED_QUAT_COMPONENT_BITS)
+	{
+	}
+
+	FPoseQuantizationFormat(const FTranslationQuantizationRange &inOffsetRange, int32 inRotationBits) :
+		offsetRange(inOffsetRange),
+		rotationBits(inRotationBits)
+	{
+	}
+
+	// Translations are stored as offsets from the first bone across this range
+	FTranslationQuantizationRange offsetRange;
+
+	// Bits stored for each of the three smallest quaternion components
+	int32 rotationBits;
+
+	// The largest component's index, then the three smallest components, then the three translation axes
+	int32 getBitsPerBone() const
+	{
+		return 2 + 3 * rotationBits + 3 * offsetRange.bits;
+	}
+
+	int32 getNumWords(int32 numBones) const
+	{
+		return (numBones * getBitsPerBone() + 31) / 32;
+	}
+
+	// The format with the fewest bits that keeps translations within the position error and rotations within the angle
+	// error in radians. Returns false if even the most bits can't.
+	static bool findFormat(const FBox &offsetBounds, float maxPositionError, float maxAngleError, FPoseQuantizationFormat &outFormat);
+};
+
+// A whole pose bit packed at the timeline's format. Translations are stored relative to the first bone, which is kept
+// at full precision, so the range only has to cover the skeleton and not wherever it happens to stand.
+struct FQuantizedPose
+{
+	FQuantizedPose() :
+		origin(FVector::ZeroVector),
+		numPackedBones(0)
+	{
+	}
+
+	FVector origin;
+	int32 numPackedBones;
+	TArray<uint32> packedBones;
+
+	int32 numBones() const
+	{
+		return numPackedBones;
+	}
+
+	SIZE_T getAllocatedSize() const
+	{
+		return packedBones.GetAllocatedSize();
+	}
+};
+
+namespace PoseQuantization
+{
+	// Pack a whole pose, translations are measured from the first bone's across the range
+	void quantizePose(const FPoseBuffer &pose, const FPoseQuantizationFormat &format, FQuantizedPose &outPose);
+
+	void dequantizePose(const FQuantizedPose &pose, const FPoseQuantizationFormat &format, FPoseBuffer &outPose);
+
+	// Upper bound on the angle in radians a rotation can be off by after quantizing, from half a step of error on each
+	// of the three stored components and what that does to the rebuilt one
+	inline float getMaxRotationError(int32 componentBits = QUANTIZED_QUAT_COMPONENT_BITS)
+	{
+		const float componentError = 0.5f * QUANTIZED_QUAT_RANGE / ((1 << componentBits) - 1);
+		return 2.0f * FMath::Asin(FMath::Min(FMath::Sqrt(3.0f) * componentError * 2.0f, 1.0f));
+	}
+
+	// Split a rotation into the index of its largest component and the other three stored in the given number of bits
+	FORCEINLINE int32 quantizeRotationComponents(const FQuat &rotation, int32 componentBits, uint32 outStored[3])
+	{
+		const float components[4] = { rotation.X, rotation.Y, rotation.Z, rotation.W };
+		const int32 componentMax = (1 << componentBits) - 1;
+
+		int32 largestIndex = 0;
+		for (int32 componentIndex = 1; componentIndex < 4; componentIndex++)
+		{
+			if (FMath::Abs(components[componentIndex]) > FMath::Abs(components[largestIndex]))
+			{
+				largestIndex = componentIndex;
+			}
+		}
+
+		const float sign = components[largestIndex] < 0.0f ? -1.0f : 1.0f;
+		const float inverseLength = 1.0f / FMath::Sqrt(rotation.SizeSquared());
+
+		int32 storedIndex = 0;
+		for (int32 componentIndex = 0; componentIndex < 4; componentIndex++)
+		{
+			if (componentIndex == largestIndex)
+			{
+				continue;
+			}
+
+			// Map +-1/sqrt(2) onto the full range of the stored bits
+			float normalized = (components[componentIndex] * sign * inverseLength * QUANTIZED_QUAT_RANGE + 1.0f) * 0.5f;
+			outStored[storedIndex++] = (uint32)FMath::Clamp(FMath::RoundToInt(normalized * componentMax), 0, componentMax);
+		}
+		return largestIndex;
+	}
+
+	// Rebuild a rotation from quantizeRotationComponents
+	FORCEINLINE FQuat dequantizeRotationComponents(int32 largestIndex, const uint32 stored[3], int32 componentBits)
+	{
+		const float scale = QUANTIZED_QUAT_RANGE / ((1 << componentBits) - 1);
+		const float offset = QUANTIZED_QUAT_RANGE * 0.5f;
+
+		const float first = stored[0] * scale - offset;
+		const float second = stored[1] * scale - offset;
+		const float third = stored[2] * scale - offset;
+		const float largest = FMath::Sqrt(FMath::Max(1.0f - first * first - second * second - third * third, 0.0f));
+
+		FQuat rotation;
+		switch (largestIndex)
+		{
+		case 0: rotation = FQuat(largest, first, second, third); break;
+		case 1: rotation = FQuat(first, largest, second, third); break;
+		case 2: rotation = FQuat(first, second, largest, third); break;
+		default: rotation = FQuat(first, second, third, largest); break;
+		}
+		rotation.Normalize();
+		return rotation;
+	}
+
+	FORCEINLINE FQuantizedQuat quantizeRotation(const FQuat &rotation)
+	{
+		uint32 stored[3];
+		const int32 largestIndex = quantizeRotationComponents(rotation, QUANTIZED_QUAT_COMPONENT_BITS, stored);
+
+		FQuantizedQuat quantized;
+		quantized.packed[0] = (uint16)(((largestIndex & 1) << QUANTIZED_QUAT_COMPONENT_BITS) | stored[0]);
+		quantized.packed[1] = (uint16)(((largestIndex >> 1) << QUANTIZED_QUAT_COMPONENT_BITS) | stored[1]);
+		quantized.packed[2] = (uint16)stored[2];
+		return quantized;
+	}
+
+	FORCEINLINE FQuat dequantizeRotation(const FQuantizedQuat &quantized)
+	{
+		const int32 largestIndex = (quantized.packed[0] >> QUANTIZED_QUAT_COMPONENT_BITS) | ((quantized.packed[1] >> QUANTIZED_QUAT_COMPONENT_BITS) << 1);
+		const uint32 stored[3] =
+		{
+			(uint32)(quantized.packed[0] & QUANTIZED_QUAT_COMPONENT_MAX),
+			(uint32)(quantized.packed[1] & QUANTIZED_QUAT_COMPONENT_MAX),
+			(uint32)(quantized.packed[2] & QUANTIZED_QUAT_COMPONENT_MAX)
+		};
+		return dequantizeRotationComponents(largestIndex, stored, QUANTIZED_QUAT_COMPONENT_BITS);
+	}
+
+	// The number of steps across the range on each axis
+	FORCEINLINE void quantizeTranslationSteps(const FVector &translation, const FTranslationQuantizationRange &range, uint32 outSteps[3])
+	{
+		const FVector steps = (translation - range.minimum) * range.inverseStep;
+		outSteps[0] = (uint32)FMath::Clamp(FMath::RoundToInt(steps.X), 0, range.maxSteps);
+		outSteps[1] = (uint32)FMath::Clamp(FMath::RoundToInt(steps.Y), 0, range.maxSteps);
+		outSteps[2] = (uint32)FMath::Clamp(FMath::RoundToInt(steps.Z), 0, range.maxSteps);
+	}
+
+	FORCEINLINE FQuantizedTranslation quantizeTranslation(const FVector &translation, const FTranslationQuantizationRange &range)
+	{
+		check(range.bits <= 16);
+
+		uint32 steps[3];
+		quantizeTranslationSteps(translation, range, steps);
+
+		FQuantizedTranslation quantized;
+		quantized.packed[0] = (uint16)steps[0];
+		quantized.packed[1] = (uint16)steps[1];
+		quantized.packed[2] = (uint16)steps[2];
+		return quantized;
+	}
+
+	FORCEINLINE FVector dequantizeTranslation(const FQuantizedTranslation &quantized, const FTranslationQuantizationRange &range)
+	{
+		return range.minimum + FVector(quantized.packed[0], quantized.packed[1], quantized.packed[2]) * range.step;
+	}
+
+	// Or a value into a zeroed bit stream, values never span more than two words
+	FORCEINLINE void writeBits(uint32 *words, uint32 bitOffset, uint32 value, int32 numBits)
+	{
+		const uint32 wordIndex = bitOffset >> 5;
+		const uint32 shift = bitOffset & 31;
+		const uint64 shifted = (uint64)value << shift;
+		words[wordIndex] |= (uint32)shifted;
+		if (shift + numBits > 32)
+		{
+			words[wordIndex + 1] |= (uint32)(shifted >> 32);
+		}
+	}
+
+	FORCEINLINE uint32 readBits(const uint32 *words, uint32 bitOffset, int32 numBits)
+	{
+		const uint32 wordIndex = bitOffset >> 5;
+		const uint32 shift = bitOffset & 31;
+		uint64 bits = words[wordIndex];
+		if (shift + numBits > 32)
+		{
+			bits |= (uint64)words[wordIndex + 1] << 32;
+		}
+		return (uint32)(bits >> shift) & ((1u << numBits) - 1);
+	}
+
+	// Read one bone of a packed pose, the translation comes back as steps across the format's range
+	FORCEINLINE void readBone(const FQuantizedPose &pose, const FPoseQuantizationFormat &format, int32 boneIndex, FQuat &outRotation, uint32 outSteps[3])
+	{
+		const uint32 *words = pose.packedBones.GetData();
+		uint32 bitOffset = boneIndex * format.getBitsPerBone();
+
+		const int32 largestIndex = (int32)readBits(words, bitOffset, 2);
+		bitOffset += 2;
+
+		uint32 stored[3];
+		for (int32 componentIndex = 0; componentIndex < 3; componentIndex++)
+		{
+			stored[componentIndex] = readBits(words, bitOffset, format.rotationBits);
+			bitOffset += format.rotationBits;
+		}
+		outRotation = dequantizeRotationComponents(largestIndex, stored, format.rotationBits);
+
+		for (int32 axisIndex = 0; axisIndex < 3; axisIndex++)
+		{
+			outSteps[axisIndex] = readBits(words, bitOffset, format.offsetRange.bits);
+			bitOffset += format.offsetRange.bits;
+		}
+	}
+}
@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseReplication.h"
+
+bool FPoseDeltaPacket::NetSerialize(FArchive &Ar, class UPackageMap *Map, bool &bOutSuccess)
+{
+	Ar << senderId;
+
+	uint32 numBones = boneIndices.Num();
+	Ar.SerializeIntPacked(numBones);
+	if (Ar.IsLoading())
+	{
+		if (numBones > POSE_REPLICATION_MAX_BONES)
+		{
+			Ar.SetError();
+			bOutSuccess = false;
+			return true;
+		}
+		boneIndices.SetNumUninitialized(numBones);
+		rotations.SetNumUninitialized(numBones);
+	}
+
+	uint32 previousBoneIndex = 0;
+	for (uint32 packetIndex = 0; packetIndex < numBones; packetIndex++)
+	{
+		uint32 gap = Ar.IsLoading() ? 0 : boneIndices[packetIndex] - previousBoneIndex;
+		Ar.SerializeIntPacked(gap);
+		if (Ar.IsLoading())
+		{
+			boneIndices[packetIndex] = (uint16)(previousBoneIndex + gap);
+		}
+		previousBoneIndex = boneIndices[packetIndex];
+
+		Ar << rotations[packetIndex];
+	}
+
+	Ar.SerializeBits(&hasActorLocation, 1);
+	if (hasActorLocation)
+	{
+		Ar << actorLocation;
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+bool FPoseKeyFramePacket::NetSerialize(FArchive &Ar, class UPackageMap *Map, bool &bOutSuccess)
+{
+	Ar << senderId;
+	Ar << keyFrameTime;
+	Ar.SerializeBits(&removed, 1);
+	Ar.SerializeBits(&replacesTimeline, 1);
+
+	uint32 numBones = rotations.Num();
+	Ar.SerializeIntPacked(numBones);
+	if (Ar.IsLoading())
+	{
+		if (numBones > POSE_REPLICATION_MAX_BONES)
+		{
+			Ar.SetError();
+			bOutSuccess = false;
+			return true;
+		}
+		rotations.SetNumUninitialized(numBones);
+		translations.SetNumUninitialized(numBones);
+	}
+
+	for (uint32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		Ar << rotations[boneIndex];
+		Ar << translations[boneIndex];
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+FPoseReplicator::FPoseReplicator() :
+	sentActorLocation(FVector::ZeroVector),
+	settledActorLocation(FVector::ZeroVector),
+	budgetBytes(0.0f),
+	timelineReplaced(false)
+{
+}
+
+void FPoseReplicator::reset(const FPoseBuffer &localPose, const FVector &actorLocation)
+{
+	// Kept as they'd come out of quantizing, the same as everything sent later, so unchanged bones compare equal
+	sentRotations.SetNumUninitialized(localPose.numBones(), false);
+	for (int32 boneIndex = 0; boneIndex < localPose.numBones(); boneIndex++)
+	{
+		sentRotations[boneIndex] = PoseQuantization::dequantizeRotation(PoseQuantization::quantizeRotation(localPose.rotations[boneIndex]));
+	}
+	settledRotations = sentRotations;
+	sentActorLocation = actorLocation;
+	settledActorLocation = actorLocation;
+	queuedKeyFrameTimes.Reset();
+	timelineReplaced = false;
+}
+
+void FPoseReplicator::refillBudget(float deltaSeconds, int32 bytesPerSecond)
+{
+	// Going over the budget borrows from the next frames, so a big keyframe can still get out on a small budget
+	budgetBytes = FMath::Min(budgetBytes + deltaSeconds * bytesPerSecond, bytesPerSecond * 0.25f);
+}
+
+void FPoseReplicator::fillPacket(const FPoseBuffer &localPose, TArray<int32> &boneIndices, FPoseDeltaPacket &outPacket)
+{
+	boneIndices.Sort();
+
+	outPacket.boneIndices.SetNumUninitialized(boneIndices.Num(), false);
+	outPacket.rotations.SetNumUninitialized(boneIndices.Num(), false);
+	for (int32 packetIndex = 0; packetIndex < boneIndices.Num(); packetIndex++)
+	{
+		int32 boneIndex = boneIndices[packetIndex];
+		outPacket.boneIndices[packetIndex] = (uint16)boneIndex;
+		outPacket.rotations[packetIndex] = PoseQuantization::quantizeRotation(localPose.rotations[boneIndex]);
+
+		// Everyone ends up with the quantized rotation, so that's what later changes are measured against
+		sentRotations[boneIndex] = PoseQuantization::dequantizeRotation(outPacket.rotations[packetIndex]);
+	}
+}
+
+bool FPoseReplicator::buildDelta(const FPoseBuffer &localPose, const FVector &actorLocation, float angleThresholdRadians, FPoseDeltaPacket &outPacket)
+{
+	check(localPose.numBones() == sentRotations.Num());
+
+	outPacket.hasActorLocation = !actorLocation.Equals(sentActorLocation, KINDA_SMALL_NUMBER);
+	outPacket.actorLocation = actorLocation;
+
+	candidateBones.Reset();
+	boneAngles.SetNumUninitialized(localPose.numBones(), false);
+	for (int32 boneIndex = 0; boneIndex < localPose.numBones(); boneIndex++)
+	{
+		boneAngles[boneIndex] = localPose.rotations[boneIndex].AngularDistance(sentRotations[boneIndex]);
+		if (boneAngles[boneIndex] > angleThresholdRadians)
+		{
+			candidateBones.Add(boneIndex);
+		}
+	}
+
+	// Biggest changes first when they don't all fit, the rest go out in a later frame
+	int32 numToSend = FMath::Clamp((int32)((budgetBytes - (outPacket.hasActorLocation ? 20 : 8)) / 7), 0, candidateBones.Num());
+	if (numToSend < candidateBones.Num())
+	{
+		const TArray<float> &angles = boneAngles;
+		candidateBones.Sort([&angles](int32 first, int32 second) { return angles[first] > angles[second]; });
+		candidateBones.SetNum(numToSend, false);
+	}
+
+	if (candidateBones.Num() == 0 && !outPacket.hasActorLocation)
+	{
+		return false;
+	}
+
+	fillPacket(localPose, candidateBones, outPacket);
+	sentActorLocation = actorLocation;
+	budgetBytes -= outPacket.getEstimatedSize();
+	return true;
+}
+
+bool FPoseReplicator::buildSettle(const FPoseBuffer &localPose, const FVector &actorLocation, FPoseDeltaPacket &outPacket)
+{
+	check(localPose.numBones() == settledRotations.Num());
+
+	outPacket.hasActorLocation = !actorLocation.Equals(settledActorLocation, 0.0f);
+	outPacket.actorLocation = actorLocation;
+
+	candidateBones.Reset();
+	for (int32 boneIndex = 0; boneIndex < localPose.numBones(); boneIndex++)
+	{
+		// Compared against what the bone would be once it's been through quantizing, so an unchanged bone isn't resent
+		if (!PoseQuantization::dequantizeRotation(PoseQuantization::quantizeRotation(localPose.rotations[boneIndex])).Equals(settledRotations[boneIndex], 0.0f))
+		{
+			candidateBones.Add(boneIndex);
+		}
+	}
+
+	if (candidateBones.Num() == 0 && !outPacket.hasActorLocation)
+	{
+		return false;
+	}
+
+	fillPacket(localPose, candidateBones, outPacket);
+	for (int32 boneIndex : candidateBones)
+	{
+		settledRotations[boneIndex] = sentRotations[boneIndex];
+	}
+	sentActorLocation = actorLocation;
+	settledActorLocation = actorLocation;
+	budgetBytes -= outPacket.getEstimatedSize();
+	return true;
+}
+
+void FPoseReplicator::noteReceived(int32 boneIndex, const FQuat &rotation)
+{
+	if (sentRotations.IsValidIndex(boneIndex))
+	{
+		sentRotations[boneIndex] = rotation;
+		settledRotations[boneIndex] = rotation;
+	}
+}
+
+void FPoseReplicator::noteReceivedActorLocation(const FVector &actorLocation)
+{
+	sentActorLocation = actorLocation;
+	settledActorLocation = actorLocation;
+}
+
+void FPoseReplicator::queueKeyFrame(float keyFrameTime)
+{
+	queuedKeyFrameTimes.AddUnique(keyFrameTime);
+}
+
+void FPoseReplicator::queueTimelineReplaced()
+{
+	queuedKeyFrameTimes.Reset();
+	timelineReplaced = true;
+}
+
+bool FPoseReplicator::popQueuedKeyFrame(int32 packetSize, float &outKeyFrameTime, bool &outReplacesTimeline)
+{
+	// Anything left in the budget is enough, a packet bigger than what's left borrows from the next frames
+	if (queuedKeyFrameTimes.Num() == 0 || budgetBytes <= 0.0f)
+	{
+		return false;
+	}
+
+	outKeyFrameTime = queuedKeyFrameTimes[0];
+	outReplacesTimeline = timelineReplaced;
+	queuedKeyFrameTimes.RemoveAt(0, 1, false);
+	timelineReplaced = false;
+	budgetBytes -= packetSize;
+	return true;
+}
@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseQuantization.h"
+#include "PoseBuffer.h"
+#include "PoseReplication.generated.h"
+
+// Packets bigger than this are refused when they're read, nothing legitimate comes close
+#define POSE_REPLICATION_MAX_BONES 2048
+
+// Changed local bone rotations, and the actor's location if it moved, quantized. Bone indices are sent sorted as the
+// gap from the previous one, which packs into a byte for nearly every bone.
+USTRUCT()
+struct FPoseDeltaPacket
+{
+	GENERATED_USTRUCT_BODY()
+
+	FPoseDeltaPacket() :
+		senderId(INDEX_NONE),
+		hasActorLocation(false),
+		actorLocation(FVector::ZeroVector)
+	{
+	}
+
+	// The player the change came from, filled in by the server so nobody applies their own changes twice
+	int32 senderId;
+
+	TArray<uint16> boneIndices;
+	TArray<FQuantizedQuat> rotations;
+
+	bool hasActorLocation;
+	FVector actorLocation;
+
+	// Roughly how many bytes the packet takes up on the wire
+	int32 getEstimatedSize() const
+	{
+		return 8 + boneIndices.Num() * 7 + (hasActorLocation ? 12 : 0);
+	}
+
+	bool NetSerialize(FArchive &Ar, class UPackageMap *Map, bool &bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FPoseDeltaPacket> : public TStructOpsTypeTraitsBase2<FPoseDeltaPacket>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+// A whole keyframe quantized, or the removal of one. Translations are quantized in the actor's component space
+// across a range both ends work out from the skeletal mesh's bounds.
+USTRUCT()
+struct FPoseKeyFramePacket
+{
+	GENERATED_USTRUCT_BODY()
+
+	FPoseKeyFramePacket() :
+		senderId(INDEX_NONE),
+		keyFrameTime(0.0f),
+		removed(false),
+		replacesTimeline(false)
+	{
+	}
+
+	int32 senderId;
+	float keyFrameTime;
+
+	// Set when the keyframe at the time no longer exists
+	bool removed;
+
+	// Set on the first keyframe of a whole new timeline, the receiver throws its old keyframes away first
+	bool replacesTimeline;
+
+	TArray<FQuantizedQuat> rotations;
+	TArray<FQuantizedTranslation> translations;
+
+	int32 getEstimatedSize() const
+	{
+		return 12 + rotations.Num() * 12;
+	}
+
+	bool NetSerialize(FArchive &Ar, class UPackageMap *Map, bool &bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FPoseKeyFramePacket> : public TStructOpsTypeTraitsBase2<FPoseKeyFramePacket>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+// Tracks what one poseable actor has sent so each frame only sends what changed since, within a byte budget that
+// refills at a steady rate. Keyframes waiting to go out are queued by time and sent once there's budget for them.
+class FPoseReplicator
+{
+public:
+	FPoseReplicator();
+
+	// Start tracking from the skeleton's current local pose and location, which everyone is assumed to already have
+	void reset(const FPoseBuffer &localPose, const FVector &actorLocation);
+
+	// Top up the byte budget for the time since the last frame, holding at most a quarter second of it
+	void refillBudget(float deltaSeconds, int32 bytesPerSecond);
+
+	// Build a packet of the bones that turned more than the threshold since they were last sent, biggest changes
+	// first, for as long as the budget lasts. Returns false if there's nothing to send.
+	bool buildDelta(const FPoseBuffer &localPose, const FVector &actorLocation, float angleThresholdRadians, FPoseDeltaPacket &outPacket);
+
+	// Build a packet of everything that differs at all from what was last sent reliably, ignoring the budget.
+	// Sent once an edit is over so everyone ends up with the same pose no matter what got lost along the way.
+	bool buildSettle(const FPoseBuffer &localPose, const FVector &actorLocation, FPoseDeltaPacket &outPacket);
+
+	// Remember bones set from a received packet as already sent, so they aren't sent back out
+	void noteReceived(int32 boneIndex, const FQuat &rotation);
+	void noteReceivedActorLocation(const FVector &actorLocation);
+
+	void queueKeyFrame(float keyFrameTime);
+
+	// Drop the queued keyframes because the whole timeline was replaced, the next keyframe queued replaces it for
+	// everyone else too
+	void queueTimelineReplaced();
+
+	// Take the next queued keyframe if the budget has room for a packet of the given size
+	bool popQueuedKeyFrame(int32 packetSize, float &outKeyFrameTime, bool &outReplacesTimeline);
+
+	bool hasQueuedKeyFrames() const
+	{
+		return queuedKeyFrameTimes.Num() > 0;
+	}
+
+	// Take bytes out of the budget for something sent outside of the calls above
+	void spendBudget(int32 numBytes)
+	{
+		budgetBytes -= numBytes;
+	}
+
+private:
+	// Pack the bones in the list into a packet and mark them sent, the list gets sorted
+	void fillPacket(const FPoseBuffer &localPose, TArray<int32> &boneIndices, FPoseDeltaPacket &outPacket);
+
+	// The rotations everyone else was last sent, and last sent reliably
+	FPoseRotationArray sentRotations;
+	FPoseRotationArray settledRotations;
+
+	FVector sentActorLocation;
+	FVector settledActorLocation;
+
+	float budgetBytes;
+
+	TArray<float> queuedKeyFrameTimes;
+	bool timelineReplaced;
+
+	// Scratch lists reused from frame to frame
+	TArray<int32> candidateBones;
+	TArray<float> boneAngles;
+};
@@ -0,0 +1,188 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseReplicationComponent.h"
+#include "PoseableActor.h"
+#include "PoseCreatorStats.h"
+#include "EngineUtils.h"
+
+UPoseReplicationComponent::UPoseReplicationComponent(const FObjectInitializer& ObjectInitializer) :
+	Super(ObjectInitializer)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+
+	fullStateBytesPerSecond = 64000;
+	fullStateQueueStart = 0;
+	fullStateBudgetBytes = 0.0f;
+}
+
+void UPoseReplicationComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Only the copy on the owning client asks, the server's copy is the one that answers
+	if (GetOwnerRole() != ROLE_Authority)
+	{
+		serverRequestFullState();
+	}
+}
+
+UPoseReplicationComponent *UPoseReplicationComponent::getLocal(UWorld *world)
+{
+	APlayerController *localController = GEngine->GetFirstLocalPlayerController(world);
+	return localController != nullptr ? localController->FindComponentByClass<UPoseReplicationComponent>() : nullptr;
+}
+
+int32 UPoseReplicationComponent::getSenderId() const
+{
+	APlayerController *owningController = Cast<APlayerController>(GetOwner());
+	return owningController != nullptr && owningController->PlayerState != nullptr ? owningController->PlayerState->PlayerId : INDEX_NONE;
+}
+
+void UPoseReplicationComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (fullStateQueueStart >= fullStateQueue.Num())
+	{
+		return;
+	}
+
+	// Keyframes go out one at a time for as long as the budget lasts, the rest wait for the next frames
+	fullStateBudgetBytes = FMath::Min(fullStateBudgetBytes + DeltaTime * fullStateBytesPerSecond, fullStateBytesPerSecond * 0.25f);
+	FPoseKeyFramePacket packet;
+	while (fullStateBudgetBytes > 0.0f && fullStateQueueStart < fullStateQueue.Num())
+	{
+		const FQueuedKeyFrame &queuedKeyFrame = fullStateQueue[fullStateQueueStart++];
+		APoseableActor *poseableActor = queuedKeyFrame.poseableActor.Get();
+		if (poseableActor == nullptr)
+		{
+			continue;
+		}
+
+		if (!poseableActor->buildKeyFramePacket(poseableActor->findKeyFrame(queuedKeyFrame.keyFrameTime), packet))
+		{
+			// The keyframe was removed since it was queued, the actor's next one has to clear the timeline instead
+			if (queuedKeyFrame.replacesTimeline && fullStateQueueStart < fullStateQueue.Num() &&
+				fullStateQueue[fullStateQueueStart].poseableActor == queuedKeyFrame.poseableActor)
+			{
+				fullStateQueue[fullStateQueueStart].replacesTimeline = true;
+			}
+			continue;
+		}
+
+		packet.replacesTimeline = queuedKeyFrame.replacesTimeline;
+		clientReceiveKeyFrame(poseableActor, packet);
+
+		fullStateBudgetBytes -= packet.getEstimatedSize();
+		INC_DWORD_STAT_BY(STAT_PoseCreator_ReplicatedBytes, packet.getEstimatedSize());
+	}
+
+	if (fullStateQueueStart >= fullStateQueue.Num())
+	{
+		fullStateQueue.Empty();
+		fullStateQueueStart = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////
+//////////////////   CLIENT TO SERVER  ////////////////////
+///////////////////////////////////////////////////////////
+
+bool UPoseReplicationComponent::serverSendBoneDelta_Validate(APoseableActor *poseableActor, const FPoseDeltaPacket &packet)
+{
+	return packet.boneIndices.Num() == packet.rotations.Num();
+}
+
+void UPoseReplicationComponent::serverSendBoneDelta_Implementation(APoseableActor *poseableActor, const FPoseDeltaPacket &packet)
+{
+	if (poseableActor != nullptr)
+	{
+		FPoseDeltaPacket stampedPacket = packet;
+		stampedPacket.senderId = getSenderId();
+		poseableActor->multicastBoneDelta(stampedPacket);
+	}
+}
+
+bool UPoseReplicationComponent::serverSendBoneSettle_Validate(APoseableActor *poseableActor, const FPoseDeltaPacket &packet)
+{
+	return packet.boneIndices.Num() == packet.rotations.Num();
+}
+
+void UPoseReplicationComponent::serverSendBoneSettle_Implementation(APoseableActor *poseableActor, const FPoseDeltaPacket &packet)
+{
+	if (poseableActor != nullptr)
+	{
+		FPoseDeltaPacket stampedPacket = packet;
+		stampedPacket.senderId = getSenderId();
+		poseableActor->multicastBoneSettle(stampedPacket);
+	}
+}
+
+bool UPoseReplicationComponent::serverSendKeyFrame_Validate(APoseableActor *poseableActor, const FPoseKeyFramePacket &packet)
+{
+	return packet.rotations.Num() == packet.translations.Num();
+}
+
+void UPoseReplicationComponent::serverSendKeyFrame_Implementation(APoseableActor *poseableActor, const FPoseKeyFramePacket &packet)
+{
+	if (poseableActor != nullptr)
+	{
+		FPoseKeyFramePacket stampedPacket = packet;
+		stampedPacket.senderId = getSenderId();
+		poseableActor->multicastKeyFrame(stampedPacket);
+	}
+}
+
+bool UPoseReplicationComponent::serverRequestFullState_Validate()
+{
+	return true;
+}
+
+void UPoseReplicationComponent::serverRequestFullState_Implementation()
+{
+	// The poses are small enough to go straight away, the keyframes are queued up and streamed within the budget
+	fullStateQueue.Reset();
+	fullStateQueueStart = 0;
+	FPoseDeltaPacket posePacket;
+	for (TActorIterator<APoseableActor> actorIterator(GetWorld()); actorIterator; ++actorIterator)
+	{
+		APoseableActor *poseableActor = *actorIterator;
+		if (!poseableActor->buildPosePacket(posePacket))
+		{
+			continue;
+		}
+
+		clientReceivePose(poseableActor, posePacket);
+		INC_DWORD_STAT_BY(STAT_PoseCreator_ReplicatedBytes, posePacket.getEstimatedSize());
+
+		for (int32 keyFrameIndex = 0; keyFrameIndex < poseableActor->numKeyFrames(); keyFrameIndex++)
+		{
+			FQueuedKeyFrame queuedKeyFrame;
+			queuedKeyFrame.poseableActor = poseableActor;
+			queuedKeyFrame.keyFrameTime = poseableActor->getKeyFrameTime(keyFrameIndex);
+			queuedKeyFrame.replacesTimeline = keyFrameIndex == 0;
+			fullStateQueue.Add(queuedKeyFrame);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////
+//////////////////   SERVER TO CLIENT  ////////////////////
+///////////////////////////////////////////////////////////
+
+void UPoseReplicationComponent::clientReceivePose_Implementation(APoseableActor *poseableActor, const FPoseDeltaPacket &packet)
+{
+	if (poseableActor != nullptr)
+	{
+		poseableActor->receiveBoneDelta(packet);
+	}
+}
+
+void UPoseReplicationComponent::clientReceiveKeyFrame_Implementation(APoseableActor *poseableActor, const FPoseKeyFramePacket &packet)
+{
+	if (poseableActor != nullptr)
+	{
+		poseableActor->receiveKeyFrame(packet);
+	}
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Components/ActorComponent.h"
+#include "PoseReplication.h"
+#include "PoseReplicationComponent.generated.h"
+
+class APoseableActor;
+
+// Carries a player's pose edits up to the server. Clients can only call server functions on actors they own, so the
+// edits to the shared poseable actors go through this component on the player's controller, which the game mode adds
+// when the player logs in. It also streams every poseable actor's pose and keyframes down to a player that joins late.
+//
+// The packets and the delta and settle logic are checked by the automation test in PoseReplicationTest.cpp, run it
+// with "Automation RunTests PoseCreator.Replication". To try the whole thing by hand on one machine, start a listen
+// server with "PoseCreator <map>?listen -game" and connect a second instance to it with "PoseCreator 127.0.0.1 -game".
+// The "stat PoseCreator" counters show the bytes sent.
+UCLASS()
+class POSECREATOR_API UPoseReplicationComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UPoseReplicationComponent(const FObjectInitializer& ObjectInitializer);
+
+	virtual void BeginPlay() override;
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction) override;
+
+	// The local player's component, null if there's no local player or it hasn't been replicated yet
+	static UPoseReplicationComponent *getLocal(UWorld *world);
+
+	// How many bytes a second the state of the poseable actors streams down to a late joiner at
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Replication", meta = (ClampMin = "1000"))
+	int32 fullStateBytesPerSecond;
+
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void serverSendBoneDelta(APoseableActor *poseableActor, const FPoseDeltaPacket &packet);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void serverSendBoneSettle(APoseableActor *poseableActor, const FPoseDeltaPacket &packet);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void serverSendKeyFrame(APoseableActor *poseableActor, const FPoseKeyFramePacket &packet);
+
+	// Sent by a client once it's joined, the server answers with the state of every poseable actor
+	UFUNCTION(Server, Reliable, WithValidation)
+	void serverRequestFullState();
+
+	UFUNCTION(Client, Reliable)
+	void clientReceivePose(APoseableActor *poseableActor, const FPoseDeltaPacket &packet);
+
+	UFUNCTION(Client, Reliable)
+	void clientReceiveKeyFrame(APoseableActor *poseableActor, const FPoseKeyFramePacket &packet);
+
+private:
+	// The id the server stamps on this player's packets
+	int32 getSenderId() const;
+
+	// Keyframes still to be streamed to the owning client, by actor and keyframe time. Keyframes can be added or
+	// removed while the queue streams out, so the time is looked up again when it's sent and skipped if it's gone.
+	struct FQueuedKeyFrame
+	{
+		TWeakObjectPtr<APoseableActor> poseableActor;
+		float keyFrameTime;
+		// The first keyframe sent for an actor clears whatever timeline the client had
+		bool replacesTimeline;
+	};
+	TArray<FQueuedKeyFrame> fullStateQueue;
+	int32 fullStateQueueStart;
+
+	float fullStateBudgetBytes;
+};
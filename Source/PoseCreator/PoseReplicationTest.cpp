@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseReplication.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Sends packets through NetSerialize and between two replicators the way a sender and a receiver would see them,
+// without needing a second process. Run it with "Automation RunTests PoseCreator.Replication" from the console or
+// the session frontend.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPoseReplicationTest, "PoseCreator.Replication",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+namespace
+{
+	// Write a packet out and read it back into another one, false if reading it failed
+	template<typename PacketType>
+	bool roundTripPacket(PacketType &packet, PacketType &outPacket)
+	{
+		FBitWriter writer(0, true);
+		bool writeSucceeded = false;
+		packet.NetSerialize(writer, nullptr, writeSucceeded);
+
+		FBitReader reader(writer.GetData(), writer.GetNumBits());
+		bool readSucceeded = false;
+		outPacket.NetSerialize(reader, nullptr, readSucceeded);
+		return writeSucceeded && readSucceeded && reader.AtEnd();
+	}
+
+	bool quantizedRotationsMatch(const FQuantizedQuat &first, const FQuantizedQuat &second)
+	{
+		return FMemory::Memcmp(first.packed, second.packed, sizeof(first.packed)) == 0;
+	}
+
+	// A few bones turned a little apart from each other around up
+	void makeTestPose(int32 numBones, FPoseBuffer &outPose)
+	{
+		outPose.setNumBones(numBones);
+		for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			outPose.rotations[boneIndex] = FQuat(FVector::UpVector, FMath::DegreesToRadians(5.0f * boneIndex));
+			outPose.translations[boneIndex] = FVector(0.0f, 0.0f, 10.0f * boneIndex);
+		}
+	}
+
+	void turnBone(FPoseBuffer &pose, int32 boneIndex, float angleDegrees)
+	{
+		pose.rotations[boneIndex] = FQuat(FVector::ForwardVector, FMath::DegreesToRadians(angleDegrees)) * pose.rotations[boneIndex];
+	}
+
+	// What the receiving end does with a delta packet
+	void applyDelta(const FPoseDeltaPacket &packet, FPoseBuffer &pose, FPoseReplicator &replicator)
+	{
+		for (int32 packetIndex = 0; packetIndex < packet.boneIndices.Num(); packetIndex++)
+		{
+			const int32 boneIndex = packet.boneIndices[packetIndex];
+			pose.rotations[boneIndex] = PoseQuantization::dequantizeRotation(packet.rotations[packetIndex]);
+			replicator.noteReceived(boneIndex, pose.rotations[boneIndex]);
+		}
+		if (packet.hasActorLocation)
+		{
+			replicator.noteReceivedActorLocation(packet.actorLocation);
+		}
+	}
+
+	bool rotationsMatch(const FPoseBuffer &first, const FPoseBuffer &second, float toleranceDegrees)
+	{
+		for (int32 boneIndex = 0; boneIndex < first.numBones(); boneIndex++)
+		{
+			if (FMath::RadiansToDegrees(first.rotations[boneIndex].AngularDistance(second.rotations[boneIndex])) > toleranceDegrees)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool FPoseReplicationTest::RunTest(const FString &Parameters)
+{
+	// Bone indices go out as gaps, including ones too big for a byte, and come back as they were
+	{
+		FPoseDeltaPacket packet;
+		packet.senderId = 3;
+		const uint16 boneIndices[] = { 0, 1, 7, 300, POSE_REPLICATION_MAX_BONES - 1 };
+		for (uint16 boneIndex : boneIndices)
+		{
+			packet.boneIndices.Add(boneIndex);
+			packet.rotations.Add(PoseQuantization::quantizeRotation(FQuat(FVector::UpVector, boneIndex * 0.001f)));
+		}
+		packet.hasActorLocation = true;
+		packet.actorLocation = FVector(1.0f, -2.0f, 300.5f);
+
+		FPoseDeltaPacket receivedPacket;
+		bool packetsMatch = roundTripPacket(packet, receivedPacket) && receivedPacket.senderId == packet.senderId &&
+			receivedPacket.boneIndices == packet.boneIndices && receivedPacket.rotations.Num() == packet.rotations.Num() &&
+			receivedPacket.hasActorLocation && receivedPacket.actorLocation == packet.actorLocation;
+		for (int32 packetIndex = 0; packetsMatch && packetIndex < packet.rotations.Num(); packetIndex++)
+		{
+			packetsMatch = quantizedRotationsMatch(receivedPacket.rotations[packetIndex], packet.rotations[packetIndex]);
+		}
+		TestTrue(TEXT("Delta packet round trip"), packetsMatch);
+
+		packet.hasActorLocation = false;
+		TestTrue(TEXT("Delta packet without a location round trip"), roundTripPacket(packet, receivedPacket) && !receivedPacket.hasActorLocation);
+	}
+
+	// A keyframe, then the removal of one that also replaces the timeline
+	{
+		FPoseKeyFramePacket packet;
+		packet.senderId = 1;
+		packet.keyFrameTime = 2.5f;
+		const FTranslationQuantizationRange range(FBox(FVector(-100.0f), FVector(100.0f)));
+		for (int32 boneIndex = 0; boneIndex < 20; boneIndex++)
+		{
+			packet.rotations.Add(PoseQuantization::quantizeRotation(FQuat(FVector::RightVector, boneIndex * 0.1f)));
+			packet.translations.Add(PoseQuantization::quantizeTranslation(FVector(boneIndex, -boneIndex, 2.0f * boneIndex), range));
+		}
+
+		FPoseKeyFramePacket receivedPacket;
+		bool packetsMatch = roundTripPacket(packet, receivedPacket) && receivedPacket.keyFrameTime == packet.keyFrameTime &&
+			!receivedPacket.removed && !receivedPacket.replacesTimeline && receivedPacket.rotations.Num() == packet.rotations.Num() &&
+			receivedPacket.translations.Num() == packet.translations.Num();
+		for (int32 boneIndex = 0; packetsMatch && boneIndex < packet.rotations.Num(); boneIndex++)
+		{
+			packetsMatch = quantizedRotationsMatch(receivedPacket.rotations[boneIndex], packet.rotations[boneIndex]) &&
+				FMemory::Memcmp(receivedPacket.translations[boneIndex].packed, packet.translations[boneIndex].packed, sizeof(FQuantizedTranslation)) == 0;
+		}
+		TestTrue(TEXT("Keyframe packet round trip"), packetsMatch);
+
+		packet.removed = true;
+		packet.replacesTimeline = true;
+		packet.rotations.Empty();
+		packet.translations.Empty();
+		TestTrue(TEXT("Keyframe removal round trip"), roundTripPacket(packet, receivedPacket) && receivedPacket.removed &&
+			receivedPacket.replacesTimeline && receivedPacket.rotations.Num() == 0);
+	}
+
+	// Packets claiming more bones than any skeleton has are refused rather than allocated
+	{
+		FBitWriter writer(0, true);
+		int32 senderId = 0;
+		uint32 numBones = POSE_REPLICATION_MAX_BONES + 1;
+		writer << senderId;
+		writer.SerializeIntPacked(numBones);
+
+		FBitReader reader(writer.GetData(), writer.GetNumBits());
+		FPoseDeltaPacket receivedPacket;
+		bool readSucceeded = true;
+		receivedPacket.NetSerialize(reader, nullptr, readSucceeded);
+		TestFalse(TEXT("Oversized delta packet refused"), readSucceeded);
+	}
+
+	// A sender and a receiver both starting from the same pose. Bones turned past the threshold go out in the delta,
+	// the settle sends everything else that changed, and afterwards the receiver has the sender's pose.
+	{
+		const int32 numBones = 8;
+		const float thresholdRadians = FMath::DegreesToRadians(1.0f);
+
+		FPoseBuffer senderPose;
+		makeTestPose(numBones, senderPose);
+		FPoseBuffer receiverPose;
+		makeTestPose(numBones, receiverPose);
+
+		FPoseReplicator sender;
+		sender.reset(senderPose, FVector::ZeroVector);
+		FPoseReplicator receiver;
+		receiver.reset(receiverPose, FVector::ZeroVector);
+		sender.refillBudget(1.0f, 100000);
+
+		FPoseDeltaPacket packet;
+		TestFalse(TEXT("Nothing to send before anything changes"), sender.buildDelta(senderPose, FVector::ZeroVector, thresholdRadians, packet));
+
+		turnBone(senderPose, 2, 20.0f);
+		turnBone(senderPose, 5, 0.5f);
+		const bool builtDelta = sender.buildDelta(senderPose, FVector::ZeroVector, thresholdRadians, packet);
+		TestTrue(TEXT("Delta holds only the bone past the threshold"), builtDelta && packet.boneIndices.Num() == 1 &&
+			packet.boneIndices[0] == 2 && !packet.hasActorLocation);
+
+		FPoseDeltaPacket receivedPacket;
+		TestTrue(TEXT("Delta survives serializing"), roundTripPacket(packet, receivedPacket));
+		applyDelta(receivedPacket, receiverPose, receiver);
+		TestFalse(TEXT("Delta isn't sent twice"), sender.buildDelta(senderPose, FVector::ZeroVector, thresholdRadians, packet));
+
+		// The delta may have been lost, so the settle sends it again along with the bone under the threshold
+		const FVector movedLocation(50.0f, 0.0f, 0.0f);
+		const bool builtSettle = sender.buildSettle(senderPose, movedLocation, packet);
+		TestTrue(TEXT("Settle holds every changed bone"), builtSettle && packet.boneIndices.Num() == 2 &&
+			packet.boneIndices[0] == 2 && packet.boneIndices[1] == 5 && packet.hasActorLocation);
+		TestTrue(TEXT("Settle survives serializing"), roundTripPacket(packet, receivedPacket));
+		applyDelta(receivedPacket, receiverPose, receiver);
+
+		TestTrue(TEXT("Receiver ends up with the sender's pose"), rotationsMatch(senderPose, receiverPose, 0.05f));
+		TestFalse(TEXT("Nothing to settle once settled"), sender.buildSettle(senderPose, movedLocation, packet));
+
+		// What the receiver was sent doesn't go back out from it
+		receiver.refillBudget(1.0f, 100000);
+		TestFalse(TEXT("Received bones aren't sent back"), receiver.buildDelta(receiverPose, movedLocation, thresholdRadians, packet));
+	}
+
+	// A budget with room for two bones sends the two biggest changes first and the rest in a later frame
+	{
+		const float thresholdRadians = FMath::DegreesToRadians(1.0f);
+
+		FPoseBuffer pose;
+		makeTestPose(6, pose);
+
+		FPoseReplicator sender;
+		sender.reset(pose, FVector::ZeroVector);
+		sender.refillBudget(1.0f, 88);
+
+		turnBone(pose, 1, 30.0f);
+		turnBone(pose, 3, 10.0f);
+		turnBone(pose, 4, 20.0f);
+
+		FPoseDeltaPacket packet;
+		const bool builtDelta = sender.buildDelta(pose, FVector::ZeroVector, thresholdRadians, packet);
+		TestTrue(TEXT("Budget sends the biggest changes"), builtDelta && packet.boneIndices.Num() == 2 &&
+			packet.boneIndices[0] == 1 && packet.boneIndices[1] == 4);
+
+		sender.refillBudget(1.0f, 88);
+		const bool builtRest = sender.buildDelta(pose, FVector::ZeroVector, thresholdRadians, packet);
+		TestTrue(TEXT("Budget sends the rest next frame"), builtRest && packet.boneIndices.Num() == 1 && packet.boneIndices[0] == 3);
+	}
+
+	// Keyframes queue once per time and a replaced timeline drops what was queued before it
+	{
+		FPoseBuffer pose;
+		makeTestPose(2, pose);
+
+		FPoseReplicator sender;
+		sender.reset(pose, FVector::ZeroVector);
+		sender.refillBudget(1.0f, 100000);
+
+		sender.queueKeyFrame(1.0f);
+		sender.queueKeyFrame(2.0f);
+		sender.queueKeyFrame(1.0f);
+
+		float keyFrameTime;
+		bool replacesTimeline;
+		TestTrue(TEXT("First queued keyframe"), sender.popQueuedKeyFrame(100, keyFrameTime, replacesTimeline) && keyFrameTime == 1.0f && !replacesTimeline);
+		TestTrue(TEXT("Second queued keyframe"), sender.popQueuedKeyFrame(100, keyFrameTime, replacesTimeline) && keyFrameTime == 2.0f);
+		TestFalse(TEXT("Repeated keyframe queued once"), sender.hasQueuedKeyFrames());
+
+		sender.queueKeyFrame(4.0f);
+		sender.queueTimelineReplaced();
+		sender.queueKeyFrame(3.0f);
+		TestTrue(TEXT("Replaced timeline's first keyframe"), sender.popQueuedKeyFrame(100, keyFrameTime, replacesTimeline) &&
+			keyFrameTime == 3.0f && replacesTimeline);
+		TestFalse(TEXT("Keyframes queued before the replacement dropped"), sender.hasQueuedKeyFrames());
+	}
+
+	return true;
+}
+
+#endif
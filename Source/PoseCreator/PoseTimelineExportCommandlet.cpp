@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseTimelineExportCommandlet.h"
+#include "TimelineFile.h"
+#include "AnimationExporter.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// One timeline file on its way to becoming an animation
+	struct FTimelineBake
+	{
+		FString filePath;
+		FAnimationExportSnapshot snapshot;
+		TArray<FRawAnimSequenceTrack> tracks;
+		FKeyReductionStats stats;
+		bool loaded;
+		double loadSeconds;
+		double trackSeconds;
+	};
+
+	// Read every keyframe of a timeline file into the snapshot as one frame each, the same as the in game export
+	// does with its recorded poses. Bones are matched up with the skeleton's by name. Saved poses are in world space,
+	// so bones the file doesn't have are placed at their reference offset from their parent as it was posed.
+	bool loadTimeline(const FString &filePath, const FReferenceSkeleton &referenceSkeleton, FAnimationExportSnapshot &snapshot)
+	{
+		FTimelineFileView timelineFile;
+		if (!timelineFile.open(filePath))
+		{
+			return false;
+		}
+
+		// Look the names up in a map so matching stays linear on big rigs, the first bone with a name wins like it
+		// would with a search
+		const TArray<FName> &fileBoneNames = timelineFile.getBoneNames();
+		TMap<FName, int32> fileBoneIndicesByName;
+		fileBoneIndicesByName.Reserve(fileBoneNames.Num());
+		for (int32 fileBoneIndex = 0; fileBoneIndex < fileBoneNames.Num(); fileBoneIndex++)
+		{
+			if (!fileBoneIndicesByName.Contains(fileBoneNames[fileBoneIndex]))
+			{
+				fileBoneIndicesByName.Add(fileBoneNames[fileBoneIndex], fileBoneIndex);
+			}
+		}
+
+		const int32 numBones = referenceSkeleton.GetNum();
+		TArray<int32> fileBoneIndices;
+		fileBoneIndices.SetNumUninitialized(numBones);
+		bool bonesMatch = timelineFile.numBones() == numBones;
+		for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			const int32 *fileBoneIndex = fileBoneIndicesByName.Find(referenceSkeleton.GetBoneName(boneIndex));
+			fileBoneIndices[boneIndex] = fileBoneIndex != nullptr ? *fileBoneIndex : INDEX_NONE;
+			bonesMatch &= fileBoneIndices[boneIndex] == boneIndex;
+		}
+
+		snapshot.poses.SetNum(timelineFile.numKeyFrames());
+		for (int32 keyFrameIndex = 0; keyFrameIndex < timelineFile.numKeyFrames(); keyFrameIndex++)
+		{
+			FPoseBuffer &pose = snapshot.poses[keyFrameIndex];
+			if (bonesMatch)
+			{
+				timelineFile.readPose(keyFrameIndex, pose);
+				continue;
+			}
+
+			const FQuat *fileRotations = timelineFile.getRotations(keyFrameIndex);
+			const FVector *fileTranslations = timelineFile.getTranslations(keyFrameIndex);
+
+			const TArray<FTransform> &referenceLocalPose = referenceSkeleton.GetRefBonePose();
+			pose.setNumBones(numBones);
+
+			// Parents always come before their children, so a missing bone's parent is already in world space
+			for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+			{
+				int32 fileBoneIndex = fileBoneIndices[boneIndex];
+				int32 parentIndex = referenceSkeleton.GetParentIndex(boneIndex);
+				if (fileBoneIndex != INDEX_NONE)
+				{
+					pose.rotations[boneIndex] = fileRotations[fileBoneIndex];
+					pose.translations[boneIndex] = fileTranslations[fileBoneIndex];
+				}
+				else if (parentIndex != INDEX_NONE)
+				{
+					FTransform boneTransform = referenceLocalPose[boneIndex] * FTransform(pose.rotations[parentIndex], pose.translations[parentIndex]);
+					pose.rotations[boneIndex] = boneTransform.GetRotation();
+					pose.translations[boneIndex] = boneTransform.GetLocation();
+				}
+				else
+				{
+					// Nothing saved says where a missing root stood, so it stays at its reference transform
+					pose.rotations[boneIndex] = referenceLocalPose[boneIndex].GetRotation();
+					pose.translations[boneIndex] = referenceLocalPose[boneIndex].GetLocation();
+				}
+			}
+		}
+
+		if (!bonesMatch)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Timeline %s was saved from a different skeleton, bones were matched up by name"), *filePath);
+			if (numBones > 0 && fileBoneIndices[0] == INDEX_NONE)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Timeline %s doesn't have the root bone, it's left at its reference transform!!!"), *filePath);
+			}
+		}
+		return true;
+	}
+
+	bool saveAnimation(UAnimSequence *animation)
+	{
+		UPackage *package = animation->GetOutermost();
+		FString packageFileName = FPackageName::LongPackageNameToFilename(package->GetName(), FPackageName::GetAssetPackageExtension());
+		return UPackage::SavePackage(package, animation, RF_Public | RF_Standalone, *packageFileName);
+	}
+}
+
+UPoseTimelineExportCommandlet::UPoseTimelineExportCommandlet(const FObjectInitializer& ObjectInitializer) :
+	Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UPoseTimelineExportCommandlet::Main(const FString &Params)
+{
+	FString timelineDirectory;
+	FString skeletonPath;
+	if (!FParse::Value(*Params, TEXT("dir="), timelineDirectory) || !FParse::Value(*Params, TEXT("skeleton="), skeletonPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=PoseTimelineExport -dir=<timeline directory> -skeleton=<skeleton asset> [-output=/Game/BakedAnimations] [-filter=*] [-batch=32] [-noreduction] [-postolerance=0.01] [-angletolerance=0.1] [-nosave]"));
+		return 1;
+	}
+
+	USkeleton *skeleton = LoadObject<USkeleton>(nullptr, *skeletonPath);
+	if (skeleton == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't load skeleton %s"), *skeletonPath);
+		return 1;
+	}
+
+	FString outputPath = TEXT("/Game/BakedAnimations");
+	FParse::Value(*Params, TEXT("output="), outputPath);
+
+	FString filter = TEXT("*");
+	FParse::Value(*Params, TEXT("filter="), filter);
+
+	// Only a batch of files is held in memory at once, hundreds of captured sessions won't all fit
+	int32 batchSize = 32;
+	FParse::Value(*Params, TEXT("batch="), batchSize);
+	batchSize = FMath::Max(batchSize, 1);
+
+	FKeyReductionSettings keyReduction;
+	keyReduction.enabled = !FParse::Param(*Params, TEXT("noreduction"));
+	FParse::Value(*Params, TEXT("postolerance="), keyReduction.maxPositionError);
+	FParse::Value(*Params, TEXT("angletolerance="), keyReduction.maxAngleErrorDegrees);
+
+	const bool savePackages = !FParse::Param(*Params, TEXT("nosave"));
+
+	TArray<FString> fileNames;
+	IFileManager::Get().FindFiles(fileNames, *(timelineDirectory / filter), true, false);
+	fileNames.Sort();
+
+	if (fileNames.Num() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No timeline files matching %s in %s"), *filter, *timelineDirectory);
+		return 0;
+	}
+
+	// Everything that's the same for every file is worked out once
+	const FReferenceSkeleton &referenceSkeleton = skeleton->GetReferenceSkeleton();
+	const int32 numBones = referenceSkeleton.GetNum();
+
+	TArray<FName> boneNames;
+	TArray<FVector> boneScales;
+	boneNames.SetNumUninitialized(numBones);
+	boneScales.SetNumUninitialized(numBones);
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		boneNames[boneIndex] = referenceSkeleton.GetBoneName(boneIndex);
+		boneScales[boneIndex] = referenceSkeleton.GetRefBonePose()[boneIndex].GetScale3D();
+	}
+
+	int32 numBaked = 0;
+	int64 numPosesBaked = 0;
+	const double startTime = FPlatformTime::Seconds();
+
+	for (int32 batchStart = 0; batchStart < fileNames.Num(); batchStart += batchSize)
+	{
+		const int32 numInBatch = FMath::Min(batchSize, fileNames.Num() - batchStart);
+
+		TArray<FTimelineBake> bakes;
+		bakes.SetNum(numInBatch);
+		for (int32 bakeIndex = 0; bakeIndex < numInBatch; bakeIndex++)
+		{
+			const FString &fileName = fileNames[batchStart + bakeIndex];
+			FTimelineBake &bake = bakes[bakeIndex];
+			bake.filePath = timelineDirectory / fileName;
+			bake.snapshot.skeleton = skeleton;
+			bake.snapshot.boneNames = boneNames;
+			bake.snapshot.boneScales = boneScales;
+			bake.snapshot.keyReduction = keyReduction;
+			bake.snapshot.assetPackageName = outputPath / FPaths::GetBaseFilename(fileName);
+			bake.loaded = false;
+			bake.loadSeconds = 0.0;
+			bake.trackSeconds = 0.0;
+		}
+
+		// Reading the files and building their tracks doesn't touch any UObjects, so the whole batch goes wide
+		ParallelFor(numInBatch, [&bakes, &referenceSkeleton](int32 bakeIndex)
+		{
+			FTimelineBake &bake = bakes[bakeIndex];
+
+			double loadStartTime = FPlatformTime::Seconds();
+			bake.loaded = loadTimeline(bake.filePath, referenceSkeleton, bake.snapshot);
+			bake.loadSeconds = FPlatformTime::Seconds() - loadStartTime;
+
+			if (bake.loaded && bake.snapshot.poses.Num() > 0)
+			{
+				double trackStartTime = FPlatformTime::Seconds();
+				AnimationExporter::buildTracks(bake.snapshot, bake.tracks, bake.stats);
+				bake.trackSeconds = FPlatformTime::Seconds() - trackStartTime;
+			}
+		});
+
+		// Assets can only be created and saved on the game thread
+		for (FTimelineBake &bake : bakes)
+		{
+			if (!bake.loaded)
+			{
+				continue;
+			}
+
+			const int32 numPoses = bake.snapshot.poses.Num();
+			if (numPoses == 0)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Timeline %s has no keyframes, skipping it"), *bake.filePath);
+				continue;
+			}
+
+			double assetStartTime = FPlatformTime::Seconds();
+			UAnimSequence *animation = AnimationExporter::createAnimationAsset(bake.snapshot, MoveTemp(bake.tracks), bake.stats);
+			bool saved = animation != nullptr && (!savePackages || saveAnimation(animation));
+			double assetSeconds = FPlatformTime::Seconds() - assetStartTime;
+
+			if (!saved)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Couldn't create an animation for %s"), *bake.filePath);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-40s %5d poses %8.2f ms load %8.2f ms tracks %8.2f ms asset, %d of %d keys kept -> %s"),
+				*FPaths::GetCleanFilename(bake.filePath), numPoses, bake.loadSeconds * 1000.0, bake.trackSeconds * 1000.0,
+				assetSeconds * 1000.0, bake.stats.keptKeys, bake.stats.rawKeys, *animation->GetPathName());
+
+			numBaked++;
+			numPosesBaked += numPoses;
+		}
+	}
+
+	const double totalSeconds = FMath::Max(FPlatformTime::Seconds() - startTime, SMALL_NUMBER);
+	UE_LOG(LogTemp, Display, TEXT("Baked %d of %d timelines, %lld poses of %d bones in %.2f s: %.2f timelines/sec, %.1f poses/sec"),
+		numBaked, fileNames.Num(), numPosesBaked, numBones, totalSeconds, numBaked / totalSeconds, numPosesBaked / totalSeconds);
+
+	return numBaked == fileNames.Num() ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "PoseTimelineExportCommandlet.generated.h"
+
+// Bakes a directory of saved timelines into animation sequence assets, without loading a map or creating any actors.
+// Run it headless with
+//
+//   UE4Editor-Cmd PoseCreator.uproject -run=PoseTimelineExport -nullrhi -dir=<timeline directory> -skeleton=<skeleton asset>
+//       [-output=/Game/BakedAnimations] [-filter=*] [-batch=32] [-noreduction] [-postolerance=0.01] [-angletolerance=0.1] [-nosave]
+//
+// Each batch of files is read and has its tracks built in parallel by the same exporter the in game export uses, then
+// the assets are created and saved on the game thread. Timings for every file and the overall throughput are logged.
+UCLASS()
+class UPoseTimelineExportCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UPoseTimelineExportCommandlet(const FObjectInitializer& ObjectInitializer);
+
+	virtual int32 Main(const FString &Params) override;
+};
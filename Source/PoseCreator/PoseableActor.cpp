@@ -2,17 +2,26 @@
 
 #include "PoseCreator.h"
 #include "PoseableActor.h"
-#include "Kismet/KismetMathLibrary.h"
+#include "PoseBlending.h"
+#include "TimelineFile.h"
+#include "PoseMath.h"
+#include "PoseCreatorStats.h"
+#include "PoseableActorManager.h"
+#include "PoseReplicationComponent.h"
 #include "Animation/AnimSequence.h"
-#include "AssetRegistryModule.h"
-#include "../AssetTools/Public/AssetToolsModule.h"
-#include "ModuleManager.h"
 
 // Some hard coded depth values to color the highlights of elements differently
 #define BONE_REFERENCE_DEPTH 253
 #define SELECTION_DEPTH 252
 #define BONE_SELECTED_DEPTH 254
 
+// Size of the bone reference meshes, the selected reference is drawn slightly bigger so it covers the regular one
+#define BONE_REFERENCE_SCALE 0.01f
+#define SELECTED_BONE_REFERENCE_SCALE 0.012f
+
+// How many poses mirroring every keyframe unpacks at a time
+#define MIRROR_BATCH_POSES 256
+
 // Sets default values
 APoseableActor::APoseableActor(const FObjectInitializer& ObjectInitializer) :
 	Super(ObjectInitializer)
@@ -22,6 +31,43 @@ APoseableActor::APoseableActor(const FObjectInitializer& ObjectInitializer) :
 
 	static ConstructorHelpers::FObjectFinder<UStaticMesh> BoneMesh(TEXT("/Game/PoseCreator/Meshes/FirstPersonProjectileMesh"));
 	boneMesh = BoneMesh.Object;
+
+	FKeyReductionSettings defaultKeyReduction;
+	reduceExportedKeys = defaultKeyReduction.enabled;
+	exportPositionTolerance = defaultKeyReduction.maxPositionError;
+	exportAngleToleranceDegrees = defaultKeyReduction.maxAngleErrorDegrees;
+
+	undoHistoryBudgetMB = 16;
+
+	applyPoseTick.bCanEverTick = true;
+	applyPoseTick.TickGroup = TG_PostPhysics;
+	applyPoseTick.target = this;
+	timelineEvaluationRequested = false;
+	splineInterpolation = false;
+	batchedUpdate = true;
+	mirrorAxis = EAxis::X;
+
+	FIKSolverSettings defaultIKSettings;
+	useIKDrag = false;
+	ikChainLength = 2;
+	ikTolerance = defaultIKSettings.tolerance;
+	ikMaxIterations = defaultIKSettings.maxIterations;
+	ikTimeBudgetMilliseconds = defaultIKSettings.timeBudgetSeconds * 1000.0f;
+	ikMaxJointBendDegrees = FMath::RadiansToDegrees(defaultIKSettings.maxBendRadians);
+
+	snapToLibraryOnRelease = false;
+	poseLibraryMaxLeafChecks = 0;
+
+	quantizeKeyFrames = false;
+	keyFramePositionPrecision = 0.1f;
+	keyFrameAnglePrecisionDegrees = 0.05f;
+
+	// Every player poses the same actors, so they're relevant to everyone no matter where they stand
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	replicationBytesPerSecond = 32000;
+	replicationAngleThresholdDegrees = 0.5f;
+	replicationSettleRequested = false;
 }
 
 // Called when the game starts or when spawned
@@ -41,536 +87,1666 @@ void APoseableActor::BeginPlay()
 		UE_LOG(LogTemp, Error, TEXT("No poseable mesh component found on poseable actor, please add one!"));
 	}
 
-	// Create reference points for each of the bones
+	// Resolve all of the bones up front so nothing needs to look them up by name per frame
 	meshBoneInfo = poseableMesh->SkeletalMesh->Skeleton->GetReferenceSkeleton().GetRefBoneInfo();
-	for (int boneIndex = 0; boneIndex < meshBoneInfo.Num(); boneIndex++)
-	{
-		UStaticMeshComponent *newBoneReference = NewObject<UStaticMeshComponent>(this);
-		newBoneReference->SetStaticMesh(boneMesh);
-		newBoneReference->AttachToComponent(GetRootComponent(), FAttachmentTransformRules::KeepWorldTransform);
-		newBoneReference->SetRelativeScale3D(FVector(.01f, .01f, .01f));
-		newBoneReference->SetWorldLocation(poseableMesh->GetBoneLocationByName(meshBoneInfo[boneIndex].Name, EBoneSpaces::WorldSpace));
-		newBoneReference->RegisterComponentWithWorld(this->GetWorld());
-		newBoneReference->SetRenderCustomDepth(true);
-		newBoneReference->SetCustomDepthStencilValue(BONE_REFERENCE_DEPTH);
+	boneHandles.initialize(poseableMesh, meshBoneInfo);
 
-		boneReferences.Add(newBoneReference);
+	rootBoneIndex = boneHandles.findBone("root");
+	if (rootBoneIndex == INDEX_NONE)
+	{
+		rootBoneIndex = 0;
 	}
 
-	// Save out the first pose as the initial keyframe
-	FKeyFrame firstKeyFrame;
-	firstKeyFrame.boneTransforms = saveCurrentBoneState(true);
-	firstKeyFrame.keyFrameTime = 0.0f;
-	keyFrames.Add(firstKeyFrame);
-}
+	// Create reference points for each of the bones, all drawn by a single instanced component
+	boneReferences = NewObject<UInstancedStaticMeshComponent>(this);
+	boneReferences->SetStaticMesh(boneMesh);
+	boneReferences->AttachToComponent(GetRootComponent(), FAttachmentTransformRules::KeepWorldTransform);
+	boneReferences->RegisterComponentWithWorld(this->GetWorld());
+	boneReferences->SetRenderCustomDepth(true);
+	boneReferences->SetCustomDepthStencilValue(BONE_REFERENCE_DEPTH);
 
-// Called every frame
-void APoseableActor::Tick( float DeltaTime )
-{
-	Super::Tick( DeltaTime );
+	// Picking is done against the bone picker, so the references don't need any collision
+	boneReferences->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	boneReferences->bGenerateOverlapEvents = false;
 
-	// Update all of the bone reference locations
-	for (int boneIndex = 0; boneIndex < boneReferences.Num(); boneIndex++)
+	boneHandles.readWorldLocations(boneWorldLocations);
+	for (int boneIndex = 0; boneIndex < meshBoneInfo.Num(); boneIndex++)
 	{
-		FVector newReferenceLocation = poseableMesh->GetBoneLocationByName(meshBoneInfo[boneIndex].Name, EBoneSpaces::WorldSpace);
-		boneReferences[boneIndex]->SetWorldLocation(newReferenceLocation);
+		boneReferences->AddInstanceWorldSpace(FTransform(FQuat::Identity, boneWorldLocations[boneIndex], FVector(BONE_REFERENCE_SCALE)));
 	}
 
-	// Moving and rotating the entire skeletal mesh
-	if (rightGripBeingPressed)
-	{
-		// Rotate the whole mesh
-		if (leftGripBeingPressed)
-		{
-			FVector fromLeftToRightHand = rightHandSelectionSphere->GetComponentLocation() - LeftHandSelectionSphere->GetComponentLocation();
-			fromLeftToRightHand.Z = 0.0f;
-			fromLeftToRightHand.Normalize();
+	// Create the highlight for the selected bone, hidden until something gets selected
+	selectedBoneReference = NewObject<UStaticMeshComponent>(this);
+	selectedBoneReference->SetStaticMesh(boneMesh);
+	selectedBoneReference->AttachToComponent(GetRootComponent(), FAttachmentTransformRules::KeepWorldTransform);
+	selectedBoneReference->SetRelativeScale3D(FVector(SELECTED_BONE_REFERENCE_SCALE));
+	selectedBoneReference->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	selectedBoneReference->RegisterComponentWithWorld(this->GetWorld());
+	selectedBoneReference->SetRenderCustomDepth(true);
+	selectedBoneReference->SetCustomDepthStencilValue(BONE_SELECTED_DEPTH);
+	selectedBoneReference->SetVisibility(false);
+	selectedBoneIndex = INDEX_NONE;
 
-			float dotProduct = FVector::DotProduct(fromLeftToRightHand, initialGripVectorBetweenControllers);
-			float angleDifference = FMath::Acos(dotProduct);
+	boneReferenceRadius = boneMesh->GetBounds().SphereRadius * BONE_REFERENCE_SCALE;
+	overlappedBoneIndexLeftHand = INDEX_NONE;
+	overlappedBoneIndexRightHand = INDEX_NONE;
+	bonePicker.setCellSize(boneReferenceRadius * 4.0f);
 
-			FVector rotationAxis = FVector::CrossProduct(initialGripVectorBetweenControllers, fromLeftToRightHand);
-			FRotator newRotator = FRotator(FQuat(rotationAxis, angleDifference));
-			FRotator finalRotation = UKismetMathLibrary::ComposeRotators(initialActorRotation, newRotator);
+	poseHistory.setMemoryBudget((SIZE_T)FMath::Max(undoHistoryBudgetMB, 1) * 1024 * 1024);
+	boneEditInProgress = false;
+	actorMoveInProgress = false;
 
-			poseableMesh->SetBoneRotationByName("root", finalRotation, EBoneSpaces::WorldSpace);
-		}
-		// Move the whole mesh based on the movement of the right controller
-		else
-		{
-			FVector distanceVector = rightHandSelectionSphere->GetComponentLocation() - rightHandInitialGripPosition;
+	nearestLibraryPoseIndex = INDEX_NONE;
+	setPoseLibraryBones(poseLibraryBones);
 
-			rightHandInitialGripPosition = rightHandSelectionSphere->GetComponentLocation();
+	mirrorTable.build(poseableMesh->SkeletalMesh->Skeleton->GetReferenceSkeleton(), mirrorAxis, mirrorBoneOverrides);
 
-			this->SetActorLocation(this->GetActorLocation() + distanceVector);
-		}
-	}
+	keyFrames.setInterpolation(splineInterpolation ? ETimelineInterpolation::Spline : ETimelineInterpolation::Linear);
+	setQuantizedKeyFrames(quantizeKeyFrames);
 
-	// Rotating the selected bone of the skeleton
-	if (rightTriggerBeingPressed && boneReferenceOverlappingRight)
-	{
-		// Get the vector to the next bone
-		FVector vectorToRightHand = selectionSphereRightHand->GetComponentLocation() -
-			poseableMesh->GetBoneLocationByName(meshBoneInfo[overlappedBoneRighttHandInfo.ParentIndex].Name, EBoneSpaces::WorldSpace);
-		// Calculate the new rotation of the bone
-		vectorToRightHand.Normalize();
+	// Save out the first pose as the initial keyframe
+	FPoseBuffer initialPose = posePool.acquire(boneHandles.numBones());
+	boneHandles.readWorldPose(initialPose);
 
-		float dotProduct = FVector::DotProduct(startingLeftToRightVector, vectorToRightHand);
-		float angleDifference = FMath::Acos(dotProduct);
+	bool overwroteKeyFrame;
+	keyFrames.setKeyFrame(0.0f, MoveTemp(initialPose), overwroteKeyFrame);
 
-		FVector rotationAxis = FVector::CrossProduct(startingLeftToRightVector, vectorToRightHand);
-		FRotator newRotation = FRotator(FQuat(rotationAxis, angleDifference));
-		FRotator finalRotation = UKismetMathLibrary::ComposeRotators(startingBoneRotation, newRotation);
-		// Add in the trackpad rotation to get that final axis
-		FRotator finalTrackpadRotation = FRotator(FQuat(finalRotation.Vector(), trackpadRotation));
-		finalRotation = UKismetMathLibrary::ComposeRotators(finalRotation, finalTrackpadRotation);
+	// Bones stay well within twice the mesh's bounds however they're posed
+	const FBoxSphereBounds meshBounds = poseableMesh->SkeletalMesh->GetImportedBounds();
+	const float translationReach = meshBounds.Origin.Size() + meshBounds.SphereRadius * 2.0f;
+	keyFrameTranslationRange = FTranslationQuantizationRange(FBox(FVector(-translationReach), FVector(translationReach)));
 
-		poseableMesh->SetBoneRotationByName(meshBoneInfo[overlappedBoneRighttHandInfo.ParentIndex].Name, finalRotation, EBoneSpaces::WorldSpace);
-	}
-}
+	// Everyone starts out with the actor as it was placed, so edits are sent relative to that
+	poseReplicator.reset(saveCurrentBoneState(false), GetActorLocation());
 
-void APoseableActor::resetSkeleton()
-{
-	// TODO: Figure out if I just want to take the first keyframe here or clear all of them out??
+	// The manager ticks every batched actor in one pass, so the actor's own ticks would only do the work twice
+	if (batchedUpdate)
+	{
+		FPoseableActorManager::registerActor(this);
+		PrimaryActorTick.SetTickFunctionEnable(false);
+		applyPoseTick.SetTickFunctionEnable(false);
+	}
 }
 
-///////////////////////////////////////////////////////////
-//////////////////       CONTROLS     /////////////////////
-///////////////////////////////////////////////////////////
-
-void APoseableActor::overlapBoneReference(UStaticMeshComponent *overlappedBoneInput, UStaticMeshComponent *selectionSphereInput, bool leftHand)
+void APoseableActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	if (rightTriggerBeingPressed)
+	if (batchedUpdate)
 	{
-		return;
+		FPoseableActorManager::unregisterActor(this);
 	}
+	timelineEvaluator.wait();
 
-	boneReferenceOverlappingRight = false;
-	overlappedBoneRightHand = overlappedBoneInput;
-	selectionSphereRightHand = selectionSphereInput;
+	Super::EndPlay(EndPlayReason);
+}
 
-	overlappedBoneRightHand->SetCustomDepthStencilValue(BONE_SELECTED_DEPTH);
-	selectionSphereRightHand->SetCustomDepthStencilValue(BONE_SELECTED_DEPTH);
+void APoseableActor::RegisterActorTickFunctions(bool bRegister)
+{
+	Super::RegisterActorTickFunctions(bRegister);
 
-	// Search for the name of the overlapped bone
-	for (int boneIndex = 0; boneIndex < boneReferences.Num(); boneIndex++)
+	if (bRegister)
 	{
-		if (boneReferences[boneIndex] == overlappedBoneRightHand)
+		if (applyPoseTick.bCanEverTick)
 		{
-			overlappedBoneNameRightHand = meshBoneInfo[boneIndex].Name;
-			overlappedBoneRighttHandInfo = meshBoneInfo[boneIndex];
-			overlappedBoneParentName = meshBoneInfo[meshBoneInfo[boneIndex].ParentIndex].Name;
-			boneReferenceOverlappingRight = true;
+			applyPoseTick.target = this;
+			applyPoseTick.SetTickFunctionEnable(applyPoseTick.bStartWithTickEnabled);
+			applyPoseTick.RegisterTickFunction(GetLevel());
+			applyPoseTick.AddPrerequisite(this, PrimaryActorTick);
 		}
 	}
+	else if (applyPoseTick.IsTickFunctionRegistered())
+	{
+		applyPoseTick.UnRegisterTickFunction();
+	}
 }
 
-void APoseableActor::endOverlapBoneReference(UStaticMeshComponent *overlappedBoneInput, UStaticMeshComponent *selectionSphereInput, bool leftHand)
+void FPoseableActorApplyPoseTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef &MyCompletionGraphEvent)
 {
-	if (rightTriggerBeingPressed)
+	if (target != nullptr && !target->IsPendingKillOrUnreachable())
 	{
-		return;
+		target->applyEvaluatedPose();
 	}
+}
 
-	boneReferenceOverlappingRight = false;
-
-	overlappedBoneInput->SetCustomDepthStencilValue(BONE_REFERENCE_DEPTH);
-	selectionSphereInput->SetCustomDepthStencilValue(SELECTION_DEPTH);
+FString FPoseableActorApplyPoseTickFunction::DiagnosticMessage()
+{
+	return target->GetFullName() + TEXT("[ApplyPose]");
 }
 
-void APoseableActor::gripPressed(UStaticMeshComponent *selectionSphere, bool leftHand)
+void APoseableActor::applyEvaluatedPose()
 {
-	if (leftHand)
-	{
-		leftGripBeingPressed = true;
-		LeftHandSelectionSphere = selectionSphere;
-	}
-	else
-	{
-		rightGripBeingPressed = true;
-		rightHandSelectionSphere = selectionSphere;
-		rightHandInitialGripPosition = selectionSphere->GetComponentLocation();
-	}
+	POSECREATOR_SCOPE_TIMING(ApplyEvaluatedPose);
 
-	// If both grips are being pressed keep track of the vector between them to later rotate the poseable mesh
-	if (leftGripBeingPressed && rightGripBeingPressed)
+	const FPoseBuffer *evaluatedPose = timelineEvaluator.collect();
+	if (evaluatedPose == nullptr)
 	{
-		initialGripVectorBetweenControllers = rightHandSelectionSphere->GetComponentLocation() - LeftHandSelectionSphere->GetComponentLocation();
-		initialGripVectorBetweenControllers.Z = 0;
-		initialGripVectorBetweenControllers.Normalize();
-		initialActorRotation = poseableMesh->GetBoneRotationByName("root", EBoneSpaces::WorldSpace);
+		return;
 	}
+
+	changeBoneState(*evaluatedPose);
+
+	// The mesh has already ticked this frame, so refresh it now rather than showing the new pose a frame late
+	poseableMesh->RefreshBoneTransforms();
 }
 
-void APoseableActor::gripReleased(bool leftHand)
+// Called every frame
+void APoseableActor::Tick( float DeltaTime )
 {
-	if (leftHand)
+	beginFrameUpdate(DeltaTime);
+
+	finishFrameUpdate(updateBoneLocations());
+}
+
+void APoseableActor::beginFrameUpdate(float DeltaTime)
+{
+	// Blueprint ticks and latent actions still run when the manager is doing the ticking
+	Super::Tick( DeltaTime );
+
+	// Last frame's scratch poses are free to be handed out again
+	posePool.resetFrame();
+
+	poseReplicator.refillBudget(DeltaTime, replicationBytesPerSecond);
+
+	// Kick off the timeline evaluation first so the worker has as long as possible before the pose is picked up
+	if (timelineEvaluationRequested)
 	{
-		if (rightGripBeingPressed)
-		{
-			rightGripBeingPressed = false;
-		}
-		leftGripBeingPressed = false;
+		timelineEvaluator.kick(keyFrames, currentAnimationTime);
+		timelineEvaluationRequested = false;
 	}
-	else
+}
+
+bool APoseableActor::updateBoneLocations()
+{
+	// Only the bones that changed since the last frame are updated, an actor nobody is touching skips this entirely
+	if (!boneHandles.updateDirtyWorldLocations(boneWorldLocations, updatedBoneIndices))
 	{
-		rightGripBeingPressed = false;
+		return false;
 	}
+
+	bonePicker.rebuild(boneWorldLocations);
+	return true;
 }
 
-void APoseableActor::triggerPressed(UStaticMeshComponent *selectionSphere, bool leftHand)
+void APoseableActor::finishFrameUpdate(bool boneLocationsChanged)
 {
-	// If the left hand trigger is pressed, add a keyframe to the animation we will save out
-	if (leftHand)
+	// Move the references of the bones that moved
+	if (boneLocationsChanged)
 	{
-		animationPoses.Add(saveCurrentBoneState(true));
+		POSECREATOR_SCOPE_TIMING(UpdateBoneReferences);
+		updateBoneReferences();
+		FPoseCreatorTimings::addBonesUpdated(updatedBoneIndices.Num());
+	}
 
-		FKeyFrame newKeyFrame;
-		newKeyFrame.boneTransforms = saveCurrentBoneState(true);
-		newKeyFrame.keyFrameTime = currentAnimationTime;
+	// Figure out which bones the hands are touching now that the bones are in place
+	updateBoneSelection();
 
-		for (int keyFrameIndex = 0; keyFrameIndex < keyFrames.Num(); keyFrameIndex++)
+	// Moving and rotating the entire skeletal mesh
+	if (rightGripBeingPressed)
+	{
+		// Rotate the whole mesh
+		if (leftGripBeingPressed)
 		{
-			if (keyFrames[keyFrameIndex].keyFrameTime == currentAnimationTime)
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Overwriting other keyframe instead of adding a new one!!!"));
-
-				keyFrames[keyFrameIndex].boneTransforms = newKeyFrame.boneTransforms;
-				return;
-			}
+			FVector fromLeftToRightHand = rightHandSelectionSphere->GetComponentLocation() - LeftHandSelectionSphere->GetComponentLocation();
+			boneHandles.setBoneWorldRotation(rootBoneIndex, PoseMath::twoHandRotation(initialActorRotation, initialGripVectorBetweenControllers, fromLeftToRightHand));
 		}
-
-		keyFrames.Add(newKeyFrame);
-		return;
-	}
-	// If the right trigger is pressed, check to see if a bone is selected and if so allow that bone to be rotated
-	else
-	{
-		rightTriggerBeingPressed = true;
-		rightHandSelectionSphere = selectionSphere;
-		trackpadRotation = 0.0f;
-
-		if (boneReferenceOverlappingRight)
+		// Move the whole mesh based on the movement of the right controller
+		else
 		{
-			FName overlappedBoneParentName = meshBoneInfo[overlappedBoneRighttHandInfo.ParentIndex].Name;
+			FVector distanceVector = rightHandSelectionSphere->GetComponentLocation() - rightHandInitialGripPosition;
 
-			startingLeftToRightVector = overlappedBoneRightHand->GetComponentLocation() -
-				poseableMesh->GetBoneLocationByName(overlappedBoneParentName, EBoneSpaces::WorldSpace);
-			startingLeftToRightVector.Normalize();
+			rightHandInitialGripPosition = rightHandSelectionSphere->GetComponentLocation();
 
-			startingBoneRotation = poseableMesh->GetBoneRotationByName(overlappedBoneParentName, EBoneSpaces::WorldSpace);
+			this->SetActorLocation(this->GetActorLocation() + distanceVector);
 		}
 	}
-}
 
-void APoseableActor::triggerReleased(bool leftHand)
-{
-	if (leftHand)
-	{
-		return;
-	}
-	else
+	// Rotating the selected bone of the skeleton
+	if (rightTriggerBeingPressed && boneReferenceOverlappingRight)
 	{
-		rightTriggerBeingPressed = false;
+		POSECREATOR_SCOPE_TIMING(BoneDrag);
 
-		trackpadRotation = 0.0f;
-
-		if (selectionSphereRightHand != nullptr)
-		{
-			selectionSphereRightHand->SetCustomDepthStencilValue(SELECTION_DEPTH);
-		}
-		if (selectionSphereLeftHand != nullptr)
+		if (ikSolver.hasChain())
 		{
-			selectionSphereLeftHand->SetCustomDepthStencilValue(SELECTION_DEPTH);
+			// Pull the dragged bone to the controller with the bones above it
+			FIKSolverSettings ikSettings;
+			ikSettings.maxIterations = ikMaxIterations;
+			ikSettings.tolerance = ikTolerance;
+			ikSettings.timeBudgetSeconds = ikTimeBudgetMilliseconds * 0.001f;
+			ikSettings.maxBendRadians = FMath::DegreesToRadians(ikMaxJointBendDegrees);
+			ikSolver.solve(boneHandles, selectionSphereRightHand->GetComponentLocation(), ikSettings);
 		}
-		if (overlappedBoneRightHand != nullptr)
+		else
 		{
-			overlappedBoneRightHand->SetCustomDepthStencilValue(BONE_REFERENCE_DEPTH);
+			// Get the vector to the next bone
+			FVector vectorToRightHand = selectionSphereRightHand->GetComponentLocation() - boneHandles.getBoneWorldLocation(overlappedBoneParentIndex);
+			vectorToRightHand.Normalize();
+
+			// Calculate the new rotation of the bone, with the trackpad rotation added in to get that final axis
+			FQuat finalRotation = PoseMath::dragBoneRotation(startingBoneRotation, startingLeftToRightVector, vectorToRightHand, trackpadRotation);
+			boneHandles.setBoneWorldRotation(overlappedBoneParentIndex, finalRotation);
 		}
-		if (overlappedBoneLeftHand != nullptr)
+
+		// Keep track of the closest library pose so letting go can snap to it
+		if (poseLibrary.numPoses() > 0)
 		{
-			overlappedBoneLeftHand->SetCustomDepthStencilValue(BONE_REFERENCE_DEPTH);
+			boneHandles.readWorldPose(poseLibraryQuery);
+			poseLibrary.setMaxLeafChecks(poseLibraryMaxLeafChecks);
+			nearestLibraryPoseIndex = poseLibrary.findNearestPose(poseLibraryQuery);
 		}
 	}
+
+	// Send this frame's edits once they've all been made
+	replicateEdits();
 }
 
-void APoseableActor::rotateBoneAroundAxis(float rotationRadians)
+void APoseableActor::updateBoneReferences()
 {
-	if (rightTriggerBeingPressed && boneReferenceOverlappingRight)
+	// Update the instances without touching the render state, then mark it dirty once for the whole batch
+	for (int updatedIndex = 0; updatedIndex < updatedBoneIndices.Num(); updatedIndex++)
 	{
-		trackpadRotation += rotationRadians;
+		int32 boneIndex = updatedBoneIndices[updatedIndex];
+		FTransform instanceTransform(FQuat::Identity, boneWorldLocations[boneIndex], FVector(BONE_REFERENCE_SCALE));
+		boneReferences->UpdateInstanceTransform(boneIndex, instanceTransform, true, false, true);
 	}
-}
+	boneReferences->MarkRenderStateDirty();
 
-///////////////////////////////////////////////////////////
-//////////////////   SAVING ANIMATION  ////////////////////
-///////////////////////////////////////////////////////////
+	if (selectedBoneIndex != INDEX_NONE)
+	{
+		selectedBoneReference->SetWorldLocation(boneWorldLocations[selectedBoneIndex]);
+	}
+}
 
-void APoseableActor::saveCurrentPose()
+void APoseableActor::setSelectedBone(int32 boneIndex)
 {
-	if (animationPoses.Num() == 0)
+	selectedBoneIndex = boneIndex;
+
+	// Nothing to highlight with until BeginPlay has created the bone references
+	if (selectedBoneReference == nullptr)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No animation poses recorded yet, can't save out an animation!!!"));
 		return;
 	}
 
-	// Generate an animation asset
-	FString Name;
-	FString PackageName;
-	FAssetToolsModule& AssetToolsModule = FModuleManager::Get().LoadModuleChecked<FAssetToolsModule>("AssetTools");
-	AssetToolsModule.Get().CreateUniqueAssetName(poseableMesh->SkeletalMesh->Skeleton->GetOutermost()->GetName(), TEXT("_GeneratedAnimation"), PackageName, Name);
-	UAnimationAsset* NewAsset = Cast<UAnimationAsset>(AssetToolsModule.Get().CreateAsset(Name, FPackageName::GetLongPackagePath(PackageName),
-		UAnimSequence::StaticClass(), NULL));
-
-	if (!NewAsset)
+	if (selectedBoneIndex == INDEX_NONE)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Animation could not be created!!"));
+		selectedBoneReference->SetVisibility(false);
 		return;
 	}
 
-	// Assign a skeletal mesh to the animation
-	NewAsset->SetSkeleton(poseableMesh->SkeletalMesh->Skeleton);
-	NewAsset->MarkPackageDirty();
-
-	UAnimSequence* NewAnimSequence = Cast<UAnimSequence>(NewAsset);
+	selectedBoneReference->SetWorldLocation(boneWorldLocations[selectedBoneIndex]);
+	selectedBoneReference->SetVisibility(true);
+}
 
-	if (!NewAnimSequence)
+void APoseableActor::updateBoneSelection()
+{
+	// Keep the selection locked while a bone is being dragged
+	if (rightTriggerBeingPressed)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Animation could not be converted to an anim sequence!!"));
 		return;
 	}
 
-	// Get some data we'll need to generate the animation sequence
-	const FReferenceSkeleton& RefSkeleton = poseableMesh->SkeletalMesh->RefSkeleton;
-	int32 NumBones = poseableMesh->SkeletalMesh->RefSkeleton.GetNum();
-	const TArray<FTransform>& LocalAtoms = poseableMesh->LocalAtoms;
-
-	// Initialize some data for the animation sequence
-	NewAnimSequence->NumFrames = animationPoses.Num();
-	NewAnimSequence->SequenceLength = animationPoses.Num();
-	NewAnimSequence->RawAnimationData.AddZeroed(NumBones);
-	NewAnimSequence->AnimationTrackNames.AddUninitialized(NumBones);
-
-	// Sanity check
-	check(LocalAtoms.Num() == NumBones);
-
-	// Write out the raw animation data
-	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	int32 leftHandBone = pickBone(selectionSphereLeftHand);
+	if (leftHandBone != overlappedBoneIndexLeftHand)
 	{
-		NewAnimSequence->AnimationTrackNames[BoneIndex] = RefSkeleton.GetBoneName(BoneIndex);
-
-		FRawAnimSequenceTrack& RawTrack = NewAnimSequence->RawAnimationData[BoneIndex];
-
-		// For each keyframe right out the data for this bone
-		for (int32 keyframeIndex = 0; keyframeIndex < animationPoses.Num(); keyframeIndex++)
-		{
-			RawTrack.PosKeys.Add(animationPoses[keyframeIndex][BoneIndex].position);
-			RawTrack.RotKeys.Add(animationPoses[keyframeIndex][BoneIndex].rotation.Quaternion());
-			RawTrack.ScaleKeys.Add(LocalAtoms[BoneIndex].GetScale3D());
-		}
+		overlappedBoneIndexLeftHand = leftHandBone;
+		selectionSphereLeftHand->SetCustomDepthStencilValue(leftHandBone != INDEX_NONE ? BONE_SELECTED_DEPTH : SELECTION_DEPTH);
 	}
 
-	// Empty this out, not sure if it's needed or not
-	NewAnimSequence->TrackToSkeletonMapTable.Empty();
-	NewAnimSequence->TrackToSkeletonMapTable.AddUninitialized(NumBones);
-
-	// Get rid of all of the animation track data, not sure if this is required
-	const int32 NumTracks = NewAnimSequence->AnimationTrackNames.Num();
-	for (int32 I = NumTracks - 1; I >= 0; --I)
+	int32 rightHandBone = pickBone(selectionSphereRightHand);
+	if (rightHandBone != overlappedBoneIndexRightHand)
 	{
-		int32 BoneTreeIndex = RefSkeleton.FindBoneIndex(NewAnimSequence->AnimationTrackNames[I]);
-		if (BoneTreeIndex == INDEX_NONE)
-		{
-			if (NewAnimSequence->RawAnimationData.IsValidIndex(I))
-			{
-				NewAnimSequence->RawAnimationData.RemoveAt(I);
-				NewAnimSequence->AnimationTrackNames.RemoveAt(I);
-				NewAnimSequence->TrackToSkeletonMapTable.RemoveAt(I);
+		overlappedBoneIndexRightHand = rightHandBone;
+		selectionSphereRightHand->SetCustomDepthStencilValue(rightHandBone != INDEX_NONE ? BONE_SELECTED_DEPTH : SELECTION_DEPTH);
+		setSelectedBone(rightHandBone);
 
-				check(NewAnimSequence->RawAnimationData.Num() == NewAnimSequence->AnimationTrackNames.Num()
-					&& NewAnimSequence->AnimationTrackNames.Num() == NewAnimSequence->TrackToSkeletonMapTable.Num());
-			}
-		}
-		else
-		{
-			NewAnimSequence->TrackToSkeletonMapTable[I].BoneTreeIndex = BoneTreeIndex;
-		}
+		// Dragging rotates the parent, so the root bone can't be dragged
+		overlappedBoneParentIndex = rightHandBone != INDEX_NONE ? boneHandles.getParentIndex(rightHandBone) : INDEX_NONE;
+		boneReferenceOverlappingRight = overlappedBoneParentIndex != INDEX_NONE;
 	}
-
-	// Should recreate track map
-	NewAnimSequence->PostProcessSequence();
-
-	// Temporary includes to prevent the compiler from getting rid of the reference animation sequence
-	referenceAnimationSequence->PostProcessSequence();
-	referenceAnimationSequence->MarkPackageDirty();
-
-	// Flag UE4 that the animation has been created so that it will be recognized/able to be saved
-	FAssetRegistryModule::AssetCreated(NewAsset);
 }
 
-TArray<FBoneInfo> APoseableActor::saveCurrentBoneState(bool worldSpace)
+int32 APoseableActor::pickBone(UStaticMeshComponent *selectionSphere) const
 {
-	TArray<FBoneInfo> savedBoneInfo;
-
-	for (int boneIndex = 0; boneIndex < meshBoneInfo.Num(); boneIndex++)
+	if (selectionSphere == nullptr)
 	{
-		FBoneInfo newBoneInfo;
-		newBoneInfo.name = meshBoneInfo[boneIndex].Name;
-
-		if (worldSpace)
-		{
-			newBoneInfo.position = poseableMesh->GetBoneLocationByName(meshBoneInfo[boneIndex].Name, EBoneSpaces::WorldSpace);
-			newBoneInfo.rotation = poseableMesh->GetBoneRotationByName(meshBoneInfo[boneIndex].Name, EBoneSpaces::WorldSpace);
-		}
-		else
-		{
-			newBoneInfo.position = poseableMesh->LocalAtoms[boneIndex].GetTranslation();
-			newBoneInfo.rotation = FRotator(poseableMesh->LocalAtoms[boneIndex].GetRotation());
-		}
-
-		savedBoneInfo.Add(newBoneInfo);
+		return INDEX_NONE;
 	}
 
-	return savedBoneInfo;
+	return bonePicker.findNearestBone(selectionSphere->GetComponentLocation(), selectionSphere->Bounds.SphereRadius + boneReferenceRadius);
+}
+
+void APoseableActor::resetSkeleton()
+{
+	// Resetting is just another bone edit, so it can be undone like one
+	beginBoneEdit();
+	boneHandles.resetRotationsToReferencePose();
+	finishBoneEditIfIdle();
 }
 
 ///////////////////////////////////////////////////////////
-////////////////// ANIMATION UTILITIES ////////////////////
+//////////////////    UNDO / REDO     /////////////////////
 ///////////////////////////////////////////////////////////
 
-void APoseableActor::changeBoneState(TArray<FBoneInfo> newPose)
+bool APoseableActor::undo()
 {
-	for (int boneIndex = 0; boneIndex < newPose.Num(); boneIndex++)
+	// Swapping state in underneath an edit that's still being recorded would get mixed into it
+	if (boneEditInProgress || actorMoveInProgress)
 	{
-		poseableMesh->SetBoneRotationByName(newPose[boneIndex].name, newPose[boneIndex].rotation, EBoneSpaces::WorldSpace);
+		UE_LOG(LogTemp, Warning, TEXT("Can't undo while editing!!!"));
+		return false;
 	}
+
+	return poseHistory.undo([this](FPoseEdit &edit) { applyPoseEdit(edit, true); });
 }
 
-void APoseableActor::setCurrentAnimationTime(float newAnimationTime)
+bool APoseableActor::redo()
 {
-	currentAnimationTime = newAnimationTime;
-
-	if (animationPoses.Num() == 0)
+	if (boneEditInProgress || actorMoveInProgress)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No animation poses saved!!!"));
-		return;
+		UE_LOG(LogTemp, Warning, TEXT("Can't redo while editing!!!"));
+		return false;
 	}
 
-	// Find the two frames to interpolate between for this time in the animation
-	FKeyFrame previousFrame;
-	FKeyFrame nextFrame;
-	bool nextFrameFound = findPreviousAndNextKeyframes(currentAnimationTime, previousFrame, nextFrame);
+	return poseHistory.redo([this](FPoseEdit &edit) { applyPoseEdit(edit, false); });
+}
+
+bool APoseableActor::canUndo() const
+{
+	return poseHistory.canUndo();
+}
+
+bool APoseableActor::canRedo() const
+{
+	return poseHistory.canRedo();
+}
 
-	// If the next frame can't be found just play the first frame
-	if (!nextFrameFound)
+void APoseableActor::beginBoneEdit()
+{
+	if (boneEditInProgress)
 	{
-		changeBoneState(previousFrame.boneTransforms);
 		return;
 	}
 
-	// Find out how much we need to interpolate these guys
-	float timeDifference = nextFrame.keyFrameTime - previousFrame.keyFrameTime;
-	float timePastFirstFrame = currentAnimationTime - previousFrame.keyFrameTime;
+	boneHandles.readLocalPose(boneEditStartPose);
+	boneEditInProgress = true;
+}
 
-	if (timeDifference == 0.0f)
+void APoseableActor::finishBoneEditIfIdle()
+{
+	bool bonesBeingEdited = rightTriggerBeingPressed || (leftGripBeingPressed && rightGripBeingPressed);
+	if (!boneEditInProgress || bonesBeingEdited)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Found two frames with the same time!"));
 		return;
 	}
 
-	// Get the interpolated pose between the two keyframes and change the bone state to reflect that
-	TArray<FBoneInfo> interpolatedPose = intepolateTwoPoses(timePastFirstFrame / timeDifference, previousFrame.boneTransforms, nextFrame.boneTransforms);
-	changeBoneState(interpolatedPose);
+	boneHandles.readLocalPose(boneEditEndPose);
+	poseHistory.recordBoneEdit(boneEditStartPose, boneEditEndPose);
+	boneEditInProgress = false;
+	replicationSettleRequested = true;
 }
 
-
-TArray<FBoneInfo> APoseableActor::intepolateTwoPoses(float percentageOfSecondPose, TArray<FBoneInfo> firstPose, TArray<FBoneInfo> secondPose)
+void APoseableActor::applyPoseEdit(FPoseEdit &edit, bool undoing)
 {
-	if (firstPose.Num() != secondPose.Num())
-	{
-		UE_LOG(LogTemp, Error, TEXT("The two poses to interpolate don't have the same number of bones"));
-		return firstPose;
-	}
+	// Keyframe edits change the timeline, which can't happen under an evaluation
+	timelineEvaluator.wait();
 
-	// Check to see if any interpolation is needed
-	if (percentageOfSecondPose == 0.0f)
+	switch (edit.type)
 	{
-		return firstPose;
-	}
-	else if (percentageOfSecondPose == 1.0f)
+	case EPoseEditType::BoneRotations:
+		for (int32 editIndex = 0; editIndex < edit.boneIndices.Num(); editIndex++)
+		{
+			int32 boneIndex = edit.boneIndices[editIndex];
+			FQuat currentRotation = boneHandles.getBoneLocalRotation(boneIndex);
+			boneHandles.setBoneLocalRotation(boneIndex, edit.boneRotations[editIndex]);
+			edit.boneRotations[editIndex] = currentRotation;
+		}
+		replicationSettleRequested = true;
+		break;
+
+	case EPoseEditType::ActorMove:
 	{
-		return secondPose;
+		FVector currentLocation = GetActorLocation();
+		SetActorLocation(edit.actorLocation);
+		edit.actorLocation = currentLocation;
+		replicationSettleRequested = true;
+		break;
 	}
 
-	// The new pose that will be generated
-	TArray<FBoneInfo> interpolatedPose;
-
-	for (int boneIndex = 0; boneIndex < firstPose.Num(); boneIndex++)
+	case EPoseEditType::KeyFrameAdded:
 	{
-		FBoneInfo firstPoseBone = firstPose[boneIndex];
-		FBoneInfo secondPoseBone = secondPose[boneIndex];
-
-		FTransform firstBoneTransform(firstPoseBone.rotation, firstPoseBone.position);
-		FTransform secondBoneTransform(secondPoseBone.rotation, secondPoseBone.position);
-
-		ScalarRegister firstBlendWeight(1.0f - percentageOfSecondPose);
-		ScalarRegister secondBlendWeight(percentageOfSecondPose);
-
-		firstBoneTransform = firstBoneTransform * firstBlendWeight;
-		firstBoneTransform.AccumulateWithShortestRotation(secondBoneTransform, secondBlendWeight);
+		// The edit holds onto the keyframe's pose while it's undone
+		if (undoing)
+		{
+			int32 keyFrameIndex = keyFrames.findKeyFrame(edit.keyFrameTime);
+			if (keyFrameIndex == INDEX_NONE)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Couldn't find the keyframe to undo!!!"));
+				break;
+			}
+			keyFrames.removeKeyFrame(keyFrameIndex, edit.removedKeyFramePose);
 
-		FBoneInfo newBonePose;
-		newBonePose.name = firstPoseBone.name;
-		newBonePose.position = firstBoneTransform.GetLocation();
-		newBonePose.rotation = FRotator(firstBoneTransform.GetRotation());
+			if (edit.appendedAnimationPose)
+			{
+				popAnimationPose();
+			}
+		}
+		else
+		{
+			if (edit.appendedAnimationPose)
+			{
+				appendAnimationPose(edit.removedKeyFramePose);
+			}
 
-		interpolatedPose.Add(newBonePose);
+			bool overwroteKeyFrame;
+			keyFrames.setKeyFrame(edit.keyFrameTime, MoveTemp(edit.removedKeyFramePose), overwroteKeyFrame);
+			posePool.release(MoveTemp(edit.removedKeyFramePose));
+		}
+		queueReplicatedKeyFrame(edit.keyFrameTime);
+		break;
 	}
 
-	return interpolatedPose;
-}
-
-bool APoseableActor::findPreviousAndNextKeyframes(float timeToCheck, FKeyFrame &previousKeyFrame, FKeyFrame &nextKeyFrame)
-{
-	if (keyFrames.Num() == 0)
+	case EPoseEditType::KeyFrameOverwritten:
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No keyframes saved!!!"));
-		return false;
-	}
-
-	FKeyFrame previousFrame = keyFrames[0];
-	FKeyFrame nextFrame;
-	nextFrame.keyFrameTime = 10000.0f;
+		int32 keyFrameIndex = keyFrames.findKeyFrame(edit.keyFrameTime);
+		if (keyFrameIndex == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Couldn't find the overwritten keyframe!!!"));
+			break;
+		}
 
-	for (int keyFrameIndex = 0; keyFrameIndex < keyFrames.Num(); keyFrameIndex++)
-	{
-		FKeyFrame *thisKeyFrame = &keyFrames[keyFrameIndex];
+		FPoseBuffer &keyFramePose = posePool.getFramePose(keyFrames.getKeyFrameNumBones(keyFrameIndex));
+		keyFrames.readKeyFramePose(keyFrameIndex, keyFramePose);
+		for (int32 editIndex = 0; editIndex < edit.boneIndices.Num(); editIndex++)
+		{
+			int32 boneIndex = edit.boneIndices[editIndex];
+			Swap(keyFramePose.rotations[boneIndex], edit.boneRotations[editIndex]);
+			Swap(keyFramePose.translations[boneIndex], edit.boneTranslations[editIndex]);
+		}
+		keyFrames.writeKeyFramePose(keyFrameIndex, keyFramePose);
+		queueReplicatedKeyFrame(edit.keyFrameTime);
 
-		if (thisKeyFrame->keyFrameTime >= currentAnimationTime)
+		if (edit.appendedAnimationPose)
 		{
-			if (nextFrame.keyFrameTime > thisKeyFrame->keyFrameTime)
+			if (undoing)
 			{
-				nextFrame = *thisKeyFrame;
+				popAnimationPose();
 			}
-		}
-		else if (thisKeyFrame->keyFrameTime < currentAnimationTime)
-		{
-			if (previousFrame.keyFrameTime < thisKeyFrame->keyFrameTime)
+			else
 			{
-				previousFrame = *thisKeyFrame;
+				appendAnimationPose(keyFramePose);
 			}
 		}
+		break;
 	}
+	}
+}
 
-	previousKeyFrame = previousFrame;
-	nextKeyFrame = nextFrame;
+///////////////////////////////////////////////////////////
+//////////////////    POSE LIBRARY    /////////////////////
+///////////////////////////////////////////////////////////
 
-	if (nextFrame.keyFrameTime == 10000.0f)
+int32 APoseableActor::addCurrentPoseToLibrary()
+{
+	boneHandles.readWorldPose(poseLibraryQuery);
+	return poseLibrary.addPose(poseLibraryQuery);
+}
+
+int32 APoseableActor::addAnimationToPoseLibrary(UAnimSequence *animation, float sampleInterval)
+{
+	USkeleton *skeleton = poseableMesh->SkeletalMesh->Skeleton;
+	if (animation == nullptr || animation->GetSkeleton() != skeleton)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Only animations of the posed skeleton can be added to the pose library!!!"));
+		return 0;
+	}
+
+	const int32 numBones = meshBoneInfo.Num();
+	const TArray<FTransform> &referencePose = skeleton->GetReferenceSkeleton().GetRefBonePose();
+	const FTransform componentToWorld = poseableMesh->GetComponentToWorld();
+
+	// Bones without a track stay in the reference pose
+	TArray<FTransform> boneTransforms;
+	boneTransforms.SetNumUninitialized(numBones);
+
+	const float interval = FMath::Max(sampleInterval, KINDA_SMALL_NUMBER);
+	int32 posesAdded = 0;
+	for (float sampleTime = 0.0f; sampleTime <= animation->SequenceLength; sampleTime += interval)
+	{
+		for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			boneTransforms[boneIndex] = referencePose[boneIndex];
+		}
+		for (int32 trackIndex = 0; trackIndex < animation->TrackToSkeletonMapTable.Num(); trackIndex++)
+		{
+			int32 boneIndex = animation->TrackToSkeletonMapTable[trackIndex].BoneTreeIndex;
+			if (boneIndex >= 0 && boneIndex < numBones)
+			{
+				animation->GetBoneTransform(boneTransforms[boneIndex], trackIndex, sampleTime, false);
+			}
+		}
+
+		// Parents always come before their children, so one pass turns the local transforms into world transforms
+		poseLibraryQuery.setNumBones(numBones);
+		for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			int32 parentIndex = meshBoneInfo[boneIndex].ParentIndex;
+			boneTransforms[boneIndex] = boneTransforms[boneIndex] * (parentIndex == INDEX_NONE ? componentToWorld : boneTransforms[parentIndex]);
+			poseLibraryQuery.rotations[boneIndex] = boneTransforms[boneIndex].GetRotation();
+			poseLibraryQuery.translations[boneIndex] = boneTransforms[boneIndex].GetLocation();
+		}
+
+		if (poseLibrary.addPose(poseLibraryQuery) != INDEX_NONE)
+		{
+			posesAdded++;
+		}
+	}
+
+	// Index the new poses now rather than on the first search
+	poseLibrary.build();
+	return posesAdded;
+}
+
+void APoseableActor::clearPoseLibrary()
+{
+	poseLibrary.empty();
+	nearestLibraryPoseIndex = INDEX_NONE;
+}
+
+void APoseableActor::setPoseLibraryBones(const TArray<FName> &boneNames)
+{
+	poseLibraryBones = boneNames;
+
+	TArray<int32> featureBones;
+	for (int boneNameIndex = 0; boneNameIndex < poseLibraryBones.Num(); boneNameIndex++)
+	{
+		int32 boneIndex = boneHandles.findBone(poseLibraryBones[boneNameIndex]);
+		if (boneIndex == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Pose library bone %s isn't in the skeleton"), *poseLibraryBones[boneNameIndex].ToString());
+			continue;
+		}
+		featureBones.Add(boneIndex);
+	}
+
+	poseLibrary.setFeatureBones(featureBones, rootBoneIndex);
+	nearestLibraryPoseIndex = INDEX_NONE;
+}
+
+bool APoseableActor::snapToNearestLibraryPose()
+{
+	boneHandles.readWorldPose(poseLibraryQuery);
+	poseLibrary.setMaxLeafChecks(poseLibraryMaxLeafChecks);
+	int32 libraryPoseIndex = poseLibrary.findNearestPose(poseLibraryQuery);
+	if (libraryPoseIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	beginBoneEdit();
+	applyLibraryPose(libraryPoseIndex);
+	finishBoneEditIfIdle();
+	return true;
+}
+
+int32 APoseableActor::getNearestLibraryPose() const
+{
+	return nearestLibraryPoseIndex;
+}
+
+///////////////////////////////////////////////////////////
+//////////////////    RETARGETING     /////////////////////
+///////////////////////////////////////////////////////////
+
+TSharedPtr<const FRetargetMap> APoseableActor::getRetargetMap(APoseableActor *sourceActor, FTransform &outPlacement, float &outSourceScale) const
+{
+	if (sourceActor == nullptr || sourceActor->poseableMesh == nullptr || poseableMesh == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Need two poseable actors that have begun play to retarget between!!!"));
+		return nullptr;
+	}
+
+	// The source's poses are in the world where the source stands, move them over to where this actor stands
+	outPlacement = sourceActor->poseableMesh->GetComponentToWorld().Inverse() * poseableMesh->GetComponentToWorld();
+	outSourceScale = sourceActor->poseableMesh->GetComponentToWorld().GetMaximumAxisScale();
+	return FRetargetMap::get(sourceActor->poseableMesh->SkeletalMesh->Skeleton, poseableMesh->SkeletalMesh->Skeleton);
+}
+
+bool APoseableActor::copyPoseFrom(APoseableActor *sourceActor)
+{
+	FTransform placement;
+	float sourceScale;
+	TSharedPtr<const FRetargetMap> retargetMap = getRetargetMap(sourceActor, placement, sourceScale);
+	if (!retargetMap.IsValid())
+	{
+		return false;
+	}
+
+	FPoseBuffer &sourcePose = posePool.getFramePose(sourceActor->boneHandles.numBones());
+	sourceActor->boneHandles.readWorldPose(sourcePose);
+
+	FPoseBuffer &retargetedPose = posePool.getFramePose(boneHandles.numBones());
+	retargetMap->retargetPose(sourcePose, placement, sourceScale, retargetedPose);
+
+	beginBoneEdit();
+	changeBoneState(retargetedPose);
+	finishBoneEditIfIdle();
+	return true;
+}
+
+bool APoseableActor::copyTimelineFrom(APoseableActor *sourceActor)
+{
+	FTransform placement;
+	float sourceScale;
+	TSharedPtr<const FRetargetMap> retargetMap = getRetargetMap(sourceActor, placement, sourceScale);
+	if (!retargetMap.IsValid() || sourceActor == this)
+	{
+		return false;
+	}
+
+	// Reading the source's keyframes is safe alongside its evaluation, which only reads them too
+	const FKeyframeTimeline &sourceKeyFrames = sourceActor->keyFrames;
+	const int32 numKeyFrames = sourceKeyFrames.numKeyFrames();
+
+	TArray<FPoseBuffer> sourcePoses;
+	TArray<const FPoseBuffer *> sourcePosePointers;
+	TArray<FPoseBuffer> retargetedPoses;
+	sourcePoses.SetNum(numKeyFrames);
+	sourcePosePointers.SetNumUninitialized(numKeyFrames);
+	retargetedPoses.SetNum(numKeyFrames);
+	for (int32 keyFrameIndex = 0; keyFrameIndex < numKeyFrames; keyFrameIndex++)
+	{
+		sourceKeyFrames.readKeyFramePose(keyFrameIndex, sourcePoses[keyFrameIndex]);
+		sourcePosePointers[keyFrameIndex] = &sourcePoses[keyFrameIndex];
+		retargetedPoses[keyFrameIndex] = posePool.acquire(boneHandles.numBones());
+	}
+
+	retargetMap->retargetPoses(sourcePosePointers.GetData(), numKeyFrames, placement, sourceScale, retargetedPoses.GetData());
+	sourcePoses.Empty();
+
+	clearTimeline(numKeyFrames, false);
+	for (int32 keyFrameIndex = 0; keyFrameIndex < numKeyFrames; keyFrameIndex++)
+	{
+		FPoseBuffer &pose = retargetedPoses[keyFrameIndex];
+		appendAnimationPose(pose);
+
+		bool overwroteKeyFrame;
+		keyFrames.setKeyFrame(sourceKeyFrames.getKeyFrameTime(keyFrameIndex), MoveTemp(pose), overwroteKeyFrame);
+		posePool.release(MoveTemp(pose));
+	}
+	queueReplicatedTimeline();
+
+	setCurrentAnimationTime(currentAnimationTime);
+	return true;
+}
+
+void APoseableActor::applyLibraryPose(int32 libraryPoseIndex)
+{
+	const FPoseBuffer &libraryPose = poseLibrary.getPose(libraryPoseIndex);
+
+	// The library pose may have been saved facing another way, so turn it to line its root up with the current one
+	FQuat facingCorrection = boneHandles.getBoneWorldRotation(rootBoneIndex) * libraryPose.rotations[rootBoneIndex].Inverse();
+
+	poseLibraryResult.setNumBones(libraryPose.numBones());
+	for (int32 boneIndex = 0; boneIndex < libraryPose.numBones(); boneIndex++)
+	{
+		poseLibraryResult.rotations[boneIndex] = facingCorrection * libraryPose.rotations[boneIndex];
+		poseLibraryResult.translations[boneIndex] = libraryPose.translations[boneIndex];
+	}
+
+	changeBoneState(poseLibraryResult);
+}
+
+///////////////////////////////////////////////////////////
+//////////////////       CONTROLS     /////////////////////
+///////////////////////////////////////////////////////////
+
+void APoseableActor::setSelectionSphere(UStaticMeshComponent *selectionSphereInput, bool leftHand)
+{
+	// Start the new sphere off with nothing selected, the next tick will pick up whatever it's touching
+	if (leftHand)
+	{
+		if (selectionSphereLeftHand != nullptr)
+		{
+			selectionSphereLeftHand->SetCustomDepthStencilValue(SELECTION_DEPTH);
+		}
+		selectionSphereLeftHand = selectionSphereInput;
+		overlappedBoneIndexLeftHand = INDEX_NONE;
+	}
+	else
+	{
+		if (selectionSphereRightHand != nullptr)
+		{
+			selectionSphereRightHand->SetCustomDepthStencilValue(SELECTION_DEPTH);
+		}
+		selectionSphereRightHand = selectionSphereInput;
+		overlappedBoneIndexRightHand = INDEX_NONE;
+		boneReferenceOverlappingRight = false;
+		setSelectedBone(INDEX_NONE);
+	}
+}
+
+void APoseableActor::gripPressed(UStaticMeshComponent *selectionSphere, bool leftHand)
+{
+	if (leftHand)
+	{
+		leftGripBeingPressed = true;
+		LeftHandSelectionSphere = selectionSphere;
+	}
+	else
+	{
+		rightGripBeingPressed = true;
+		rightHandSelectionSphere = selectionSphere;
+		rightHandInitialGripPosition = selectionSphere->GetComponentLocation();
+
+		if (!actorMoveInProgress)
+		{
+			actorMoveStartLocation = GetActorLocation();
+			actorMoveInProgress = true;
+		}
+	}
+
+	// If both grips are being pressed keep track of the vector between them to later rotate the poseable mesh
+	if (leftGripBeingPressed && rightGripBeingPressed)
+	{
+		initialGripVectorBetweenControllers = PoseMath::flattenHandsVector(rightHandSelectionSphere->GetComponentLocation() - LeftHandSelectionSphere->GetComponentLocation());
+		initialActorRotation = boneHandles.getBoneWorldRotation(rootBoneIndex);
+
+		beginBoneEdit();
+	}
+}
+
+void APoseableActor::gripReleased(bool leftHand)
+{
+	if (leftHand)
+	{
+		if (rightGripBeingPressed)
+		{
+			rightGripBeingPressed = false;
+		}
+		leftGripBeingPressed = false;
+	}
+	else
+	{
+		rightGripBeingPressed = false;
+	}
+
+	// Moving is done with the right grip, so the move is over once it's let go
+	if (actorMoveInProgress && !rightGripBeingPressed)
+	{
+		if (GetActorLocation() != actorMoveStartLocation)
+		{
+			poseHistory.recordActorMove(actorMoveStartLocation);
+		}
+		actorMoveInProgress = false;
+		replicationSettleRequested = true;
+	}
+
+	finishBoneEditIfIdle();
+}
+
+void APoseableActor::triggerPressed(UStaticMeshComponent *selectionSphere, bool leftHand)
+{
+	// If the left hand trigger is pressed, add a keyframe to the animation we will save out
+	if (leftHand)
+	{
+		POSECREATOR_SCOPE_TIMING(KeyFrameCapture);
+
+		FPoseBuffer keyFramePose = posePool.acquire(boneHandles.numBones());
+		boneHandles.readWorldPose(keyFramePose);
+		appendAnimationPose(keyFramePose);
+
+		timelineEvaluator.wait();
+
+		// Only the bones that differ from the old pose have to be remembered to undo an overwrite
+		int32 existingKeyFrameIndex = keyFrames.findKeyFrame(currentAnimationTime);
+		if (existingKeyFrameIndex != INDEX_NONE)
+		{
+			FPoseBuffer &existingPose = posePool.getFramePose(keyFrames.getKeyFrameNumBones(existingKeyFrameIndex));
+			keyFrames.readKeyFramePose(existingKeyFrameIndex, existingPose);
+			poseHistory.recordKeyFrameOverwritten(currentAnimationTime, existingPose, keyFramePose, true);
+		}
+
+		bool overwroteKeyFrame;
+		keyFrames.setKeyFrame(currentAnimationTime, MoveTemp(keyFramePose), overwroteKeyFrame);
+		posePool.release(MoveTemp(keyFramePose));
+		queueReplicatedKeyFrame(currentAnimationTime);
+
+		if (overwroteKeyFrame)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Overwriting other keyframe instead of adding a new one!!!"));
+		}
+		else
+		{
+			poseHistory.recordKeyFrameAdded(currentAnimationTime, true);
+		}
+		return;
+	}
+	// If the right trigger is pressed, check to see if a bone is selected and if so allow that bone to be rotated
+	else
+	{
+		rightTriggerBeingPressed = true;
+		rightHandSelectionSphere = selectionSphere;
+		trackpadRotation = 0.0f;
+
+		if (boneReferenceOverlappingRight)
+		{
+			FTransform parentBoneTransform = boneHandles.getBoneWorldTransform(overlappedBoneParentIndex);
+
+			startingLeftToRightVector = boneHandles.getBoneWorldLocation(overlappedBoneIndexRightHand) - parentBoneTransform.GetLocation();
+			startingLeftToRightVector.Normalize();
+
+			startingBoneRotation = parentBoneTransform.GetRotation();
+
+			// The chain is set up once per drag so its bone lengths aren't measured every frame
+			if (useIKDrag)
+			{
+				ikSolver.setChain(boneHandles, overlappedBoneIndexRightHand, ikChainLength);
+			}
+
+			beginBoneEdit();
+		}
+	}
+}
+
+void APoseableActor::triggerReleased(bool leftHand)
+{
+	if (leftHand)
+	{
+		return;
+	}
+	else
+	{
+		bool wasDraggingBone = rightTriggerBeingPressed && boneReferenceOverlappingRight;
+		rightTriggerBeingPressed = false;
+		ikSolver.clearChain();
+
+		trackpadRotation = 0.0f;
+
+		// Snapping happens before the drag's edit is recorded so undoing takes back both
+		if (wasDraggingBone && snapToLibraryOnRelease && nearestLibraryPoseIndex != INDEX_NONE)
+		{
+			applyLibraryPose(nearestLibraryPoseIndex);
+		}
+		nearestLibraryPoseIndex = INDEX_NONE;
+
+		if (selectionSphereRightHand != nullptr)
+		{
+			selectionSphereRightHand->SetCustomDepthStencilValue(SELECTION_DEPTH);
+		}
+		if (selectionSphereLeftHand != nullptr)
+		{
+			selectionSphereLeftHand->SetCustomDepthStencilValue(SELECTION_DEPTH);
+		}
+		setSelectedBone(INDEX_NONE);
+
+		// Forget what the hands were touching so the next tick selects again from scratch
+		overlappedBoneIndexLeftHand = INDEX_NONE;
+		overlappedBoneIndexRightHand = INDEX_NONE;
+		boneReferenceOverlappingRight = false;
+
+		finishBoneEditIfIdle();
+	}
+}
+
+void APoseableActor::rotateBoneAroundAxis(float rotationRadians)
+{
+	if (rightTriggerBeingPressed && boneReferenceOverlappingRight)
+	{
+		trackpadRotation += rotationRadians;
+	}
+}
+
+///////////////////////////////////////////////////////////
+//////////////////   SAVING ANIMATION  ////////////////////
+///////////////////////////////////////////////////////////
+
+void APoseableActor::saveCurrentPose()
+{
+	if (numAnimationPoses() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No animation poses recorded yet, can't save out an animation!!!"));
+		return;
+	}
+
+	if (animationExportInProgress)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Already saving out an animation, wait for it to finish!!!"));
+		return;
+	}
+
+	POSECREATOR_SCOPE_TIMING(ExportSnapshot);
+
+	// Copy out everything the export needs so posing can carry on while the animation is built
+	FAnimationExportSnapshot snapshot;
+	snapshot.skeleton = poseableMesh->SkeletalMesh->Skeleton;
+	snapshot.poses.SetNum(numAnimationPoses());
+	for (int32 animationPoseIndex = 0; animationPoseIndex < snapshot.poses.Num(); animationPoseIndex++)
+	{
+		readAnimationPose(animationPoseIndex, snapshot.poses[animationPoseIndex]);
+	}
+	snapshot.boneNames.SetNumUninitialized(meshBoneInfo.Num());
+	for (int boneIndex = 0; boneIndex < meshBoneInfo.Num(); boneIndex++)
+	{
+		snapshot.boneNames[boneIndex] = meshBoneInfo[boneIndex].Name;
+	}
+	boneHandles.readLocalScales(snapshot.boneScales);
+	snapshot.keyReduction.enabled = reduceExportedKeys;
+	snapshot.keyReduction.maxPositionError = exportPositionTolerance;
+	snapshot.keyReduction.maxAngleErrorDegrees = exportAngleToleranceDegrees;
+
+	animationExportInProgress = true;
+	AnimationExporter::exportAsync(MoveTemp(snapshot), FOnAnimationExported::CreateUObject(this, &APoseableActor::animationExported));
+}
+
+void APoseableActor::animationExported(UAnimSequence *exportedAnimation, const FKeyReductionStats &keyReductionStats)
+{
+	animationExportInProgress = false;
+
+	if (exportedAnimation != nullptr)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Saved %s: %d of %d keys kept (%.1fx), %d constant tracks, max error %.4f units / %.4f degrees"),
+			*exportedAnimation->GetName(), keyReductionStats.keptKeys, keyReductionStats.rawKeys, keyReductionStats.getCompressionRatio(),
+			keyReductionStats.constantTracks, keyReductionStats.maxPositionError, keyReductionStats.maxAngleErrorDegrees);
+	}
+
+	// Temporary includes to prevent the compiler from getting rid of the reference animation sequence
+	if (referenceAnimationSequence != nullptr)
+	{
+		referenceAnimationSequence->PostProcessSequence();
+		referenceAnimationSequence->MarkPackageDirty();
+	}
+
+	onAnimationSaved.Broadcast(exportedAnimation);
+}
+
+bool APoseableActor::saveTimeline(const FString &filePath)
+{
+	TArray<FName> boneNames;
+	boneNames.SetNumUninitialized(meshBoneInfo.Num());
+	for (int boneIndex = 0; boneIndex < meshBoneInfo.Num(); boneIndex++)
+	{
+		boneNames[boneIndex] = meshBoneInfo[boneIndex].Name;
+	}
+
+	return TimelineFile::save(filePath, boneNames, keyFrames);
+}
+
+bool APoseableActor::loadTimeline(const FString &filePath)
+{
+	FTimelineFileView timelineFile;
+	if (!timelineFile.open(filePath))
+	{
+		return false;
+	}
+
+	// Match the file's bones up with the skeleton once, bones the file doesn't have keep their current pose
+	TArray<int32> fileBoneIndices;
+	fileBoneIndices.SetNumUninitialized(meshBoneInfo.Num());
+	bool bonesMatch = timelineFile.numBones() == meshBoneInfo.Num();
+	for (int boneIndex = 0; boneIndex < meshBoneInfo.Num(); boneIndex++)
+	{
+		fileBoneIndices[boneIndex] = timelineFile.getBoneNames().Find(meshBoneInfo[boneIndex].Name);
+		bonesMatch &= fileBoneIndices[boneIndex] == boneIndex;
+	}
+
+	const FPoseBuffer &currentPose = saveCurrentBoneState(true);
+	clearTimeline(timelineFile.numKeyFrames(), false);
+
+	for (int32 keyFrameIndex = 0; keyFrameIndex < timelineFile.numKeyFrames(); keyFrameIndex++)
+	{
+		FPoseBuffer pose = posePool.acquire(meshBoneInfo.Num());
+		if (bonesMatch)
+		{
+			timelineFile.readPose(keyFrameIndex, pose);
+		}
+		else
+		{
+			const FQuat *fileRotations = timelineFile.getRotations(keyFrameIndex);
+			const FVector *fileTranslations = timelineFile.getTranslations(keyFrameIndex);
+
+			pose.copyFrom(currentPose);
+			for (int boneIndex = 0; boneIndex < meshBoneInfo.Num(); boneIndex++)
+			{
+				int32 fileBoneIndex = fileBoneIndices[boneIndex];
+				if (fileBoneIndex != INDEX_NONE)
+				{
+					pose.rotations[boneIndex] = fileRotations[fileBoneIndex];
+					pose.translations[boneIndex] = fileTranslations[fileBoneIndex];
+				}
+			}
+		}
+
+		// The loaded keyframes are also what gets saved out as an animation
+		appendAnimationPose(pose);
+
+		bool overwroteKeyFrame;
+		keyFrames.setKeyFrame(timelineFile.getKeyFrameTime(keyFrameIndex), MoveTemp(pose), overwroteKeyFrame);
+		posePool.release(MoveTemp(pose));
+	}
+
+	queueReplicatedTimeline();
+
+	if (!bonesMatch)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Timeline %s was saved from a different skeleton, bones were matched up by name"), *filePath);
+	}
+
+	setCurrentAnimationTime(currentAnimationTime);
+	return true;
+}
+
+///////////////////////////////////////////////////////////
+//////////////////    REPLICATION     /////////////////////
+///////////////////////////////////////////////////////////
+
+bool APoseableActor::isReplicatingEdits() const
+{
+	return GetNetMode() != NM_Standalone && poseableMesh != nullptr;
+}
+
+int32 APoseableActor::getLocalPlayerId() const
+{
+	APlayerController *localController = GEngine->GetFirstLocalPlayerController(GetWorld());
+	return localController != nullptr && localController->PlayerState != nullptr ? localController->PlayerState->PlayerId : INDEX_NONE;
+}
+
+void APoseableActor::replicateEdits()
+{
+	// Nobody poses on a dedicated server, it only passes edits along
+	if (!isReplicatingEdits() || GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	// Bones stream out while they're being edited, then everything left over goes out reliably once the edit's done
+	if (boneEditInProgress || actorMoveInProgress)
+	{
+		FPoseDeltaPacket packet;
+		if (poseReplicator.buildDelta(saveCurrentBoneState(false), GetActorLocation(), FMath::DegreesToRadians(replicationAngleThresholdDegrees), packet))
+		{
+			sendBonePacket(packet, false);
+		}
+	}
+	else if (replicationSettleRequested)
+	{
+		replicationSettleRequested = false;
+
+		FPoseDeltaPacket packet;
+		if (poseReplicator.buildSettle(saveCurrentBoneState(false), GetActorLocation(), packet))
+		{
+			sendBonePacket(packet, true);
+		}
+	}
+
+	if (!poseReplicator.hasQueuedKeyFrames())
+	{
+		return;
+	}
+
+	FPoseKeyFramePacket packet;
+	const int32 keyFramePacketSize = 12 + boneHandles.numBones() * 12;
+	float keyFrameTime;
+	bool replacesTimeline;
+	while (poseReplicator.popQueuedKeyFrame(keyFramePacketSize, keyFrameTime, replacesTimeline))
+	{
+		// A keyframe that's gone by the time it's sent was removed, which has to be sent too
+		int32 keyFrameIndex = keyFrames.findKeyFrame(keyFrameTime);
+		if (!buildKeyFramePacket(keyFrameIndex, packet))
+		{
+			packet.rotations.Reset();
+			packet.translations.Reset();
+			packet.keyFrameTime = keyFrameTime;
+			packet.removed = true;
+		}
+		packet.replacesTimeline = replacesTimeline;
+		sendKeyFramePacket(packet);
+	}
+}
+
+void APoseableActor::sendBonePacket(FPoseDeltaPacket &packet, bool reliable)
+{
+	INC_DWORD_STAT_BY(STAT_PoseCreator_ReplicatedBytes, packet.getEstimatedSize());
+
+	if (HasAuthority())
+	{
+		packet.senderId = getLocalPlayerId();
+		if (reliable)
+		{
+			multicastBoneSettle(packet);
+		}
+		else
+		{
+			multicastBoneDelta(packet);
+		}
+		return;
+	}
+
+	UPoseReplicationComponent *replication = UPoseReplicationComponent::getLocal(GetWorld());
+	if (replication == nullptr)
+	{
+		return;
+	}
+
+	if (reliable)
+	{
+		replication->serverSendBoneSettle(this, packet);
+	}
+	else
+	{
+		replication->serverSendBoneDelta(this, packet);
+	}
+}
+
+void APoseableActor::sendKeyFramePacket(FPoseKeyFramePacket &packet)
+{
+	INC_DWORD_STAT_BY(STAT_PoseCreator_ReplicatedBytes, packet.getEstimatedSize());
+
+	if (HasAuthority())
 	{
+		packet.senderId = getLocalPlayerId();
+		multicastKeyFrame(packet);
+		return;
+	}
+
+	UPoseReplicationComponent *replication = UPoseReplicationComponent::getLocal(GetWorld());
+	if (replication != nullptr)
+	{
+		replication->serverSendKeyFrame(this, packet);
+	}
+}
+
+void APoseableActor::queueReplicatedKeyFrame(float keyFrameTime)
+{
+	if (isReplicatingEdits())
+	{
+		poseReplicator.queueKeyFrame(keyFrameTime);
+	}
+}
+
+void APoseableActor::queueReplicatedTimeline()
+{
+	if (!isReplicatingEdits())
+	{
+		return;
+	}
+
+	poseReplicator.queueTimelineReplaced();
+	for (int32 keyFrameIndex = 0; keyFrameIndex < keyFrames.numKeyFrames(); keyFrameIndex++)
+	{
+		poseReplicator.queueKeyFrame(keyFrames.getKeyFrameTime(keyFrameIndex));
+	}
+}
+
+void APoseableActor::multicastBoneDelta_Implementation(const FPoseDeltaPacket &packet)
+{
+	if (packet.senderId == INDEX_NONE || packet.senderId != getLocalPlayerId())
+	{
+		receiveBoneDelta(packet);
+	}
+}
+
+void APoseableActor::multicastBoneSettle_Implementation(const FPoseDeltaPacket &packet)
+{
+	if (packet.senderId == INDEX_NONE || packet.senderId != getLocalPlayerId())
+	{
+		receiveBoneDelta(packet);
+	}
+}
+
+void APoseableActor::multicastKeyFrame_Implementation(const FPoseKeyFramePacket &packet)
+{
+	if (packet.senderId == INDEX_NONE || packet.senderId != getLocalPlayerId())
+	{
+		receiveKeyFrame(packet);
+	}
+}
+
+void APoseableActor::receiveBoneDelta(const FPoseDeltaPacket &packet)
+{
+	// Packets can arrive before BeginPlay has found the mesh
+	if (poseableMesh == nullptr)
+	{
+		return;
+	}
+
+	for (int32 packetIndex = 0; packetIndex < packet.boneIndices.Num(); packetIndex++)
+	{
+		int32 boneIndex = packet.boneIndices[packetIndex];
+		if (boneIndex >= boneHandles.numBones())
+		{
+			continue;
+		}
+
+		FQuat rotation = PoseQuantization::dequantizeRotation(packet.rotations[packetIndex]);
+		boneHandles.setBoneLocalRotation(boneIndex, rotation);
+		poseReplicator.noteReceived(boneIndex, rotation);
+	}
+
+	if (packet.hasActorLocation)
+	{
+		SetActorLocation(packet.actorLocation);
+		poseReplicator.noteReceivedActorLocation(packet.actorLocation);
+	}
+}
+
+void APoseableActor::receiveKeyFrame(const FPoseKeyFramePacket &packet)
+{
+	if (poseableMesh == nullptr)
+	{
+		return;
+	}
+
+	if (!packet.removed && (packet.rotations.Num() != boneHandles.numBones() || packet.translations.Num() != boneHandles.numBones()))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Received a keyframe for a skeleton with a different number of bones!!!"));
+		return;
+	}
+
+	// Animation poses are the captures this player saves out, other players' keyframes only change the timeline
+	if (packet.replacesTimeline)
+	{
+		clearTimeline(packet.removed ? 0 : 1, true);
+	}
+	else
+	{
+		timelineEvaluator.wait();
+	}
+
+	if (packet.removed)
+	{
+		int32 keyFrameIndex = keyFrames.findKeyFrame(packet.keyFrameTime);
+		if (keyFrameIndex != INDEX_NONE)
+		{
+			FPoseBuffer removedPose = posePool.acquire(keyFrames.getKeyFrameNumBones(keyFrameIndex));
+			keyFrames.removeKeyFrame(keyFrameIndex, removedPose);
+			posePool.release(MoveTemp(removedPose));
+		}
+	}
+	else
+	{
+		// Keyframes are sent in component space, put them back in the world wherever this actor stands
+		const FTransform componentToWorld = poseableMesh->GetComponentToWorld();
+		const FQuat componentRotation = componentToWorld.GetRotation();
+
+		FPoseBuffer pose = posePool.acquire(boneHandles.numBones());
+		for (int32 boneIndex = 0; boneIndex < pose.numBones(); boneIndex++)
+		{
+			pose.rotations[boneIndex] = componentRotation * PoseQuantization::dequantizeRotation(packet.rotations[boneIndex]);
+			pose.translations[boneIndex] = componentToWorld.TransformPosition(PoseQuantization::dequantizeTranslation(packet.translations[boneIndex], keyFrameTranslationRange));
+		}
+
+		bool overwroteKeyFrame;
+		keyFrames.setKeyFrame(packet.keyFrameTime, MoveTemp(pose), overwroteKeyFrame);
+		posePool.release(MoveTemp(pose));
+	}
+
+	timelineEvaluationRequested = true;
+}
+
+bool APoseableActor::buildPosePacket(FPoseDeltaPacket &outPacket)
+{
+	if (poseableMesh == nullptr)
+	{
+		return false;
+	}
+
+	const FPoseBuffer &localPose = saveCurrentBoneState(false);
+	outPacket.boneIndices.SetNumUninitialized(localPose.numBones());
+	outPacket.rotations.SetNumUninitialized(localPose.numBones());
+	for (int32 boneIndex = 0; boneIndex < localPose.numBones(); boneIndex++)
+	{
+		outPacket.boneIndices[boneIndex] = (uint16)boneIndex;
+		outPacket.rotations[boneIndex] = PoseQuantization::quantizeRotation(localPose.rotations[boneIndex]);
+	}
+	outPacket.hasActorLocation = true;
+	outPacket.actorLocation = GetActorLocation();
+	return true;
+}
+
+bool APoseableActor::buildKeyFramePacket(int32 keyFrameIndex, FPoseKeyFramePacket &outPacket)
+{
+	if (poseableMesh == nullptr || keyFrameIndex < 0 || keyFrameIndex >= keyFrames.numKeyFrames())
+	{
+		return false;
+	}
+
+	FPoseBuffer &pose = posePool.getFramePose(keyFrames.getKeyFrameNumBones(keyFrameIndex));
+	keyFrames.readKeyFramePose(keyFrameIndex, pose);
+
+	// Keyframes are stored in world space, they're sent in component space so they don't depend on where anyone stands
+	const FTransform worldToComponent = poseableMesh->GetComponentToWorld().Inverse();
+	const FQuat inverseComponentRotation = worldToComponent.GetRotation();
+
+	outPacket.keyFrameTime = keyFrames.getKeyFrameTime(keyFrameIndex);
+	outPacket.removed = false;
+	outPacket.replacesTimeline = false;
+	outPacket.rotations.SetNumUninitialized(pose.numBones());
+	outPacket.translations.SetNumUninitialized(pose.numBones());
+	for (int32 boneIndex = 0; boneIndex < pose.numBones(); boneIndex++)
+	{
+		outPacket.rotations[boneIndex] = PoseQuantization::quantizeRotation(inverseComponentRotation * pose.rotations[boneIndex]);
+		outPacket.translations[boneIndex] = PoseQuantization::quantizeTranslation(worldToComponent.TransformPosition(pose.translations[boneIndex]), keyFrameTranslationRange);
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////
+//////////////////     MIRRORING      /////////////////////
+///////////////////////////////////////////////////////////
+
+void APoseableActor::mirrorCurrentPose()
+{
+	FPoseBuffer &pose = saveCurrentBoneState(true);
+	mirrorTable.mirrorPose(pose, poseableMesh->GetComponentToWorld());
+
+	beginBoneEdit();
+	changeBoneState(pose);
+	finishBoneEditIfIdle();
+}
+
+bool APoseableActor::mirrorCurrentKeyFrame()
+{
+	timelineEvaluator.wait();
+
+	int32 keyFrameIndex = keyFrames.findKeyFrame(currentAnimationTime);
+	if (keyFrameIndex == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No keyframe at the current time to mirror!!!"));
 		return false;
 	}
+
+	// Recorded like any other overwrite of the keyframe so it can be undone
+	FPoseBuffer &keyFramePose = posePool.getFramePose(keyFrames.getKeyFrameNumBones(keyFrameIndex));
+	keyFrames.readKeyFramePose(keyFrameIndex, keyFramePose);
+	FPoseBuffer &mirroredPose = posePool.getFramePose(keyFramePose.numBones());
+	mirroredPose.copyFrom(keyFramePose);
+	mirrorTable.mirrorPose(mirroredPose, poseableMesh->GetComponentToWorld());
+
+	poseHistory.recordKeyFrameOverwritten(currentAnimationTime, keyFramePose, mirroredPose, true);
+	keyFrames.writeKeyFramePose(keyFrameIndex, mirroredPose);
+	appendAnimationPose(mirroredPose);
+	queueReplicatedKeyFrame(currentAnimationTime);
+
+	timelineEvaluationRequested = true;
+	return true;
+}
+
+void APoseableActor::mirrorAllKeyFrames()
+{
+	// The history's keyframe edits are diffs against the poses about to change
+	poseHistory.empty();
+	timelineEvaluator.wait();
+
+	// The keyframes then the animation poses, a batch at a time so quantized ones are never all unpacked at once
+	const int32 numKeyFramePoses = keyFrames.numKeyFrames();
+	const int32 numPoses = numKeyFramePoses + numAnimationPoses();
+	const FTransform componentToWorld = poseableMesh->GetComponentToWorld();
+
+	TArray<FPoseBuffer> batchPoses;
+	TArray<FPoseBuffer *> batchPosePointers;
+	batchPoses.SetNum(FMath::Min(numPoses, MIRROR_BATCH_POSES));
+	batchPosePointers.SetNumUninitialized(batchPoses.Num());
+	for (int32 batchIndex = 0; batchIndex < batchPoses.Num(); batchIndex++)
+	{
+		batchPosePointers[batchIndex] = &batchPoses[batchIndex];
+	}
+
+	for (int32 batchStart = 0; batchStart < numPoses; batchStart += MIRROR_BATCH_POSES)
+	{
+		const int32 batchSize = FMath::Min(numPoses - batchStart, MIRROR_BATCH_POSES);
+		for (int32 batchIndex = 0; batchIndex < batchSize; batchIndex++)
+		{
+			int32 poseIndex = batchStart + batchIndex;
+			if (poseIndex < numKeyFramePoses)
+			{
+				keyFrames.readKeyFramePose(poseIndex, batchPoses[batchIndex]);
+			}
+			else
+			{
+				readAnimationPose(poseIndex - numKeyFramePoses, batchPoses[batchIndex]);
+			}
+		}
+
+		mirrorTable.mirrorPoses(batchPosePointers.GetData(), batchSize, componentToWorld);
+
+		for (int32 batchIndex = 0; batchIndex < batchSize; batchIndex++)
+		{
+			int32 poseIndex = batchStart + batchIndex;
+			if (poseIndex < numKeyFramePoses)
+			{
+				keyFrames.writeKeyFramePose(poseIndex, batchPoses[batchIndex]);
+			}
+			else
+			{
+				writeAnimationPose(poseIndex - numKeyFramePoses, batchPoses[batchIndex]);
+			}
+		}
+	}
+
+	queueReplicatedTimeline();
+
+	timelineEvaluationRequested = true;
+}
+
+void APoseableActor::clearTimeline(int32 numKeyFramesToReserve, bool keepAnimationPoses)
+{
+	// Edits to the old keyframes don't mean anything for the new ones
+	poseHistory.empty();
+	timelineEvaluator.wait();
+
+	keyFrames.empty([this](FPoseBuffer &&pose) { posePool.release(MoveTemp(pose)); },
+		[this](FQuantizedPose &&quantizedPose) { posePool.release(MoveTemp(quantizedPose)); });
+	keyFrames.reserve(numKeyFramesToReserve);
+	if (keepAnimationPoses)
+	{
+		return;
+	}
+
+	while (numAnimationPoses() > 0)
+	{
+		popAnimationPose();
+	}
+	if (keyFrames.getStorage() == EKeyFrameStorage::Quantized)
+	{
+		quantizedAnimationPoses.Reserve(numKeyFramesToReserve);
+	}
+	else
+	{
+		animationPoses.Reserve(numKeyFramesToReserve);
+	}
+}
+
+FPoseBuffer &APoseableActor::saveCurrentBoneState(bool worldSpace)
+{
+	FPoseBuffer &savedPose = posePool.getFramePose(boneHandles.numBones());
+
+	if (worldSpace)
+	{
+		boneHandles.readWorldPose(savedPose);
+	}
+	else
+	{
+		boneHandles.readLocalPose(savedPose);
+	}
+
+	return savedPose;
+}
+
+void APoseableActor::appendAnimationPose(const FPoseBuffer &pose)
+{
+	if (keyFrames.getStorage() == EKeyFrameStorage::Quantized)
+	{
+		FQuantizedPose &animationPose = quantizedAnimationPoses[quantizedAnimationPoses.Add(posePool.acquireQuantized(pose.numBones(), keyFrameFormat))];
+		PoseQuantization::quantizePose(pose, keyFrameFormat, animationPose);
+		return;
+	}
+
+	FPoseBuffer &animationPose = animationPoses[animationPoses.Add(posePool.acquire(pose.numBones()))];
+	animationPose.copyFrom(pose);
+}
+
+void APoseableActor::popAnimationPose()
+{
+	if (quantizedAnimationPoses.Num() > 0)
+	{
+		posePool.release(quantizedAnimationPoses.Pop(false));
+	}
+	else if (animationPoses.Num() > 0)
+	{
+		posePool.release(animationPoses.Pop(false));
+	}
+}
+
+int32 APoseableActor::numAnimationPoses() const
+{
+	return animationPoses.Num() + quantizedAnimationPoses.Num();
+}
+
+void APoseableActor::readAnimationPose(int32 animationPoseIndex, FPoseBuffer &outPose) const
+{
+	if (keyFrames.getStorage() == EKeyFrameStorage::Quantized)
+	{
+		PoseQuantization::dequantizePose(quantizedAnimationPoses[animationPoseIndex], keyFrameFormat, outPose);
+	}
+	else
+	{
+		outPose.copyFrom(animationPoses[animationPoseIndex]);
+	}
+}
+
+void APoseableActor::writeAnimationPose(int32 animationPoseIndex, const FPoseBuffer &pose)
+{
+	if (keyFrames.getStorage() == EKeyFrameStorage::Quantized)
+	{
+		PoseQuantization::quantizePose(pose, keyFrameFormat, quantizedAnimationPoses[animationPoseIndex]);
+	}
 	else
 	{
-		return true;
+		animationPoses[animationPoseIndex].copyFrom(pose);
+	}
+}
+
+bool APoseableActor::setQuantizedKeyFrames(bool quantize)
+{
+	quantizeKeyFrames = quantize;
+
+	// BeginPlay applies the setting once there's a mesh to work the range out from
+	if (poseableMesh == nullptr)
+	{
+		return false;
+	}
+
+	// Bones stay well within twice the mesh's bounds of the first bone however they're posed
+	const FBoxSphereBounds meshBounds = poseableMesh->SkeletalMesh->GetImportedBounds();
+	const float offsetReach = (meshBounds.Origin.Size() + meshBounds.SphereRadius * 2.0f) * poseableMesh->GetComponentScale().GetAbsMax();
+	const FBox offsetBounds(FVector(-offsetReach), FVector(offsetReach));
+
+	// The fewest bits that keep keyed bones within the precision, or full precision if even the most bits can't
+	EKeyFrameStorage storage = EKeyFrameStorage::Full;
+	FPoseQuantizationFormat format;
+	if (quantize)
+	{
+		if (FPoseQuantizationFormat::findFormat(offsetBounds, keyFramePositionPrecision, FMath::DegreesToRadians(keyFrameAnglePrecisionDegrees), format))
+		{
+			storage = EKeyFrameStorage::Quantized;
+			UE_LOG(LogTemp, Log, TEXT("Quantizing keyframes with %d bit rotations and %d bit translations, %d bits a bone"),
+				format.rotationBits, format.offsetRange.bits, format.getBitsPerBone());
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Quantized keyframes can be off by up to %.4f units and %.4f degrees, keeping them at full precision!!!"),
+				format.offsetRange.getMaxError(), FMath::RadiansToDegrees(PoseQuantization::getMaxRotationError(format.rotationBits)));
+		}
+	}
+
+	auto getPoseMemory = [this]()
+	{
+		SIZE_T poseMemory = keyFrames.getAllocatedSize() + animationPoses.GetAllocatedSize() + quantizedAnimationPoses.GetAllocatedSize();
+		for (const FPoseBuffer &animationPose : animationPoses)
+		{
+			poseMemory += animationPose.getAllocatedSize();
+		}
+		for (const FQuantizedPose &quantizedPose : quantizedAnimationPoses)
+		{
+			poseMemory += quantizedPose.getAllocatedSize();
+		}
+		return poseMemory;
+	};
+
+	// Repacking changes the keyframes under the evaluation
+	timelineEvaluator.wait();
+	const SIZE_T previousPoseMemory = getPoseMemory();
+
+	// Animation poses are unpacked with the range they were packed with, then repacked like the keyframes
+	if (keyFrames.getStorage() == EKeyFrameStorage::Quantized)
+	{
+		for (const FQuantizedPose &quantizedPose : quantizedAnimationPoses)
+		{
+			FPoseBuffer &animationPose = animationPoses[animationPoses.Add(posePool.acquire(quantizedPose.numBones()))];
+			PoseQuantization::dequantizePose(quantizedPose, keyFrameFormat, animationPose);
+		}
+		while (quantizedAnimationPoses.Num() > 0)
+		{
+			posePool.release(quantizedAnimationPoses.Pop(false));
+		}
+		quantizedAnimationPoses.Empty();
+	}
+
+	keyFrames.setStorage(storage, format);
+	keyFrameFormat = format;
+
+	if (storage == EKeyFrameStorage::Quantized)
+	{
+		quantizedAnimationPoses.Reserve(animationPoses.Num());
+		for (const FPoseBuffer &animationPose : animationPoses)
+		{
+			FQuantizedPose &quantizedPose = quantizedAnimationPoses[quantizedAnimationPoses.Add(posePool.acquireQuantized(animationPose.numBones(), keyFrameFormat))];
+			PoseQuantization::quantizePose(animationPose, keyFrameFormat, quantizedPose);
+		}
+		while (animationPoses.Num() > 0)
+		{
+			posePool.release(animationPoses.Pop(false));
+		}
+		animationPoses.Empty();
+	}
+
+	if (keyFrames.numKeyFrames() > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Keyframes and animation poses went from %.1f KB to %.1f KB"), previousPoseMemory / 1024.0f, getPoseMemory() / 1024.0f);
+		timelineEvaluationRequested = true;
+	}
+
+	return storage == EKeyFrameStorage::Quantized;
+}
+
+///////////////////////////////////////////////////////////
+////////////////// ANIMATION UTILITIES ////////////////////
+///////////////////////////////////////////////////////////
+
+void APoseableActor::changeBoneState(const FPoseBuffer &newPose)
+{
+	boneHandles.applyWorldRotations(newPose);
+}
+
+void APoseableActor::setCurrentAnimationTime(float newAnimationTime)
+{
+	currentAnimationTime = newAnimationTime;
+
+	// The timeline can hold other players' keyframes without this player having captured anything
+	if (keyFrames.numKeyFrames() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No keyframes saved!!!"));
+		return;
 	}
-}
\ No newline at end of file
+
+	// The pose is evaluated off the game thread during the next tick
+	timelineEvaluationRequested = true;
+}
+
+void APoseableActor::setSplineInterpolation(bool useSplines)
+{
+	splineInterpolation = useSplines;
+
+	// Switching works out tangents on the keyframes, so the worker can't be reading them
+	timelineEvaluator.wait();
+	keyFrames.setInterpolation(useSplines ? ETimelineInterpolation::Spline : ETimelineInterpolation::Linear);
+	timelineEvaluationRequested = true;
+}
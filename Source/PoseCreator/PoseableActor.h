@@ -4,9 +4,47 @@
 
 #include "GameFramework/Actor.h"
 #include "Components/PoseableMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
 #include "DataStructures.h"
+#include "KeyframeTimeline.h"
+#include "PoseableBoneHandles.h"
+#include "BonePicker.h"
+#include "AnimationExporter.h"
+#include "PoseHistory.h"
+#include "PoseLibrary.h"
+#include "TimelineEvaluator.h"
+#include "IKChainSolver.h"
+#include "PosePool.h"
+#include "RetargetMap.h"
+#include "MirrorTable.h"
+#include "PoseReplication.h"
 #include "PoseableActor.generated.h"
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPoseAnimationSaved, UAnimSequence *, savedAnimation);
+
+class APoseableActor;
+
+// Picks up the timeline pose a poseable actor kicked off in its tick and applies it before the frame is rendered
+USTRUCT()
+struct FPoseableActorApplyPoseTickFunction : public FTickFunction
+{
+	GENERATED_USTRUCT_BODY()
+
+	APoseableActor *target;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef &MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FPoseableActorApplyPoseTickFunction> : public TStructOpsTypeTraitsBase2<FPoseableActorApplyPoseTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
 UCLASS()
 class POSECREATOR_API APoseableActor : public AActor
 {
@@ -20,16 +58,30 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Posing")
 	void resetSkeleton();
 
-	// Save out the current pose to an animation sequence
+	// Save out the recorded poses to an animation sequence, the work happens in the background and onAnimationSaved is
+	// called once the asset has been created
 	UFUNCTION(BlueprintCallable, Category = "Posing")
 	void saveCurrentPose();
 
-	// Overlapping bone callbacks
-	UFUNCTION(BlueprintCallable, Category = "Posing")
-	void overlapBoneReference(UStaticMeshComponent *overlappedBoneInput, UStaticMeshComponent *selectionSphereInput, bool leftHand);
+	// Called when saveCurrentPose has finished, the animation is null if it couldn't be created
+	UPROPERTY(BlueprintAssignable, Category = "Posing")
+	FOnPoseAnimationSaved onAnimationSaved;
+
+	// Whether saved animations drop keys that can be rebuilt from their neighbours within the tolerances below
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Export")
+	bool reduceExportedKeys;
+
+	// How far a bone may move from its recorded position when keys are removed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Export")
+	float exportPositionTolerance;
+
+	// How far a bone may rotate from its recorded rotation when keys are removed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Export")
+	float exportAngleToleranceDegrees;
 
+	// Register the selection sphere of a hand, bones within reach of the sphere get selected every frame
 	UFUNCTION(BlueprintCallable, Category = "Posing")
-	void endOverlapBoneReference(UStaticMeshComponent *overlappedBoneInput, UStaticMeshComponent *selectionSphereInput, bool leftHand);
+	void setSelectionSphere(UStaticMeshComponent *selectionSphereInput, bool leftHand);
 
 	// Input button callbacks
 	UFUNCTION(BlueprintCallable, Category = "Posing")
@@ -50,6 +102,144 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Posing")
 	void setCurrentAnimationTime(float newAnimationTime);
 
+	// Switch playback between blending neighbouring keyframes and a smooth spline through all of them
+	UFUNCTION(BlueprintCallable, Category = "Posing")
+	void setSplineInterpolation(bool useSplines);
+
+	// Save the keyframes out to a timeline file so they can be edited again later
+	UFUNCTION(BlueprintCallable, Category = "Posing")
+	bool saveTimeline(const FString &filePath);
+
+	// Replace the keyframes with the ones in a timeline file
+	UFUNCTION(BlueprintCallable, Category = "Posing")
+	bool loadTimeline(const FString &filePath);
+
+	// Undo the latest bone, move or keyframe edit
+	UFUNCTION(BlueprintCallable, Category = "Posing|History")
+	bool undo();
+
+	// Redo the latest undone edit
+	UFUNCTION(BlueprintCallable, Category = "Posing|History")
+	bool redo();
+
+	UFUNCTION(BlueprintPure, Category = "Posing|History")
+	bool canUndo() const;
+
+	UFUNCTION(BlueprintPure, Category = "Posing|History")
+	bool canRedo() const;
+
+	// How much memory the undo history can use before the oldest edits get merged or dropped
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Posing|History", meta = (ClampMin = "1"))
+	int32 undoHistoryBudgetMB;
+
+	// Store the current pose in the pose library, returns its index in the library
+	UFUNCTION(BlueprintCallable, Category = "Posing|Library")
+	int32 addCurrentPoseToLibrary();
+
+	// Sample an animation of this skeleton into the pose library, returns how many poses were added
+	UFUNCTION(BlueprintCallable, Category = "Posing|Library")
+	int32 addAnimationToPoseLibrary(UAnimSequence *animation, float sampleInterval = 0.0333f);
+
+	UFUNCTION(BlueprintCallable, Category = "Posing|Library")
+	void clearPoseLibrary();
+
+	// Change which bones library poses are compared by, an empty list compares every bone
+	UFUNCTION(BlueprintCallable, Category = "Posing|Library")
+	void setPoseLibraryBones(const TArray<FName> &boneNames);
+
+	// Snap the skeleton to the library pose closest to the current one, this can be undone like any other bone edit
+	UFUNCTION(BlueprintCallable, Category = "Posing|Library")
+	bool snapToNearestLibraryPose();
+
+	// The library pose closest to the skeleton while a bone is being dragged, INDEX_NONE if there isn't one
+	UFUNCTION(BlueprintPure, Category = "Posing|Library")
+	int32 getNearestLibraryPose() const;
+
+	// Pose the skeleton like another poseable actor, which may have a different skeleton. Can be undone like any other
+	// bone edit.
+	UFUNCTION(BlueprintCallable, Category = "Posing|Retargeting")
+	bool copyPoseFrom(APoseableActor *sourceActor);
+
+	// Replace the keyframes with another poseable actor's, retargeted onto this skeleton
+	UFUNCTION(BlueprintCallable, Category = "Posing|Retargeting")
+	bool copyTimelineFrom(APoseableActor *sourceActor);
+
+	// Mirror the skeleton's pose left to right, this can be undone like any other bone edit
+	UFUNCTION(BlueprintCallable, Category = "Posing|Mirroring")
+	void mirrorCurrentPose();
+
+	// Mirror the keyframe at the current animation time, returns false if there isn't one there
+	UFUNCTION(BlueprintCallable, Category = "Posing|Mirroring")
+	bool mirrorCurrentKeyFrame();
+
+	// Mirror every keyframe, mirroring them again puts them back. Clears the undo history.
+	UFUNCTION(BlueprintCallable, Category = "Posing|Mirroring")
+	void mirrorAllKeyFrames();
+
+	// The component space axis that points from one side of the skeleton to the other
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Posing|Mirroring")
+	TEnumAsByte<EAxis::Type> mirrorAxis;
+
+	// Bone pairs to mirror onto each other regardless of what their names say
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Posing|Mirroring")
+	TMap<FName, FName> mirrorBoneOverrides;
+
+	// Whether letting go of a dragged bone snaps the skeleton to the closest library pose
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Library")
+	bool snapToLibraryOnRelease;
+
+	// The bones library poses are compared by, every bone if this is empty
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Posing|Library")
+	TArray<FName> poseLibraryBones;
+
+	// How many groups of library poses a search can look at before settling for the best one so far, zero is exact
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Library", meta = (ClampMin = "0"))
+	int32 poseLibraryMaxLeafChecks;
+
+	// Whether dragging a bone moves it as the end of an IK chain instead of only rotating its parent
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|IK")
+	bool useIKDrag;
+
+	// How many bones above the dragged bone the IK chain reaches
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|IK", meta = (ClampMin = "1"))
+	int32 ikChainLength;
+
+	// The solve stops once the dragged bone is this close to the controller
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|IK", meta = (ClampMin = "0"))
+	float ikTolerance;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|IK", meta = (ClampMin = "1"))
+	int32 ikMaxIterations;
+
+	// How long the solve can take each frame
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|IK", meta = (ClampMin = "0"))
+	float ikTimeBudgetMilliseconds;
+
+	// How far each joint of the chain can bend away from the bone before it
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|IK", meta = (ClampMin = "0", ClampMax = "180"))
+	float ikMaxJointBendDegrees;
+
+	// Keep the keyframes and recorded animation poses bit packed, with the fewest bits that hold them to the precision
+	// below. Returns whether they ended up quantized, they stay at full precision if even the most bits can't.
+	UFUNCTION(BlueprintCallable, Category = "Posing|Memory")
+	bool setQuantizedKeyFrames(bool quantize);
+
+	// Whether keyframes are kept quantized
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Posing|Memory")
+	bool quantizeKeyFrames;
+
+	// How far quantizing may move a keyed bone, the translation bits are picked to promise this
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Memory", meta = (ClampMin = "0"))
+	float keyFramePositionPrecision;
+
+	// How far quantizing may turn a keyed bone, the rotation bits are picked to promise this
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Memory", meta = (ClampMin = "0"))
+	float keyFrameAnglePrecisionDegrees;
+
+	// Whether playback follows a spline through the keyframes instead of blending straight from one to the next
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Posing")
+	bool splineInterpolation;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing")
 	UAnimSequence *referenceAnimationSequence;
 
@@ -59,27 +249,187 @@ public:
 	// Called every frame
 	virtual void Tick( float DeltaSeconds ) override;
 
-private:
-	// Find the two keyframes that correspond to the inputted time
-	bool findPreviousAndNextKeyframes(float timeToCheck, FKeyFrame &previousKeyFrame, FKeyFrame &nextKeyFrame);
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void RegisterActorTickFunctions(bool bRegister) override;
+
+	// Apply the timeline pose evaluated since the actor ticked
+	void applyEvaluatedPose();
+
+	// The actor's tick in three steps so the actor manager can batch them across actors. Only updateBoneLocations
+	// is safe to run off the game thread, and only while the other two aren't running for the same actor.
+	void beginFrameUpdate(float DeltaTime);
+	bool updateBoneLocations();
+	void finishFrameUpdate(bool boneLocationsChanged);
 
-	// Interpolate between two poses
-	TArray<FBoneInfo> intepolateTwoPoses(float percentageOfSecondPose, TArray<FBoneInfo> firstPose, TArray<FBoneInfo> secondPose);
+	// Whether the actor's per-frame work is batched with every other poseable actor's instead of ticking on its own
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Posing")
+	bool batchedUpdate;
 
+	// How many bytes a second the actor's pose edits can take up on the network
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Replication", meta = (ClampMin = "1000"))
+	int32 replicationBytesPerSecond;
+
+	// Bones that turned less than this since they were last sent wait until they turn further or the edit is over
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Posing|Replication", meta = (ClampMin = "0"))
+	float replicationAngleThresholdDegrees;
+
+	// Pose edits sent out by the server to everyone, including the player they came from, who skips them
+	UFUNCTION(NetMulticast, Unreliable)
+	void multicastBoneDelta(const FPoseDeltaPacket &packet);
+
+	UFUNCTION(NetMulticast, Reliable)
+	void multicastBoneSettle(const FPoseDeltaPacket &packet);
+
+	UFUNCTION(NetMulticast, Reliable)
+	void multicastKeyFrame(const FPoseKeyFramePacket &packet);
+
+	// Apply pose edits received from another player
+	void receiveBoneDelta(const FPoseDeltaPacket &packet);
+	void receiveKeyFrame(const FPoseKeyFramePacket &packet);
+
+	// Pack the whole local pose, or a keyframe, to send to a player that just joined. Returns false if there's
+	// nothing to pack.
+	bool buildPosePacket(FPoseDeltaPacket &outPacket);
+	bool buildKeyFramePacket(int32 keyFrameIndex, FPoseKeyFramePacket &outPacket);
+
+	int32 numKeyFrames() const
+	{
+		return keyFrames.numKeyFrames();
+	}
+
+	// No two keyframes share a time, so it identifies a keyframe however many are added or removed around it
+	float getKeyFrameTime(int32 keyFrameIndex) const
+	{
+		return keyFrames.getKeyFrameTime(keyFrameIndex);
+	}
+
+	int32 findKeyFrame(float keyFrameTime) const
+	{
+		return keyFrames.findKeyFrame(keyFrameTime);
+	}
+
+private:
 	// The current time of the animation playback
 	float currentAnimationTime;
 
-	// Save out an array of bone info for the current state of the skeleton
-	TArray<FBoneInfo> saveCurrentBoneState(bool worldSpace);
+	// Whether the timeline needs to be evaluated at the current time on the next tick
+	bool timelineEvaluationRequested;
+
+	// Evaluates the timeline on a worker between the actor's tick and the apply pose tick
+	FTimelineEvaluator timelineEvaluator;
+
+	// Runs after physics so every actor's evaluation gets the whole first half of the frame to finish in
+	FPoseableActorApplyPoseTickFunction applyPoseTick;
+
+	// Save out a pose for the current state of the skeleton, the pose is scratch memory that's only good for this frame
+	FPoseBuffer &saveCurrentBoneState(bool worldSpace);
+
+	// Change the current bone state to that of the inputted pose
+	void changeBoneState(const FPoseBuffer &newPose);
+
+	// The array of saved poses that will be used to generate an animation, kept in quantizedAnimationPoses instead
+	// while the keyframes are quantized
+	TArray<FPoseBuffer> animationPoses;
+	TArray<FQuantizedPose> quantizedAnimationPoses;
+
+	// Add a copy of a pose to the animation poses, or drop the last one, recycling the memory through the pose pool
+	void appendAnimationPose(const FPoseBuffer &pose);
+	void popAnimationPose();
+
+	int32 numAnimationPoses() const;
+
+	// Copy an animation pose out or replace it, packing and unpacking it if it's quantized
+	void readAnimationPose(int32 animationPoseIndex, FPoseBuffer &outPose) const;
+	void writeAnimationPose(int32 animationPoseIndex, const FPoseBuffer &pose);
+
+	// How quantized keyframes and animation poses are packed, translations are across a range relative to the first bone
+	FPoseQuantizationFormat keyFrameFormat;
+
+	// Where keyframe poses and per-frame scratch poses get their memory from
+	FPosePool posePool;
+
+	// Whether an animation is being saved out in the background
+	bool animationExportInProgress;
+
+	// Called back on the game thread when the background save is done
+	void animationExported(UAnimSequence *exportedAnimation, const FKeyReductionStats &keyReductionStats);
+
+	// The keyframes for this animation, sorted by time
+	FKeyframeTimeline keyFrames;
+
+	// Undo and redo stacks for everything the user edits
+	FPoseHistory poseHistory;
+
+	// Local pose from when the current bone edit started, the edit is diffed against it once it's done
+	FPoseBuffer boneEditStartPose;
+	FPoseBuffer boneEditEndPose;
+	bool boneEditInProgress;
+
+	// Where the actor was when the current move started
+	FVector actorMoveStartLocation;
+	bool actorMoveInProgress;
+
+	// Solves the chain above the dragged bone when IK dragging is on
+	FIKChainSolver ikSolver;
 
-	// Change the current bone state to that of the inputted array
-	void changeBoneState(TArray<FBoneInfo> newPose);
+	// Saved poses that can be searched for the one closest to the skeleton
+	FPoseLibrary poseLibrary;
 
-	// The array of saved poses that will be used to generate an animation
-	TArray<TArray<FBoneInfo>> animationPoses;
+	// The skeleton's pose when searching the library, and the library pose being applied
+	FPoseBuffer poseLibraryQuery;
+	FPoseBuffer poseLibraryResult;
 
-	// The array of keyframes for this animation
-	TArray<FKeyFrame> keyFrames;
+	// The library pose closest to the skeleton, refreshed while a bone is dragged
+	int32 nearestLibraryPoseIndex;
+
+	// Apply a library pose, turned to face the same way as the skeleton currently is
+	void applyLibraryPose(int32 libraryPoseIndex);
+
+	// The retarget map from another actor's skeleton to this one's along with the transform from where that actor is
+	// to where this one is, null if either actor has no skeleton
+	TSharedPtr<const FRetargetMap> getRetargetMap(APoseableActor *sourceActor, FTransform &outPlacement, float &outSourceScale) const;
+
+	// Left/right bone pairs of the skeleton, built in BeginPlay
+	FMirrorTable mirrorTable;
+
+	// Throw away the keyframes and the history that goes with them, and the animation poses too unless they're kept
+	void clearTimeline(int32 numKeyFramesToReserve, bool keepAnimationPoses);
+
+	// Tracks what's been sent to the other players and paces what's still to go
+	FPoseReplicator poseReplicator;
+
+	// Whether the pose should be settled with everyone once nothing's editing it anymore
+	bool replicationSettleRequested;
+
+	// The range keyframe translations are quantized across in component space, worked out from the mesh's bounds
+	FTranslationQuantizationRange keyFrameTranslationRange;
+
+	// Whether there's anyone to replicate edits to, or from
+	bool isReplicatingEdits() const;
+
+	// Send the changes made to the pose and keyframes this frame, within the byte budget
+	void replicateEdits();
+
+	// Get a packet to everyone else, through the server if this isn't it
+	void sendBonePacket(FPoseDeltaPacket &packet, bool reliable);
+	void sendKeyFramePacket(FPoseKeyFramePacket &packet);
+
+	// Queue a changed keyframe to be sent, or every keyframe after the whole timeline was replaced
+	void queueReplicatedKeyFrame(float keyFrameTime);
+	void queueReplicatedTimeline();
+
+	// The id the server stamps on the local player's packets, INDEX_NONE if there's no local player
+	int32 getLocalPlayerId() const;
+
+	// Start recording a bone edit if one isn't already being recorded
+	void beginBoneEdit();
+
+	// Record the bone edit once nothing is editing the bones anymore
+	void finishBoneEditIfIdle();
+
+	// Swap the state stored in an edit with the current state, which undoes or redoes it
+	void applyPoseEdit(FPoseEdit &edit, bool undoing);
 	
 	// The mannequin visible in game that the user will modify
 	UPoseableMeshComponent *poseableMesh;
@@ -87,12 +437,48 @@ private:
 	// The mesh to represent the bones
 	UStaticMesh* boneMesh;
 
-	// Reference meshes for the bones
-	TArray<UStaticMeshComponent *> boneReferences;
+	// Reference meshes for the bones, instance i marks bone i
+	UInstancedStaticMeshComponent *boneReferences;
+
+	// Drawn over the selected bone's reference with the selected stencil value, instances all share one stencil value
+	UStaticMeshComponent *selectedBoneReference;
+
+	// The bone the selected bone reference is drawn over, INDEX_NONE when nothing is selected
+	int32 selectedBoneIndex;
+
+	// Move the instanced references of the updated bones to their new locations in one batch
+	void updateBoneReferences();
+
+	// Highlight a bone's reference, INDEX_NONE clears the highlight
+	void setSelectedBone(int32 boneIndex);
+
+	// Finds the bones near the selection spheres
+	FBonePicker bonePicker;
+
+	// How far from its center a bone reference can be touched
+	float boneReferenceRadius;
+
+	// Select the bones the hands are touching
+	void updateBoneSelection();
+
+	// The closest bone touched by a selection sphere, INDEX_NONE if it isn't touching any
+	int32 pickBone(UStaticMeshComponent *selectionSphere) const;
 
 	// Bone info
 	TArray<FMeshBoneInfo> meshBoneInfo;
 
+	// Index based access to the bones of the poseable mesh
+	FPoseableBoneHandles boneHandles;
+
+	// The bone that is rotated when the whole mesh is rotated with both grips
+	int32 rootBoneIndex;
+
+	// World locations of every bone, the bones that changed get refreshed each frame to place the bone references
+	TArray<FVector> boneWorldLocations;
+
+	// The bones whose locations were refreshed this frame
+	TArray<int32> updatedBoneIndices;
+
 	// Rotation value along the bone's axis, used to rotate the bones in the only axis that you can't by just dragging them around
 	float trackpadRotation;
 
@@ -105,7 +491,7 @@ private:
 	// Keep track of the initial position of the controller when the grip button is pressed
 	FVector rightHandInitialGripPosition;
 	FVector initialGripVectorBetweenControllers;
-	FRotator initialActorRotation;
+	FQuat initialActorRotation;
 
 	// References to the right/left hand controller's location
 	UStaticMeshComponent *rightHandSelectionSphere;
@@ -117,20 +503,16 @@ private:
 
 	// The starting difference vector between the left and right hand bones
 	FVector startingLeftToRightVector;
-	FRotator startingBoneRotation;
-
-	// The currently overlapped bone references
-	UStaticMeshComponent *overlappedBoneLeftHand;
-	UStaticMeshComponent *overlappedBoneRightHand;
+	FQuat startingBoneRotation;
 
-	// The name of the current overlapped bones
-	FName overlappedBoneNameLeftHand;
-	FName overlappedBoneNameRightHand;
+	// The index of the bone currently overlapped by the right hand and the parent that dragging it rotates
+	int32 overlappedBoneIndexRightHand;
+	int32 overlappedBoneParentIndex;
 
-	FMeshBoneInfo overlappedBoneRighttHandInfo;
-	FName overlappedBoneParentName;
+	// The bone currently touched by the left hand
+	int32 overlappedBoneIndexLeftHand;
 
-	// The selection sphere currently overlapping bone references
+	// The selection spheres used to pick bones
 	UStaticMeshComponent *selectionSphereLeftHand;
 	UStaticMeshComponent *selectionSphereRightHand;
 };
@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseableActorManager.h"
+#include "PoseableActor.h"
+#include "PoseCreatorStats.h"
+#include "Async/ParallelFor.h"
+
+TMap<UWorld *, FPoseableActorManager *> FPoseableActorManager::managers;
+
+namespace
+{
+	// Whether an actor in the list should have its work run this pass
+	FORCEINLINE bool isActorAlive(const APoseableActor *actor)
+	{
+		return actor != nullptr && !actor->IsPendingKillOrUnreachable();
+	}
+}
+
+void FPoseableActorManagerTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef &MyCompletionGraphEvent)
+{
+	if (phase == EPoseableActorManagerPhase::Update)
+	{
+		manager->updateActors(DeltaTime);
+	}
+	else
+	{
+		manager->applyPoses();
+	}
+}
+
+FString FPoseableActorManagerTickFunction::DiagnosticMessage()
+{
+	return manager->getWorld()->GetFullName() + (phase == EPoseableActorManagerPhase::Update ? TEXT("[PoseableActorUpdate]") : TEXT("[PoseableActorApplyPoses]"));
+}
+
+FPoseableActorManager::FPoseableActorManager(UWorld *managerWorld) :
+	world(managerWorld),
+	inPass(false)
+{
+	// Same tick groups as the actor ticks they stand in for
+	updateTick.manager = this;
+	updateTick.phase = EPoseableActorManagerPhase::Update;
+	updateTick.bCanEverTick = true;
+	updateTick.TickGroup = TG_PrePhysics;
+	updateTick.RegisterTickFunction(world->PersistentLevel);
+
+	applyPosesTick.manager = this;
+	applyPosesTick.phase = EPoseableActorManagerPhase::ApplyPoses;
+	applyPosesTick.bCanEverTick = true;
+	applyPosesTick.TickGroup = TG_PostPhysics;
+	applyPosesTick.RegisterTickFunction(world->PersistentLevel);
+	applyPosesTick.AddPrerequisite(world, updateTick);
+}
+
+FPoseableActorManager::~FPoseableActorManager()
+{
+	applyPosesTick.UnRegisterTickFunction();
+	updateTick.UnRegisterTickFunction();
+}
+
+void FPoseableActorManager::registerActor(APoseableActor *actor)
+{
+	check(IsInGameThread());
+
+	// Managers left empty mid-pass are only cleaned up with their world
+	static bool worldCleanupBound = false;
+	if (!worldCleanupBound)
+	{
+		FWorldDelegates::OnWorldCleanup.AddStatic(&FPoseableActorManager::worldCleanup);
+		worldCleanupBound = true;
+	}
+
+	UWorld *actorWorld = actor->GetWorld();
+	FPoseableActorManager *&manager = managers.FindOrAdd(actorWorld);
+	if (manager == nullptr)
+	{
+		manager = new FPoseableActorManager(actorWorld);
+	}
+	else if (manager->actors.Num() == 0)
+	{
+		manager->setTicksEnabled(true);
+	}
+
+	// Actors registered mid-pass are picked up next frame, the pass only runs the ones that were there when it started
+	manager->actors.AddUnique(actor);
+}
+
+void FPoseableActorManager::unregisterActor(APoseableActor *actor)
+{
+	check(IsInGameThread());
+
+	FPoseableActorManager **manager = managers.Find(actor->GetWorld());
+	if (manager == nullptr)
+	{
+		return;
+	}
+
+	// Mid-pass the list is being walked, so the actor is only nulled out and finishPass removes it
+	if ((*manager)->inPass)
+	{
+		int32 actorIndex = (*manager)->actors.Find(actor);
+		if (actorIndex != INDEX_NONE)
+		{
+			(*manager)->actors[actorIndex] = nullptr;
+		}
+		return;
+	}
+
+	(*manager)->actors.Remove(actor);
+	if ((*manager)->actors.Num() == 0)
+	{
+		delete *manager;
+		managers.Remove(actor->GetWorld());
+	}
+}
+
+void FPoseableActorManager::worldCleanup(UWorld *cleanedUpWorld, bool sessionEnded, bool cleanupResources)
+{
+	FPoseableActorManager *manager = nullptr;
+	if (managers.RemoveAndCopyValue(cleanedUpWorld, manager))
+	{
+		delete manager;
+	}
+}
+
+void FPoseableActorManager::setTicksEnabled(bool enabled)
+{
+	updateTick.SetTickFunctionEnable(enabled);
+	applyPosesTick.SetTickFunctionEnable(enabled);
+}
+
+void FPoseableActorManager::finishPass()
+{
+	inPass = false;
+
+	actors.Remove(nullptr);
+	if (actors.Num() == 0)
+	{
+		setTicksEnabled(false);
+	}
+}
+
+void FPoseableActorManager::updateActors(float DeltaTime)
+{
+	inPass = true;
+
+	// Actors registered during the pass are left for next frame, so the workers' output always lines up
+	const int32 numActors = actors.Num();
+
+	for (int32 actorIndex = 0; actorIndex < numActors; actorIndex++)
+	{
+		if (isActorAlive(actors[actorIndex]))
+		{
+			actors[actorIndex]->beginFrameUpdate(DeltaTime);
+		}
+	}
+
+	// Every actor's forward kinematics and bone picker are independent of every other actor's. Nothing can leave
+	// while the workers run, the game thread is waiting on them.
+	boneLocationsChanged.SetNumUninitialized(numActors, false);
+	ParallelFor(numActors, [this](int32 actorIndex)
+	{
+		boneLocationsChanged[actorIndex] = isActorAlive(actors[actorIndex]) && actors[actorIndex]->updateBoneLocations();
+	});
+
+	// Components and hand input are only safe to touch on the game thread
+	for (int32 actorIndex = 0; actorIndex < numActors; actorIndex++)
+	{
+		if (isActorAlive(actors[actorIndex]))
+		{
+			actors[actorIndex]->finishFrameUpdate(boneLocationsChanged[actorIndex]);
+		}
+	}
+
+	finishPass();
+}
+
+void FPoseableActorManager::applyPoses()
+{
+	inPass = true;
+
+	const int32 numActors = actors.Num();
+	for (int32 actorIndex = 0; actorIndex < numActors; actorIndex++)
+	{
+		if (isActorAlive(actors[actorIndex]))
+		{
+			actors[actorIndex]->applyEvaluatedPose();
+		}
+	}
+
+	finishPass();
+}
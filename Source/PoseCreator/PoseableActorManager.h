@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseCreator.h"
+#include "PoseableActorManager.generated.h"
+
+class APoseableActor;
+class FPoseableActorManager;
+
+// The two points in the frame the manager runs every registered actor's work at
+enum class EPoseableActorManagerPhase : uint8
+{
+	// Kick off timeline evaluations, update bone locations and handle the hands, in place of the actors' own ticks
+	Update,
+	// Apply the evaluated timeline poses, in place of the actors' apply pose ticks
+	ApplyPoses
+};
+
+USTRUCT()
+struct FPoseableActorManagerTickFunction : public FTickFunction
+{
+	GENERATED_USTRUCT_BODY()
+
+	FPoseableActorManager *manager;
+	EPoseableActorManagerPhase phase;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef &MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FPoseableActorManagerTickFunction> : public TStructOpsTypeTraitsBase2<FPoseableActorManagerTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+// Runs the per-frame work of every poseable actor in a world as one batched pass instead of a tick per actor. Bone
+// locations and bone pickers only touch their own actor's data, so that part is spread across worker threads. One
+// manager exists per world while it has actors registered.
+//
+// Blueprint ticks run inside the pass and can destroy actors, so actors leaving mid-pass are only nulled out and the
+// list is compacted once the pass is done. A manager whose last actor leaves mid-pass can't delete itself from inside
+// its own tick, so it turns its ticks off and waits for an actor to come back or for the world to be cleaned up.
+class FPoseableActorManager
+{
+public:
+	// Have an actor's per-frame work run by its world's manager, creating the manager if needed. The actor turns off
+	// its own ticks.
+	static void registerActor(APoseableActor *actor);
+
+	// Take an actor out of its world's manager, the manager goes away with its last actor
+	static void unregisterActor(APoseableActor *actor);
+
+	// Called by the tick functions
+	void updateActors(float DeltaTime);
+	void applyPoses();
+
+	UWorld *getWorld() const
+	{
+		return world;
+	}
+
+private:
+	explicit FPoseableActorManager(UWorld *managerWorld);
+	~FPoseableActorManager();
+
+	// Drop the actors that left during the pass, and stop ticking if none are left
+	void finishPass();
+
+	void setTicksEnabled(bool enabled);
+
+	static void worldCleanup(UWorld *cleanedUpWorld, bool sessionEnded, bool cleanupResources);
+
+	UWorld *world;
+
+	// Actors that leave during a pass are set to null until the pass is done
+	TArray<APoseableActor *> actors;
+
+	// Set while the actors are being run, the list mustn't shrink and the manager mustn't go away until it's cleared
+	bool inPass;
+
+	// Filled in by the workers, one entry per actor so they never share anything
+	TArray<bool> boneLocationsChanged;
+
+	FPoseableActorManagerTickFunction updateTick;
+	FPoseableActorManagerTickFunction applyPosesTick;
+
+	static TMap<UWorld *, FPoseableActorManager *> managers;
+};
@@ -0,0 +1,291 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "PoseableBoneHandles.h"
+
+FPoseableBoneHandles::FPoseableBoneHandles() :
+	poseableMesh(nullptr),
+	firstStaleBone(0),
+	anyBonesDirty(false)
+{
+}
+
+void FPoseableBoneHandles::initialize(UPoseableMeshComponent *inPoseableMesh, const TArray<FMeshBoneInfo> &boneInfo)
+{
+	poseableMesh = inPoseableMesh;
+
+	meshBoneIndices.SetNumUninitialized(boneInfo.Num());
+	parentIndices.SetNumUninitialized(boneInfo.Num());
+	boneNames.SetNumUninitialized(boneInfo.Num());
+	componentSpaceTransforms.SetNum(boneInfo.Num());
+	firstStaleBone = 0;
+	dirtyBones.Init(true, boneInfo.Num());
+	anyBonesDirty = true;
+
+	for (int boneIndex = 0; boneIndex < boneInfo.Num(); boneIndex++)
+	{
+		meshBoneIndices[boneIndex] = poseableMesh->GetBoneIndex(boneInfo[boneIndex].Name);
+		parentIndices[boneIndex] = boneInfo[boneIndex].ParentIndex;
+		boneNames[boneIndex] = boneInfo[boneIndex].Name;
+
+		if (meshBoneIndices[boneIndex] == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Bone %s is in the skeleton but not in the poseable mesh"), *boneInfo[boneIndex].Name.ToString());
+		}
+
+		// Every pass over the bones depends on parents coming first
+		checkf(parentIndices[boneIndex] < boneIndex, TEXT("Bone %s comes before its parent"), *boneInfo[boneIndex].Name.ToString());
+	}
+}
+
+int32 FPoseableBoneHandles::findBone(FName boneName) const
+{
+	return boneNames.Find(boneName);
+}
+
+const FTransform &FPoseableBoneHandles::getLocalTransform(int32 boneIndex) const
+{
+	int32 meshBoneIndex = meshBoneIndices[boneIndex];
+	return meshBoneIndex != INDEX_NONE ? poseableMesh->LocalAtoms[meshBoneIndex] : FTransform::Identity;
+}
+
+const FTransform &FPoseableBoneHandles::getBoneComponentTransform(int32 boneIndex) const
+{
+	if (boneIndex >= firstStaleBone)
+	{
+		refreshComponentSpaceTransforms(boneIndex);
+	}
+	return componentSpaceTransforms[boneIndex];
+}
+
+const TArray<FTransform> &FPoseableBoneHandles::getComponentSpaceTransforms() const
+{
+	refreshComponentSpaceTransforms(meshBoneIndices.Num() - 1);
+	return componentSpaceTransforms;
+}
+
+void FPoseableBoneHandles::refreshComponentSpaceTransforms(int32 lastBoneIndex) const
+{
+	for (int boneIndex = firstStaleBone; boneIndex <= lastBoneIndex; boneIndex++)
+	{
+		int32 parentIndex = parentIndices[boneIndex];
+		if (parentIndex == INDEX_NONE)
+		{
+			componentSpaceTransforms[boneIndex] = getLocalTransform(boneIndex);
+		}
+		else
+		{
+			componentSpaceTransforms[boneIndex] = getLocalTransform(boneIndex) * componentSpaceTransforms[parentIndex];
+		}
+	}
+
+	firstStaleBone = FMath::Max(firstStaleBone, lastBoneIndex + 1);
+}
+
+FTransform FPoseableBoneHandles::getBoneWorldTransform(int32 boneIndex) const
+{
+	return getBoneComponentTransform(boneIndex) * poseableMesh->GetComponentToWorld();
+}
+
+FVector FPoseableBoneHandles::getBoneWorldLocation(int32 boneIndex) const
+{
+	return getBoneWorldTransform(boneIndex).GetLocation();
+}
+
+FQuat FPoseableBoneHandles::getBoneWorldRotation(int32 boneIndex) const
+{
+	return getBoneWorldTransform(boneIndex).GetRotation();
+}
+
+void FPoseableBoneHandles::readWorldPose(FPoseBuffer &outPose) const
+{
+	getComponentSpaceTransforms();
+
+	const FTransform &componentToWorld = poseableMesh->GetComponentToWorld();
+	outPose.setNumBones(meshBoneIndices.Num());
+
+	for (int boneIndex = 0; boneIndex < meshBoneIndices.Num(); boneIndex++)
+	{
+		FTransform worldTransform = componentSpaceTransforms[boneIndex] * componentToWorld;
+		outPose.rotations[boneIndex] = worldTransform.GetRotation();
+		outPose.translations[boneIndex] = worldTransform.GetTranslation();
+	}
+}
+
+void FPoseableBoneHandles::readLocalPose(FPoseBuffer &outPose) const
+{
+	outPose.setNumBones(meshBoneIndices.Num());
+
+	for (int boneIndex = 0; boneIndex < meshBoneIndices.Num(); boneIndex++)
+	{
+		const FTransform &localTransform = getLocalTransform(boneIndex);
+		outPose.rotations[boneIndex] = localTransform.GetRotation();
+		outPose.translations[boneIndex] = localTransform.GetTranslation();
+	}
+}
+
+void FPoseableBoneHandles::readWorldLocations(TArray<FVector> &outLocations) const
+{
+	getComponentSpaceTransforms();
+
+	const FTransform &componentToWorld = poseableMesh->GetComponentToWorld();
+	outLocations.SetNumUninitialized(meshBoneIndices.Num(), false);
+
+	for (int boneIndex = 0; boneIndex < meshBoneIndices.Num(); boneIndex++)
+	{
+		outLocations[boneIndex] = componentToWorld.TransformPosition(componentSpaceTransforms[boneIndex].GetTranslation());
+	}
+}
+
+void FPoseableBoneHandles::readLocalScales(TArray<FVector> &outScales) const
+{
+	outScales.SetNumUninitialized(meshBoneIndices.Num(), false);
+
+	for (int boneIndex = 0; boneIndex < meshBoneIndices.Num(); boneIndex++)
+	{
+		outScales[boneIndex] = getLocalTransform(boneIndex).GetScale3D();
+	}
+}
+
+void FPoseableBoneHandles::setBoneWorldRotation(int32 boneIndex, const FQuat &newRotation)
+{
+	int32 meshBoneIndex = meshBoneIndices[boneIndex];
+	if (meshBoneIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	// Bring the rotation into component space and then into the space of the parent bone
+	FQuat localRotation = poseableMesh->GetComponentToWorld().GetRotation().Inverse() * newRotation;
+	int32 parentIndex = parentIndices[boneIndex];
+	if (parentIndex != INDEX_NONE)
+	{
+		localRotation = getBoneComponentTransform(parentIndex).GetRotation().Inverse() * localRotation;
+	}
+
+	poseableMesh->LocalAtoms[meshBoneIndex].SetRotation(localRotation.GetNormalized());
+	poseableMesh->MarkRefreshTransformDirty();
+	markBoneDirty(boneIndex);
+}
+
+void FPoseableBoneHandles::applyWorldRotations(const FPoseBuffer &pose)
+{
+	check(pose.numBones() == meshBoneIndices.Num());
+
+	FQuat worldToComponentRotation = poseableMesh->GetComponentToWorld().GetRotation().Inverse();
+
+	// Walk the skeleton parents first, keeping the component space transforms up to date as bones are changed so
+	// every child is solved against its parent's new rotation
+	for (int boneIndex = 0; boneIndex < meshBoneIndices.Num(); boneIndex++)
+	{
+		int32 meshBoneIndex = meshBoneIndices[boneIndex];
+		int32 parentIndex = parentIndices[boneIndex];
+
+		FQuat localRotation = worldToComponentRotation * pose.rotations[boneIndex];
+		if (parentIndex != INDEX_NONE)
+		{
+			localRotation = componentSpaceTransforms[parentIndex].GetRotation().Inverse() * localRotation;
+		}
+
+		if (meshBoneIndex != INDEX_NONE)
+		{
+			poseableMesh->LocalAtoms[meshBoneIndex].SetRotation(localRotation.GetNormalized());
+		}
+
+		const FTransform &localTransform = getLocalTransform(boneIndex);
+		componentSpaceTransforms[boneIndex] = parentIndex == INDEX_NONE ? localTransform : localTransform * componentSpaceTransforms[parentIndex];
+	}
+	firstStaleBone = meshBoneIndices.Num();
+
+	poseableMesh->MarkRefreshTransformDirty();
+	markAllBonesDirty();
+}
+
+void FPoseableBoneHandles::setBoneLocalRotation(int32 boneIndex, const FQuat &newRotation)
+{
+	int32 meshBoneIndex = meshBoneIndices[boneIndex];
+	if (meshBoneIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	poseableMesh->LocalAtoms[meshBoneIndex].SetRotation(newRotation);
+	poseableMesh->MarkRefreshTransformDirty();
+	markBoneDirty(boneIndex);
+}
+
+void FPoseableBoneHandles::resetRotationsToReferencePose()
+{
+	const TArray<FTransform> &referencePose = poseableMesh->SkeletalMesh->RefSkeleton.GetRefBonePose();
+
+	for (int boneIndex = 0; boneIndex < meshBoneIndices.Num(); boneIndex++)
+	{
+		int32 meshBoneIndex = meshBoneIndices[boneIndex];
+		if (meshBoneIndex != INDEX_NONE)
+		{
+			poseableMesh->LocalAtoms[meshBoneIndex].SetRotation(referencePose[meshBoneIndex].GetRotation());
+		}
+	}
+
+	invalidateComponentSpaceFrom(0);
+	poseableMesh->MarkRefreshTransformDirty();
+	markAllBonesDirty();
+}
+
+void FPoseableBoneHandles::markBoneDirty(int32 boneIndex)
+{
+	invalidateComponentSpaceFrom(boneIndex);
+	dirtyBones[boneIndex] = true;
+	anyBonesDirty = true;
+
+	// Children always come after their parents, so one pass forward reaches every descendant
+	for (int32 childIndex = boneIndex + 1; childIndex < parentIndices.Num(); childIndex++)
+	{
+		int32 parentIndex = parentIndices[childIndex];
+		if (parentIndex != INDEX_NONE && dirtyBones[parentIndex])
+		{
+			dirtyBones[childIndex] = true;
+		}
+	}
+}
+
+void FPoseableBoneHandles::markAllBonesDirty()
+{
+	dirtyBones.Init(true, meshBoneIndices.Num());
+	anyBonesDirty = true;
+}
+
+bool FPoseableBoneHandles::updateDirtyWorldLocations(TArray<FVector> &worldLocations, TArray<int32> &outUpdatedBoneIndices)
+{
+	outUpdatedBoneIndices.Reset();
+
+	// Moving the mesh moves every bone
+	const FTransform &componentToWorld = poseableMesh->GetComponentToWorld();
+	if (!componentToWorld.Equals(lastComponentToWorld, 0.0f))
+	{
+		lastComponentToWorld = componentToWorld;
+		markAllBonesDirty();
+	}
+
+	if (!anyBonesDirty)
+	{
+		return false;
+	}
+
+	worldLocations.SetNumUninitialized(meshBoneIndices.Num(), false);
+
+	// Shares the frame's forward kinematics pass with every other read of the pose
+	getComponentSpaceTransforms();
+
+	for (TConstSetBitIterator<> dirtyBone(dirtyBones); dirtyBone; ++dirtyBone)
+	{
+		int32 boneIndex = dirtyBone.GetIndex();
+		worldLocations[boneIndex] = componentToWorld.TransformPosition(componentSpaceTransforms[boneIndex].GetTranslation());
+
+		outUpdatedBoneIndices.Add(boneIndex);
+	}
+
+	dirtyBones.Init(false, meshBoneIndices.Num());
+	anyBonesDirty = false;
+	return true;
+}
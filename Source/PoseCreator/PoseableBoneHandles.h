@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Components/PoseableMeshComponent.h"
+#include "PoseBuffer.h"
+
+// Resolves the skeleton's bones to poseable mesh indices once so per-frame code can read and write bones by index.
+// Bone indices used by this class are indices into the skeleton's reference bone info, the same order poses are stored in.
+class FPoseableBoneHandles
+{
+public:
+	FPoseableBoneHandles();
+
+	// Resolve every bone of the skeleton to its index on the poseable mesh and cache the parent indices
+	void initialize(UPoseableMeshComponent *inPoseableMesh, const TArray<FMeshBoneInfo> &boneInfo);
+
+	bool isValid() const
+	{
+		return poseableMesh != nullptr;
+	}
+
+	int32 numBones() const
+	{
+		return meshBoneIndices.Num();
+	}
+
+	int32 getParentIndex(int32 boneIndex) const
+	{
+		return parentIndices[boneIndex];
+	}
+
+	// Find a bone by name, this is a linear search so keep it out of per-frame code
+	int32 findBone(FName boneName) const;
+
+	// Single bone reads
+	FTransform getBoneWorldTransform(int32 boneIndex) const;
+	FVector getBoneWorldLocation(int32 boneIndex) const;
+	FQuat getBoneWorldRotation(int32 boneIndex) const;
+
+	// Read every bone at once
+	void readWorldPose(FPoseBuffer &outPose) const;
+	void readLocalPose(FPoseBuffer &outPose) const;
+	void readWorldLocations(TArray<FVector> &outLocations) const;
+	void readLocalScales(TArray<FVector> &outScales) const;
+
+	// Set the world space rotation of a single bone, keeping its children attached
+	void setBoneWorldRotation(int32 boneIndex, const FQuat &newRotation);
+
+	// Set the world space rotation of every bone from a pose in one pass over the skeleton
+	void applyWorldRotations(const FPoseBuffer &pose);
+
+	// Rotation of a bone relative to its parent
+	FQuat getBoneLocalRotation(int32 boneIndex) const
+	{
+		return getLocalTransform(boneIndex).GetRotation();
+	}
+
+	void setBoneLocalRotation(int32 boneIndex, const FQuat &newRotation);
+
+	// Put every bone's rotation back to the mesh's reference pose
+	void resetRotationsToReferencePose();
+
+	// Flag a bone and everything below it as changed, bone writes through the handles do this automatically
+	void markBoneDirty(int32 boneIndex);
+
+	// Flag every bone as changed
+	void markAllBonesDirty();
+
+	// Refresh the world locations of the bones that changed since the last call, also picking up any movement of the
+	// mesh itself. The indices of the refreshed bones are written out, returns false if nothing changed.
+	bool updateDirtyWorldLocations(TArray<FVector> &worldLocations, TArray<int32> &outUpdatedBoneIndices);
+
+	// Component space transforms of every bone, only recomputed for bones that changed since the last read
+	const TArray<FTransform> &getComponentSpaceTransforms() const;
+
+private:
+	// The cached component space transform of a bone, brought up to date first if it's stale
+	const FTransform &getBoneComponentTransform(int32 boneIndex) const;
+
+	// Bring the cached component space transforms up to date through the given bone in one forward pass. Parents are
+	// always stored before their children, so every parent is up to date by the time its children are reached.
+	void refreshComponentSpaceTransforms(int32 lastBoneIndex) const;
+
+	// A bone's local transform changed, so its cached transform and everything after it are stale
+	void invalidateComponentSpaceFrom(int32 boneIndex)
+	{
+		firstStaleBone = FMath::Min(firstStaleBone, boneIndex);
+	}
+
+	const FTransform &getLocalTransform(int32 boneIndex) const;
+
+	// The mesh the handles were resolved against
+	UPoseableMeshComponent *poseableMesh;
+
+	// The index into the poseable mesh's local atoms for each skeleton bone, INDEX_NONE if the mesh doesn't have the bone
+	TArray<int32> meshBoneIndices;
+
+	// The parent of each skeleton bone
+	TArray<int32> parentIndices;
+
+	// The names of the bones, only used by findBone
+	TArray<FName> boneNames;
+
+	// Component space transforms of the bones, valid for every bone before firstStaleBone
+	mutable TArray<FTransform> componentSpaceTransforms;
+	mutable int32 firstStaleBone;
+
+	// Bones changed since the last call to updateDirtyWorldLocations
+	TBitArray<> dirtyBones;
+	bool anyBonesDirty;
+
+	// Where the mesh was the last time the world locations were updated
+	FTransform lastComponentToWorld;
+};
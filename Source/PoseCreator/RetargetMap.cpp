@@ -0,0 +1,195 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "RetargetMap.h"
+#include "Async/ParallelFor.h"
+
+TMap<FRetargetMap::FSkeletonPairKey, FRetargetMap::FCachedMap> FRetargetMap::cachedMaps;
+
+namespace
+{
+	// The reference pose of a skeleton in component space, parents always come before their children
+	void buildComponentReferencePose(const FReferenceSkeleton &skeleton, TArray<FTransform> &outTransforms)
+	{
+		const TArray<FTransform> &localPose = skeleton.GetRefBonePose();
+		outTransforms.SetNumUninitialized(localPose.Num());
+		for (int32 boneIndex = 0; boneIndex < localPose.Num(); boneIndex++)
+		{
+			int32 parentIndex = skeleton.GetParentIndex(boneIndex);
+			outTransforms[boneIndex] = parentIndex == INDEX_NONE ? localPose[boneIndex] : localPose[boneIndex] * outTransforms[parentIndex];
+		}
+	}
+}
+
+TSharedPtr<const FRetargetMap> FRetargetMap::get(const USkeleton *sourceSkeleton, const USkeleton *targetSkeleton)
+{
+	check(IsInGameThread());
+
+	FSkeletonPairKey key;
+	key.sourceSkeleton = FObjectKey(sourceSkeleton);
+	key.targetSkeleton = FObjectKey(targetSkeleton);
+
+	const FReferenceSkeleton &sourceReferenceSkeleton = sourceSkeleton->GetReferenceSkeleton();
+	const FReferenceSkeleton &targetReferenceSkeleton = targetSkeleton->GetReferenceSkeleton();
+
+	// Without a source bone there's nothing to carry the placement of the target skeleton
+	if (sourceReferenceSkeleton.GetNum() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Can't retarget from %s, it doesn't have any bones!!!"), *sourceSkeleton->GetName());
+		return nullptr;
+	}
+
+	// A re-imported skeleton keeps its object, so the cached map is checked against what it was built from
+	if (const FCachedMap *cachedMap = cachedMaps.Find(key))
+	{
+		if (cachedMap->sourceGuid == sourceSkeleton->GetGuid() && cachedMap->targetGuid == targetSkeleton->GetGuid() &&
+			cachedMap->numSourceBones == sourceReferenceSkeleton.GetNum() && cachedMap->numTargetBones == targetReferenceSkeleton.GetNum())
+		{
+			return cachedMap->map;
+		}
+	}
+
+	FCachedMap newMap = { MakeShareable(new FRetargetMap(sourceReferenceSkeleton, targetReferenceSkeleton, TMap<FName, FName>())),
+		sourceSkeleton->GetGuid(), targetSkeleton->GetGuid(), sourceReferenceSkeleton.GetNum(), targetReferenceSkeleton.GetNum() };
+	cachedMaps.Add(key, newMap);
+	return newMap.map;
+}
+
+FRetargetMap::FRetargetMap(const FReferenceSkeleton &sourceSkeleton, const FReferenceSkeleton &targetSkeleton, const TMap<FName, FName> &boneOverrides) :
+	numSourceSkeletonBones(sourceSkeleton.GetNum()),
+	numMapped(0)
+{
+	check(numSourceSkeletonBones > 0);
+
+	TArray<FTransform> sourceReferencePose;
+	TArray<FTransform> targetReferencePose;
+	buildComponentReferencePose(sourceSkeleton, sourceReferencePose);
+	buildComponentReferencePose(targetSkeleton, targetReferencePose);
+
+	const int32 numBones = targetSkeleton.GetNum();
+	sourceBones.SetNumUninitialized(numBones);
+	targetParents.SetNumUninitialized(numBones);
+	sourceParentBones.SetNumUninitialized(numBones);
+	rotationCorrections.SetNumUninitialized(numBones);
+	referenceOffsets.SetNumUninitialized(numBones);
+	sourceReferenceLengths.SetNumUninitialized(numBones);
+
+	// Names are only resolved here, applying the map never looks at them
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		FName boneName = targetSkeleton.GetBoneName(boneIndex);
+		if (const FName *overrideName = boneOverrides.Find(boneName))
+		{
+			boneName = *overrideName;
+		}
+		sourceBones[boneIndex] = sourceSkeleton.FindBoneIndex(boneName);
+		targetParents[boneIndex] = targetSkeleton.GetParentIndex(boneIndex);
+	}
+
+	// Something has to carry the placement of the skeleton, so an unmatched root follows the source root
+	if (numBones > 0 && sourceBones[0] == INDEX_NONE)
+	{
+		sourceBones[0] = 0;
+	}
+
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		const int32 sourceBone = sourceBones[boneIndex];
+		const int32 parentIndex = targetParents[boneIndex];
+		sourceParentBones[boneIndex] = parentIndex != INDEX_NONE ? sourceBones[parentIndex] : INDEX_NONE;
+
+		const FTransform &targetReference = targetReferencePose[boneIndex];
+		if (sourceBone != INDEX_NONE)
+		{
+			numMapped++;
+			rotationCorrections[boneIndex] = sourceReferencePose[sourceBone].GetRotation().Inverse() * targetReference.GetRotation();
+		}
+		else
+		{
+			rotationCorrections[boneIndex] = targetSkeleton.GetRefBonePose()[boneIndex].GetRotation();
+		}
+
+		referenceOffsets[boneIndex] = FVector::ZeroVector;
+		sourceReferenceLengths[boneIndex] = 0.0f;
+		if (parentIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const FTransform &targetParentReference = targetReferencePose[parentIndex];
+		referenceOffsets[boneIndex] = targetParentReference.GetRotation().Inverse().RotateVector(targetReference.GetLocation() - targetParentReference.GetLocation());
+
+		// Mapped bones with a mapped parent follow how far the source bone is stretched from its reference length
+		const int32 sourceParentBone = sourceParentBones[boneIndex];
+		if (sourceBone != INDEX_NONE && sourceParentBone != INDEX_NONE)
+		{
+			sourceReferenceLengths[boneIndex] = FVector::Dist(sourceReferencePose[sourceBone].GetLocation(), sourceReferencePose[sourceParentBone].GetLocation());
+		}
+	}
+}
+
+void FRetargetMap::retargetPose(const FPoseBuffer &sourcePose, const FTransform &placement, float sourceScale, FPoseBuffer &outPose) const
+{
+	check(sourcePose.numBones() == numSourceSkeletonBones);
+	check(&sourcePose != &outPose);
+
+	const int32 numBones = targetParents.Num();
+	outPose.setNumBones(numBones);
+
+	// Source poses are in world units and the reference offsets and lengths in component units, so source distances
+	// are brought back to the source's component scale and offsets out to the target's
+	const float inverseSourceScale = 1.0f / FMath::Max(sourceScale, KINDA_SMALL_NUMBER);
+	const float targetScale = placement.GetMaximumAxisScale() * sourceScale;
+
+	const FQuat placementRotation = placement.GetRotation();
+	const FQuat *sourceRotations = sourcePose.rotations.GetData();
+	const FVector *sourceTranslations = sourcePose.translations.GetData();
+	FQuat *outRotations = outPose.rotations.GetData();
+	FVector *outTranslations = outPose.translations.GetData();
+
+	// One pass down the target skeleton, every parent is done before its children so they can build on it
+	for (int32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		const int32 sourceBone = sourceBones[boneIndex];
+		const int32 parentIndex = targetParents[boneIndex];
+
+		if (sourceBone != INDEX_NONE)
+		{
+			outRotations[boneIndex] = placementRotation * sourceRotations[sourceBone] * rotationCorrections[boneIndex];
+		}
+		else
+		{
+			outRotations[boneIndex] = outRotations[parentIndex] * rotationCorrections[boneIndex];
+		}
+
+		if (parentIndex == INDEX_NONE)
+		{
+			outTranslations[boneIndex] = placement.TransformPosition(sourceTranslations[sourceBone]);
+		}
+		else
+		{
+			// Forward kinematics from the retargeted parent, so each bone keeps the target's proportions and follows
+			// its parent's corrected rotation
+			float stretch = 1.0f;
+			if (sourceReferenceLengths[boneIndex] > KINDA_SMALL_NUMBER)
+			{
+				const float sourceLength = FVector::Dist(sourceTranslations[sourceBone], sourceTranslations[sourceParentBones[boneIndex]]) * inverseSourceScale;
+				stretch = sourceLength / sourceReferenceLengths[boneIndex];
+			}
+			outTranslations[boneIndex] = outTranslations[parentIndex] +
+				outRotations[parentIndex].RotateVector(referenceOffsets[boneIndex] * (stretch * targetScale));
+		}
+
+		outRotations[boneIndex].Normalize();
+	}
+}
+
+void FRetargetMap::retargetPoses(const FPoseBuffer *const *sourcePoses, int32 numPoses, const FTransform &placement, float sourceScale,
+	FPoseBuffer *outPoses) const
+{
+	// Every pose is independent, so each worker takes whole poses
+	ParallelFor(numPoses, [this, sourcePoses, &placement, sourceScale, outPoses](int32 poseIndex)
+	{
+		retargetPose(*sourcePoses[poseIndex], placement, sourceScale, outPoses[poseIndex]);
+	});
+}
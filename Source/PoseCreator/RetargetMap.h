@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseBuffer.h"
+#include "UObject/ObjectKey.h"
+
+// Everything needed to move a pose from one skeleton onto another, worked out once per pair of skeletons. Bones are
+// matched by name, with optional overrides for rigs that name their bones differently. Each mapped bone keeps the
+// source bone's rotation relative to the source reference pose, applied on top of its own reference pose. Positions
+// are built down the target skeleton from each parent's retargeted rotation and the target's own reference offset,
+// stretched as much as the source bone is stretched from its reference length. Target bones with no match hold their
+// reference pose relative to their parent.
+class FRetargetMap
+{
+public:
+	// The cached map between two skeletons, built the first time the pair is asked for and rebuilt if either skeleton
+	// has changed since, such as after a re-import. Null if the source skeleton has no bones to follow.
+	static TSharedPtr<const FRetargetMap> get(const USkeleton *sourceSkeleton, const USkeleton *targetSkeleton);
+
+	// Build a map with explicit pairings, target bone name to source bone name, on top of the name matches. The source
+	// skeleton must have bones. Maps built this way aren't cached.
+	FRetargetMap(const FReferenceSkeleton &sourceSkeleton, const FReferenceSkeleton &targetSkeleton, const TMap<FName, FName> &boneOverrides);
+
+	// Retarget a world space pose of the source skeleton onto the target skeleton. The placement moves the result from
+	// where the source skeleton is into where the target skeleton is, and the source scale is the source component's
+	// scale, which together give the target's own scale. Component scales are taken as uniform.
+	void retargetPose(const FPoseBuffer &sourcePose, const FTransform &placement, float sourceScale, FPoseBuffer &outPose) const;
+
+	// Retarget a batch of poses, such as a whole timeline, spread across worker threads
+	void retargetPoses(const FPoseBuffer *const *sourcePoses, int32 numPoses, const FTransform &placement, float sourceScale,
+		FPoseBuffer *outPoses) const;
+
+	int32 numSourceBones() const
+	{
+		return numSourceSkeletonBones;
+	}
+
+	int32 numTargetBones() const
+	{
+		return targetParents.Num();
+	}
+
+	// How many target bones have a source bone
+	int32 numMappedBones() const
+	{
+		return numMapped;
+	}
+
+private:
+	int32 numSourceSkeletonBones;
+	int32 numMapped;
+
+	// Per target bone, in the target skeleton's bone order: the source bone it follows or INDEX_NONE, its parent, and
+	// the source bone its parent follows
+	TArray<int32> sourceBones;
+	TArray<int32> targetParents;
+	TArray<int32> sourceParentBones;
+
+	// Per target bone: for mapped bones the rotation taking the source reference pose to the target reference pose,
+	// otherwise the reference rotation relative to the parent
+	FPoseRotationArray rotationCorrections;
+
+	// Per target bone: the reference offset from the parent in the parent's frame, and for mapped bones with a mapped
+	// parent the source's reference length between the two, zero otherwise. Both are in component units.
+	FPoseTranslationArray referenceOffsets;
+	TArray<float> sourceReferenceLengths;
+
+	struct FSkeletonPairKey
+	{
+		FObjectKey sourceSkeleton;
+		FObjectKey targetSkeleton;
+
+		bool operator==(const FSkeletonPairKey &other) const
+		{
+			return sourceSkeleton == other.sourceSkeleton && targetSkeleton == other.targetSkeleton;
+		}
+
+		friend uint32 GetTypeHash(const FSkeletonPairKey &key)
+		{
+			return HashCombine(GetTypeHash(key.sourceSkeleton), GetTypeHash(key.targetSkeleton));
+		}
+	};
+
+	// What a cached map was built from, a skeleton's guid changes whenever its bones do
+	struct FCachedMap
+	{
+		TSharedRef<const FRetargetMap> map;
+		FGuid sourceGuid;
+		FGuid targetGuid;
+		int32 numSourceBones;
+		int32 numTargetBones;
+	};
+
+	static TMap<FSkeletonPairKey, FCachedMap> cachedMaps;
+};
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "TimelineEvaluator.h"
+#include "PoseCreatorStats.h"
+
+FTimelineEvaluator::FTimelineEvaluator() :
+	backBufferIndex(0),
+	evaluationSucceeded(false),
+	evaluationBufferGrowth(0),
+	kickFrame(0)
+{
+}
+
+FTimelineEvaluator::~FTimelineEvaluator()
+{
+	// The worker writes into this object, so it can't go away under it
+	wait();
+}
+
+void FTimelineEvaluator::kick(const FKeyframeTimeline &timeline, float timeToEvaluate)
+{
+	check(IsInGameThread());
+
+	if (isInFlight())
+	{
+		return;
+	}
+
+	const FKeyframeTimeline *timelineToEvaluate = &timeline;
+	FPoseBuffer *backBuffer = &poseBuffers[backBufferIndex];
+	bool *succeeded = &evaluationSucceeded;
+	int32 *bufferGrowth = &evaluationBufferGrowth;
+	kickFrame = GFrameCounter;
+	const uint64 frameNumber = kickFrame;
+
+	evaluationTask = FFunctionGraphTask::CreateAndDispatchWhenReady([timelineToEvaluate, timeToEvaluate, backBuffer, succeeded, bufferGrowth, frameNumber]()
+	{
+		POSECREATOR_SCOPE_TIMING_FOR_FRAME(TimelineEvaluation, frameNumber);
+
+		// Only growth of the output buffers is counted here, the timeline's own scratch poses aren't seen
+		int32 rotationCapacity = backBuffer->rotations.Max();
+		int32 translationCapacity = backBuffer->translations.Max();
+
+		*succeeded = timelineToEvaluate->evaluate(timeToEvaluate, *backBuffer);
+
+		*bufferGrowth = (backBuffer->rotations.Max() != rotationCapacity ? 1 : 0) + (backBuffer->translations.Max() != translationCapacity ? 1 : 0);
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+}
+
+void FTimelineEvaluator::wait()
+{
+	if (isInFlight())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(evaluationTask, ENamedThreads::GameThread);
+	}
+}
+
+const FPoseBuffer *FTimelineEvaluator::collect()
+{
+	check(IsInGameThread());
+
+	if (!isInFlight())
+	{
+		return nullptr;
+	}
+
+	wait();
+	evaluationTask = nullptr;
+
+	FPoseCreatorTimings::addEvaluationBufferGrowth(evaluationBufferGrowth, kickFrame);
+
+	if (!evaluationSucceeded)
+	{
+		return nullptr;
+	}
+
+	// The finished buffer becomes the front one and the next evaluation writes into the other
+	const FPoseBuffer *finishedPose = &poseBuffers[backBufferIndex];
+	backBufferIndex = 1 - backBufferIndex;
+	return finishedPose;
+}
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "KeyframeTimeline.h"
+
+// Evaluates a timeline on a worker thread into one of two pose buffers. The game thread kicks the evaluation off early
+// in the frame and picks up the finished pose later on, while the next evaluation is free to write into the other
+// buffer. The timeline must not be edited while an evaluation is in flight, call wait first.
+class FTimelineEvaluator
+{
+public:
+	FTimelineEvaluator();
+	~FTimelineEvaluator();
+
+	// Start evaluating the timeline at the given time. Does nothing if an evaluation is already in flight.
+	void kick(const FKeyframeTimeline &timeline, float timeToEvaluate);
+
+	// Whether an evaluation has been kicked off and not collected yet
+	bool isInFlight() const
+	{
+		return evaluationTask.IsValid();
+	}
+
+	// Block until the evaluation in flight is done, without collecting it
+	void wait();
+
+	// Wait for the evaluation in flight and swap it in, returns the finished pose or null if there isn't a new one
+	const FPoseBuffer *collect();
+
+private:
+	// The two pose buffers, the worker writes into the back one while the front one holds the last collected pose
+	FPoseBuffer poseBuffers[2];
+	int32 backBufferIndex;
+
+	// Set by the worker, only read after the task has completed
+	bool evaluationSucceeded;
+	int32 evaluationBufferGrowth;
+
+	// The frame the evaluation in flight was kicked off on, its timings are filed under it
+	uint64 kickFrame;
+
+	FGraphEventRef evaluationTask;
+};
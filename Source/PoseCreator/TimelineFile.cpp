@@ -0,0 +1,311 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseCreator.h"
+#include "TimelineFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+
+#if PLATFORM_WINDOWS
+#include "AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "HideWindowsPlatformTypes.h"
+#define TIMELINE_FILE_CAN_MAP 1
+#elif PLATFORM_LINUX || PLATFORM_MAC || PLATFORM_ANDROID
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define TIMELINE_FILE_CAN_MAP 1
+#else
+#define TIMELINE_FILE_CAN_MAP 0
+#endif
+
+namespace
+{
+	FORCEINLINE uint64 alignTo16(uint64 offset)
+	{
+		return Align(offset, 16);
+	}
+
+	void writeBytes(TArray<uint8> &fileData, const void *bytes, int32 numBytes)
+	{
+		int32 writeOffset = fileData.AddUninitialized(numBytes);
+		FMemory::Memcpy(fileData.GetData() + writeOffset, bytes, numBytes);
+	}
+
+	void padTo16(TArray<uint8> &fileData)
+	{
+		fileData.AddZeroed(alignTo16(fileData.Num()) - fileData.Num());
+	}
+}
+
+uint64 TimelineFile::getPoseStride(uint32 numBones)
+{
+	return (uint64)numBones * sizeof(FQuat) + alignTo16((uint64)numBones * sizeof(FVector));
+}
+
+bool TimelineFile::save(const FString &filePath, const TArray<FName> &boneNames, const FKeyframeTimeline &timeline)
+{
+	const uint32 numBones = boneNames.Num();
+	const uint32 numKeyFrames = timeline.numKeyFrames();
+
+	for (uint32 keyFrameIndex = 0; keyFrameIndex < numKeyFrames; keyFrameIndex++)
+	{
+		if (timeline.getKeyFrameNumBones(keyFrameIndex) != (int32)numBones)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Keyframe %d doesn't have a pose for every bone, can't save the timeline"), keyFrameIndex);
+			return false;
+		}
+	}
+
+	TArray<uint8> fileData;
+	fileData.AddZeroed(sizeof(FTimelineFileHeader));
+
+	FTimelineFileHeader header;
+	header.magic = TIMELINE_FILE_MAGIC;
+	header.version = TIMELINE_FILE_VERSION;
+	header.numBones = numBones;
+	header.numKeyFrames = numKeyFrames;
+
+	// Bone names are only stored once for the whole file
+	header.boneNamesOffset = fileData.Num();
+	for (uint32 boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		FTCHARToUTF8 boneName(*boneNames[boneIndex].ToString());
+		uint16 nameLength = boneName.Length();
+		writeBytes(fileData, &nameLength, sizeof(nameLength));
+		writeBytes(fileData, boneName.Get(), nameLength);
+	}
+	padTo16(fileData);
+
+	header.keyFrameTimesOffset = fileData.Num();
+	for (uint32 keyFrameIndex = 0; keyFrameIndex < numKeyFrames; keyFrameIndex++)
+	{
+		float keyFrameTime = timeline.getKeyFrameTime(keyFrameIndex);
+		writeBytes(fileData, &keyFrameTime, sizeof(float));
+	}
+	padTo16(fileData);
+
+	// Poses go in as they're laid out in memory, quantized keyframes are always saved unpacked
+	header.poseDataOffset = fileData.Num();
+	fileData.Reserve(fileData.Num() + numKeyFrames * getPoseStride(numBones));
+	FPoseBuffer pose;
+	for (uint32 keyFrameIndex = 0; keyFrameIndex < numKeyFrames; keyFrameIndex++)
+	{
+		timeline.readKeyFramePose(keyFrameIndex, pose);
+		writeBytes(fileData, pose.rotations.GetData(), numBones * sizeof(FQuat));
+		writeBytes(fileData, pose.translations.GetData(), numBones * sizeof(FVector));
+		padTo16(fileData);
+	}
+
+	FMemory::Memcpy(fileData.GetData(), &header, sizeof(header));
+
+	if (!FFileHelper::SaveArrayToFile(fileData, *filePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't write the timeline to %s"), *filePath);
+		return false;
+	}
+	return true;
+}
+
+FTimelineFileView::FTimelineFileView() :
+	fileData(nullptr),
+	fileSize(0),
+	header(nullptr),
+	keyFrameTimes(nullptr),
+	poseData(nullptr),
+	fileIsMapped(false),
+	mappingHandle(nullptr)
+{
+}
+
+FTimelineFileView::~FTimelineFileView()
+{
+	close();
+}
+
+bool FTimelineFileView::open(const FString &filePath)
+{
+	close();
+
+	// Try to map the file first, only read it into memory if that doesn't work
+#if TIMELINE_FILE_CAN_MAP
+	FString fullPath = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*filePath);
+#if PLATFORM_WINDOWS
+	HANDLE fileHandle = CreateFileW(*fullPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER mappedSize;
+		HANDLE mapping = GetFileSizeEx(fileHandle, &mappedSize) && mappedSize.QuadPart > 0 ?
+			CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		if (mapping != nullptr)
+		{
+			const void *mappedData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (mappedData != nullptr)
+			{
+				fileData = static_cast<const uint8 *>(mappedData);
+				fileSize = mappedSize.QuadPart;
+				fileIsMapped = true;
+				mappingHandle = mapping;
+			}
+			else
+			{
+				CloseHandle(mapping);
+			}
+		}
+		// The mapping keeps the file open on its own
+		CloseHandle(fileHandle);
+	}
+#else
+	int fileDescriptor = ::open(TCHAR_TO_UTF8(*fullPath), O_RDONLY);
+	if (fileDescriptor >= 0)
+	{
+		struct stat fileStats;
+		if (fstat(fileDescriptor, &fileStats) == 0 && fileStats.st_size > 0)
+		{
+			void *mappedData = mmap(nullptr, fileStats.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+			if (mappedData != MAP_FAILED)
+			{
+				fileData = static_cast<const uint8 *>(mappedData);
+				fileSize = fileStats.st_size;
+				fileIsMapped = true;
+			}
+		}
+		// The mapping keeps the file open on its own
+		::close(fileDescriptor);
+	}
+#endif
+#endif
+
+	if (!fileIsMapped)
+	{
+		IFileHandle *fileHandle = FPlatformFileManager::Get().GetPlatformFile().OpenRead(*filePath);
+		if (fileHandle == nullptr)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Couldn't open timeline file %s"), *filePath);
+			return false;
+		}
+
+		fileBuffer.SetNumUninitialized(fileHandle->Size());
+		bool readSucceeded = fileHandle->Read(fileBuffer.GetData(), fileBuffer.Num());
+		delete fileHandle;
+
+		if (!readSucceeded)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Couldn't read timeline file %s"), *filePath);
+			fileBuffer.Empty();
+			return false;
+		}
+
+		fileData = fileBuffer.GetData();
+		fileSize = fileBuffer.Num();
+	}
+
+	// Make sure everything the header points at is actually in the file before trusting any of it. Sizes are checked
+	// against the space left after each offset so a corrupt header can't overflow the sum past the file length.
+	header = reinterpret_cast<const FTimelineFileHeader *>(fileData);
+	const uint64 poseStride = fileSize >= sizeof(FTimelineFileHeader) ? TimelineFile::getPoseStride(header->numBones) : 0;
+	bool fileIsValid = fileSize >= sizeof(FTimelineFileHeader) &&
+		header->magic == TIMELINE_FILE_MAGIC &&
+		header->version == TIMELINE_FILE_VERSION &&
+		header->boneNamesOffset <= header->keyFrameTimesOffset &&
+		header->keyFrameTimesOffset <= fileSize &&
+		header->numBones <= (header->keyFrameTimesOffset - header->boneNamesOffset) / sizeof(uint16) &&
+		header->keyFrameTimesOffset % 4 == 0 &&
+		header->numKeyFrames <= (fileSize - header->keyFrameTimesOffset) / sizeof(float) &&
+		header->poseDataOffset <= fileSize &&
+		header->poseDataOffset % 16 == 0 &&
+		(poseStride == 0 || header->numKeyFrames <= (fileSize - header->poseDataOffset) / poseStride);
+
+	if (fileIsValid)
+	{
+		boneNames.Reset(header->numBones);
+
+		const uint8 *nameData = fileData + header->boneNamesOffset;
+		const uint8 *nameDataEnd = fileData + header->keyFrameTimesOffset;
+		for (uint32 boneIndex = 0; boneIndex < header->numBones && fileIsValid; boneIndex++)
+		{
+			uint16 nameLength;
+			if (nameData + sizeof(nameLength) > nameDataEnd)
+			{
+				fileIsValid = false;
+				break;
+			}
+			FMemory::Memcpy(&nameLength, nameData, sizeof(nameLength));
+			nameData += sizeof(nameLength);
+
+			if (nameData + nameLength > nameDataEnd)
+			{
+				fileIsValid = false;
+				break;
+			}
+			FUTF8ToTCHAR boneName(reinterpret_cast<const ANSICHAR *>(nameData), nameLength);
+			boneNames.Add(FName(*FString(boneName.Length(), boneName.Get())));
+			nameData += nameLength;
+		}
+
+		// Timelines are searched by time, so the keys have to be real numbers in strictly ascending order
+		const float *times = reinterpret_cast<const float *>(fileData + header->keyFrameTimesOffset);
+		for (uint32 keyFrameIndex = 0; keyFrameIndex < header->numKeyFrames && fileIsValid; keyFrameIndex++)
+		{
+			fileIsValid = FMath::IsFinite(times[keyFrameIndex]) && (keyFrameIndex == 0 || times[keyFrameIndex - 1] < times[keyFrameIndex]);
+		}
+	}
+
+	if (!fileIsValid)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s isn't a valid timeline file"), *filePath);
+		close();
+		return false;
+	}
+
+	keyFrameTimes = reinterpret_cast<const float *>(fileData + header->keyFrameTimesOffset);
+	poseData = fileData + header->poseDataOffset;
+	return true;
+}
+
+void FTimelineFileView::close()
+{
+	releaseFileData();
+
+	fileData = nullptr;
+	fileSize = 0;
+	header = nullptr;
+	keyFrameTimes = nullptr;
+	poseData = nullptr;
+	boneNames.Reset();
+}
+
+void FTimelineFileView::releaseFileData()
+{
+	if (fileIsMapped)
+	{
+#if PLATFORM_WINDOWS
+		UnmapViewOfFile(fileData);
+		CloseHandle(mappingHandle);
+#elif TIMELINE_FILE_CAN_MAP
+		munmap(const_cast<uint8 *>(fileData), fileSize);
+#endif
+		fileIsMapped = false;
+		mappingHandle = nullptr;
+	}
+
+	fileBuffer.Empty();
+}
+
+const FQuat *FTimelineFileView::getRotations(int32 keyFrameIndex) const
+{
+	return reinterpret_cast<const FQuat *>(poseData + keyFrameIndex * TimelineFile::getPoseStride(header->numBones));
+}
+
+const FVector *FTimelineFileView::getTranslations(int32 keyFrameIndex) const
+{
+	return reinterpret_cast<const FVector *>(poseData + keyFrameIndex * TimelineFile::getPoseStride(header->numBones) + header->numBones * sizeof(FQuat));
+}
+
+void FTimelineFileView::readPose(int32 keyFrameIndex, FPoseBuffer &outPose) const
+{
+	outPose.setNumBones(numBones());
+	FMemory::Memcpy(outPose.rotations.GetData(), getRotations(keyFrameIndex), numBones() * sizeof(FQuat));
+	FMemory::Memcpy(outPose.translations.GetData(), getTranslations(keyFrameIndex), numBones() * sizeof(FVector));
+}
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "KeyframeTimeline.h"
+
+// Binary timeline files. Everything is little endian and every array starts on a 16 byte boundary so poses can be used
+// straight out of a mapped file.
+//
+//   header
+//   bone names        uint16 length + UTF-8 characters for each bone
+//   keyframe times    float per keyframe
+//   pose data         per keyframe: a quaternion per bone, then a translation per bone padded to 16 bytes
+#define TIMELINE_FILE_MAGIC 0x4E4C5450
+#define TIMELINE_FILE_VERSION 1
+
+struct FTimelineFileHeader
+{
+	uint32 magic;
+	uint32 version;
+	uint32 numBones;
+	uint32 numKeyFrames;
+	uint32 boneNamesOffset;
+	uint32 keyFrameTimesOffset;
+	uint64 poseDataOffset;
+};
+
+namespace TimelineFile
+{
+	// Write a timeline out to a file, the bone names give the order the poses are stored in
+	bool save(const FString &filePath, const TArray<FName> &boneNames, const FKeyframeTimeline &timeline);
+
+	// The number of bytes one keyframe's pose takes up in the file
+	uint64 getPoseStride(uint32 numBones);
+}
+
+// Read only view of a timeline file. The file is memory mapped where the platform allows it and read in one go
+// otherwise, either way keyframe poses are read in place without any per keyframe allocation.
+class FTimelineFileView
+{
+public:
+	FTimelineFileView();
+	~FTimelineFileView();
+
+	// Open and validate a timeline file, closing any file that was already open
+	bool open(const FString &filePath);
+
+	void close();
+
+	bool isOpen() const
+	{
+		return fileData != nullptr;
+	}
+
+	int32 numBones() const
+	{
+		return boneNames.Num();
+	}
+
+	int32 numKeyFrames() const
+	{
+		return header != nullptr ? header->numKeyFrames : 0;
+	}
+
+	const TArray<FName> &getBoneNames() const
+	{
+		return boneNames;
+	}
+
+	float getKeyFrameTime(int32 keyFrameIndex) const
+	{
+		return keyFrameTimes[keyFrameIndex];
+	}
+
+	// The stored pose of a keyframe, pointing straight into the file
+	const FQuat *getRotations(int32 keyFrameIndex) const;
+	const FVector *getTranslations(int32 keyFrameIndex) const;
+
+	// Copy a keyframe's pose into a pose buffer
+	void readPose(int32 keyFrameIndex, FPoseBuffer &outPose) const;
+
+private:
+	// Unmap or free the file's memory
+	void releaseFileData();
+
+	// The whole file
+	const uint8 *fileData;
+	uint64 fileSize;
+
+	// Pointers into the file
+	const FTimelineFileHeader *header;
+	const float *keyFrameTimes;
+	const uint8 *poseData;
+
+	// Bone names are turned into names once when the file is opened
+	TArray<FName> boneNames;
+
+	// Whether the file data is a mapping of the file rather than the buffer below
+	bool fileIsMapped;
+
+	// Platform handle for the mapping, only needed on platforms that keep one around
+	void *mappingHandle;
+
+	// Holds the file when it couldn't be mapped
+	TArray<uint8, TAlignedHeapAllocator<16>> fileBuffer;
+};
@@ -9,6 +9,6 @@ public class PoseCreatorEditorTarget : TargetRules
     {
 		Type = TargetType.Editor;
 
-        ExtraModuleNames.AddRange(new string[] { "PoseCreator" });
+        ExtraModuleNames.AddRange(new string[] { "PoseCreator", "PoseMathCore" });
     }
 }
@@ -0,0 +1,15 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class PoseMathCore : ModuleRules
+{
+	public PoseMathCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		// The math itself is plain C++ that never includes an engine header, Core is only there for the module boilerplate.
+		// The same sources build outside of Unreal through the CMakeLists.txt at the root of the repository.
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(new string[] { "Core" });
+	}
+}
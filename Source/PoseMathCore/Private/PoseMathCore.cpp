@@ -0,0 +1,410 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseMathCore.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define POSEMATHCORE_USE_SSE 1
+#include <xmmintrin.h>
+#else
+#define POSEMATHCORE_USE_SSE 0
+#endif
+
+namespace
+{
+	using namespace PoseMathCore;
+
+	const float radiansToDegrees = 57.2957795f;
+
+	// Four floats at a time, a quaternion or four translation floats. SSE where the platform has it and plain floats
+	// everywhere else.
+#if POSEMATHCORE_USE_SSE
+	typedef __m128 Float4;
+
+	inline Float4 load4(const float *floats) { return _mm_loadu_ps(floats); }
+	inline void store4(float *floats, const Float4 &value) { _mm_storeu_ps(floats, value); }
+	inline Float4 splat4(float value) { return _mm_set1_ps(value); }
+	inline Float4 subtract4(const Float4 &first, const Float4 &second) { return _mm_sub_ps(first, second); }
+	inline Float4 multiply4(const Float4 &first, const Float4 &second) { return _mm_mul_ps(first, second); }
+	inline Float4 multiplyAdd4(const Float4 &first, const Float4 &second, const Float4 &added) { return _mm_add_ps(_mm_mul_ps(first, second), added); }
+
+	// The four component dot product in every lane
+	inline Float4 dot4(const Float4 &first, const Float4 &second)
+	{
+		Float4 products = _mm_mul_ps(first, second);
+		Float4 pairs = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_add_ps(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+
+	// Flip the quaternion if it's in the opposite hemisphere of the reference so the blend takes the shortest path
+	inline Float4 alignToReference4(const Float4 &referenceQuat, const Float4 &quat)
+	{
+		return _mm_xor_ps(quat, _mm_and_ps(dot4(referenceQuat, quat), _mm_set1_ps(-0.0f)));
+	}
+
+	inline Float4 normalize4(const Float4 &quat)
+	{
+		return _mm_div_ps(quat, _mm_sqrt_ps(dot4(quat, quat)));
+	}
+#else
+	struct Float4
+	{
+		float lanes[4];
+	};
+
+	inline Float4 load4(const float *floats) { return Float4{ { floats[0], floats[1], floats[2], floats[3] } }; }
+	inline void store4(float *floats, const Float4 &value) { for (int32_t lane = 0; lane < 4; lane++) { floats[lane] = value.lanes[lane]; } }
+	inline Float4 splat4(float value) { return Float4{ { value, value, value, value } }; }
+
+	inline Float4 subtract4(const Float4 &first, const Float4 &second)
+	{
+		return Float4{ { first.lanes[0] - second.lanes[0], first.lanes[1] - second.lanes[1], first.lanes[2] - second.lanes[2], first.lanes[3] - second.lanes[3] } };
+	}
+
+	inline Float4 multiply4(const Float4 &first, const Float4 &second)
+	{
+		return Float4{ { first.lanes[0] * second.lanes[0], first.lanes[1] * second.lanes[1], first.lanes[2] * second.lanes[2], first.lanes[3] * second.lanes[3] } };
+	}
+
+	inline Float4 multiplyAdd4(const Float4 &first, const Float4 &second, const Float4 &added)
+	{
+		Float4 product = multiply4(first, second);
+		return Float4{ { product.lanes[0] + added.lanes[0], product.lanes[1] + added.lanes[1], product.lanes[2] + added.lanes[2], product.lanes[3] + added.lanes[3] } };
+	}
+
+	inline Float4 dot4(const Float4 &first, const Float4 &second)
+	{
+		Float4 product = multiply4(first, second);
+		return splat4(product.lanes[0] + product.lanes[1] + product.lanes[2] + product.lanes[3]);
+	}
+
+	inline Float4 alignToReference4(const Float4 &referenceQuat, const Float4 &quat)
+	{
+		return dot4(referenceQuat, quat).lanes[0] < 0.0f ? multiply4(quat, splat4(-1.0f)) : quat;
+	}
+
+	inline Float4 normalize4(const Float4 &quat)
+	{
+		return multiply4(quat, splat4(1.0f / std::sqrt(dot4(quat, quat).lanes[0])));
+	}
+#endif
+
+	inline const float *quatFloats(const Quat &quat)
+	{
+		return &quat.x;
+	}
+
+	inline float *quatFloats(Quat &quat)
+	{
+		return &quat.x;
+	}
+
+	// Translations are packed floats, so they can be treated as one flat float array and processed four floats at a
+	// time regardless of where one bone ends and the next begins
+	inline const float *translationFloats(const Vector3 *translations)
+	{
+		return &translations->x;
+	}
+
+	inline float *translationFloats(Vector3 *translations)
+	{
+		return &translations->x;
+	}
+
+	// Shortest path normalized lerp of two quaternions
+	inline Float4 nlerp4(const Float4 &first, const Float4 &second, const Float4 &alpha)
+	{
+		Float4 alignedSecond = alignToReference4(first, second);
+		return normalize4(multiplyAdd4(subtract4(alignedSecond, first), alpha, first));
+	}
+
+	void lerpTranslations(const ConstPoseView &firstPose, const ConstPoseView &secondPose, float alpha, const PoseView &outPose)
+	{
+		const float *firstFloats = translationFloats(firstPose.translations);
+		const float *secondFloats = translationFloats(secondPose.translations);
+		float *outFloats = translationFloats(outPose.translations);
+		const int32_t numFloats = firstPose.numBones * 3;
+
+		const Float4 alphaLanes = splat4(alpha);
+
+		int32_t floatIndex = 0;
+		for (; floatIndex + 4 <= numFloats; floatIndex += 4)
+		{
+			Float4 first = load4(firstFloats + floatIndex);
+			Float4 second = load4(secondFloats + floatIndex);
+			store4(outFloats + floatIndex, multiplyAdd4(subtract4(second, first), alphaLanes, first));
+		}
+		for (; floatIndex < numFloats; floatIndex++)
+		{
+			outFloats[floatIndex] = firstFloats[floatIndex] + (secondFloats[floatIndex] - firstFloats[floatIndex]) * alpha;
+		}
+	}
+}
+
+void PoseMathCore::blendTwoPoses(const ConstPoseView &firstPose, const ConstPoseView &secondPose, float alpha, const PoseView &outPose)
+{
+	const Float4 alphaLanes = splat4(alpha);
+	for (int32_t boneIndex = 0; boneIndex < firstPose.numBones; boneIndex++)
+	{
+		Float4 first = load4(quatFloats(firstPose.rotations[boneIndex]));
+		Float4 second = load4(quatFloats(secondPose.rotations[boneIndex]));
+		store4(quatFloats(outPose.rotations[boneIndex]), nlerp4(first, second, alphaLanes));
+	}
+
+	lerpTranslations(firstPose, secondPose, alpha, outPose);
+}
+
+void PoseMathCore::slerpTwoPoses(const ConstPoseView &firstPose, const ConstPoseView &secondPose, float alpha, const PoseView &outPose)
+{
+	for (int32_t boneIndex = 0; boneIndex < firstPose.numBones; boneIndex++)
+	{
+		outPose.rotations[boneIndex] = slerp(firstPose.rotations[boneIndex], secondPose.rotations[boneIndex], alpha);
+	}
+
+	lerpTranslations(firstPose, secondPose, alpha, outPose);
+}
+
+void PoseMathCore::blendWeightedPoses(const ConstPoseView *poses, const float *weights, int32_t numPoses, const PoseView &outPose)
+{
+	const int32_t numBones = poses[0].numBones;
+
+	float totalWeight = 0.0f;
+	for (int32_t poseIndex = 0; poseIndex < numPoses; poseIndex++)
+	{
+		totalWeight += weights[poseIndex];
+	}
+
+	// Nothing to blend, just hand back the first pose
+	if (totalWeight <= smallNumber)
+	{
+		for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			outPose.rotations[boneIndex] = poses[0].rotations[boneIndex];
+			outPose.translations[boneIndex] = poses[0].translations[boneIndex];
+		}
+		return;
+	}
+
+	const float inverseTotalWeight = 1.0f / totalWeight;
+	float *outFloats = translationFloats(outPose.translations);
+	const int32_t numFloats = numBones * 3;
+
+	// Start with the first pose's contribution, then accumulate the rest on top of it
+	{
+		const float scalarWeight = weights[0] * inverseTotalWeight;
+		const Float4 weight = splat4(scalarWeight);
+		for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			store4(quatFloats(outPose.rotations[boneIndex]), multiply4(load4(quatFloats(poses[0].rotations[boneIndex])), weight));
+		}
+
+		const float *floats = translationFloats(poses[0].translations);
+		int32_t floatIndex = 0;
+		for (; floatIndex + 4 <= numFloats; floatIndex += 4)
+		{
+			store4(outFloats + floatIndex, multiply4(load4(floats + floatIndex), weight));
+		}
+		for (; floatIndex < numFloats; floatIndex++)
+		{
+			outFloats[floatIndex] = floats[floatIndex] * scalarWeight;
+		}
+	}
+
+	const Quat *referenceRotations = poses[0].rotations;
+	for (int32_t poseIndex = 1; poseIndex < numPoses; poseIndex++)
+	{
+		const float scalarWeight = weights[poseIndex] * inverseTotalWeight;
+		if (scalarWeight == 0.0f)
+		{
+			continue;
+		}
+
+		const Float4 weight = splat4(scalarWeight);
+		const Quat *rotations = poses[poseIndex].rotations;
+		for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			Float4 rotation = alignToReference4(load4(quatFloats(referenceRotations[boneIndex])), load4(quatFloats(rotations[boneIndex])));
+			Float4 accumulated = load4(quatFloats(outPose.rotations[boneIndex]));
+			store4(quatFloats(outPose.rotations[boneIndex]), multiplyAdd4(rotation, weight, accumulated));
+		}
+
+		const float *floats = translationFloats(poses[poseIndex].translations);
+		int32_t floatIndex = 0;
+		for (; floatIndex + 4 <= numFloats; floatIndex += 4)
+		{
+			Float4 accumulated = load4(outFloats + floatIndex);
+			store4(outFloats + floatIndex, multiplyAdd4(load4(floats + floatIndex), weight, accumulated));
+		}
+		for (; floatIndex < numFloats; floatIndex++)
+		{
+			outFloats[floatIndex] += floats[floatIndex] * scalarWeight;
+		}
+	}
+
+	for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		store4(quatFloats(outPose.rotations[boneIndex]), normalize4(load4(quatFloats(outPose.rotations[boneIndex]))));
+	}
+}
+
+void PoseMathCore::computeSplineTangents(const ConstPoseView *previousPose, float previousTime, const ConstPoseView &pose, float time,
+	const ConstPoseView *nextPose, float nextTime, const PoseView &outTangents)
+{
+	const int32_t numBones = pose.numBones;
+
+	// A neighbour with a different skeleton can't shape the curve, treat it like the end of the timeline
+	if (previousPose != nullptr && (previousPose->numBones != numBones || previousTime >= time))
+	{
+		previousPose = nullptr;
+	}
+	if (nextPose != nullptr && (nextPose->numBones != numBones || nextTime <= time))
+	{
+		nextPose = nullptr;
+	}
+
+	// SQUAD control points, the ends of the timeline use the key itself which leaves the curve flat there
+	for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		const Quat &rotation = pose.rotations[boneIndex];
+		if (previousPose == nullptr || nextPose == nullptr)
+		{
+			outTangents.rotations[boneIndex] = rotation;
+			continue;
+		}
+
+		Quat inverseRotation = inverse(rotation);
+		Quat previousLog = quatLog(inverseRotation * alignToReference(rotation, previousPose->rotations[boneIndex]));
+		Quat nextLog = quatLog(inverseRotation * alignToReference(rotation, nextPose->rotations[boneIndex]));
+		outTangents.rotations[boneIndex] = normalized(rotation * quatExp((previousLog + nextLog) * -0.25f));
+	}
+
+	// Catmull-Rom tangents from the neighbouring keys, one sided at the ends of the timeline
+	const ConstPoseView &fromPose = previousPose != nullptr ? *previousPose : pose;
+	const ConstPoseView &toPose = nextPose != nullptr ? *nextPose : pose;
+	float fromTime = previousPose != nullptr ? previousTime : time;
+	float toTime = nextPose != nullptr ? nextTime : time;
+
+	if (previousPose == nullptr && nextPose == nullptr)
+	{
+		for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			outTangents.translations[boneIndex] = Vector3{ 0.0f, 0.0f, 0.0f };
+		}
+		return;
+	}
+
+	const float inverseDuration = 1.0f / (toTime - fromTime);
+	for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		outTangents.translations[boneIndex] = (toPose.translations[boneIndex] - fromPose.translations[boneIndex]) * inverseDuration;
+	}
+}
+
+void PoseMathCore::splineBlendPoses(const ConstPoseView &firstPose, const ConstPoseView &firstTangents, const ConstPoseView &secondPose,
+	const ConstPoseView &secondTangents, float alpha, float segmentDuration, const PoseView &outPose)
+{
+	const int32_t numBones = firstPose.numBones;
+
+	// SQUAD: blend between the keys and between their control points, then blend those two by 2t(1 - t)
+	const Float4 alphaLanes = splat4(alpha);
+	const Float4 controlAlphaLanes = splat4(2.0f * alpha * (1.0f - alpha));
+
+	for (int32_t boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		Float4 keyBlend = nlerp4(load4(quatFloats(firstPose.rotations[boneIndex])), load4(quatFloats(secondPose.rotations[boneIndex])), alphaLanes);
+		Float4 controlBlend = nlerp4(load4(quatFloats(firstTangents.rotations[boneIndex])), load4(quatFloats(secondTangents.rotations[boneIndex])), alphaLanes);
+		store4(quatFloats(outPose.rotations[boneIndex]), nlerp4(keyBlend, controlBlend, controlAlphaLanes));
+	}
+
+	// Cubic Hermite for the translations, the tangents are per second so they're scaled by the length of the segment
+	const float alphaSquared = alpha * alpha;
+	const float alphaCubed = alphaSquared * alpha;
+	const float firstWeight = 2.0f * alphaCubed - 3.0f * alphaSquared + 1.0f;
+	const float firstTangentWeight = (alphaCubed - 2.0f * alphaSquared + alpha) * segmentDuration;
+	const float secondWeight = -2.0f * alphaCubed + 3.0f * alphaSquared;
+	const float secondTangentWeight = (alphaCubed - alphaSquared) * segmentDuration;
+
+	const float *firstFloats = translationFloats(firstPose.translations);
+	const float *secondFloats = translationFloats(secondPose.translations);
+	const float *firstTangentFloats = translationFloats(firstTangents.translations);
+	const float *secondTangentFloats = translationFloats(secondTangents.translations);
+	float *outFloats = translationFloats(outPose.translations);
+	const int32_t numFloats = numBones * 3;
+
+	const Float4 firstWeightLanes = splat4(firstWeight);
+	const Float4 firstTangentWeightLanes = splat4(firstTangentWeight);
+	const Float4 secondWeightLanes = splat4(secondWeight);
+	const Float4 secondTangentWeightLanes = splat4(secondTangentWeight);
+
+	int32_t floatIndex = 0;
+	for (; floatIndex + 4 <= numFloats; floatIndex += 4)
+	{
+		Float4 result = multiply4(load4(firstFloats + floatIndex), firstWeightLanes);
+		result = multiplyAdd4(load4(firstTangentFloats + floatIndex), firstTangentWeightLanes, result);
+		result = multiplyAdd4(load4(secondFloats + floatIndex), secondWeightLanes, result);
+		result = multiplyAdd4(load4(secondTangentFloats + floatIndex), secondTangentWeightLanes, result);
+		store4(outFloats + floatIndex, result);
+	}
+	for (; floatIndex < numFloats; floatIndex++)
+	{
+		outFloats[floatIndex] = firstFloats[floatIndex] * firstWeight + firstTangentFloats[floatIndex] * firstTangentWeight +
+			secondFloats[floatIndex] * secondWeight + secondTangentFloats[floatIndex] * secondTangentWeight;
+	}
+}
+
+PoseMathCore::Quat PoseMathCore::dragBoneRotation(const Quat &startingRotation, const Vector3 &startingDirection, const Vector3 &currentDirection,
+	float twistRadians)
+{
+	Quat dragRotation = findBetweenNormals(startingDirection, currentDirection) * startingRotation;
+
+	// The trackpad twists the bone around the one axis dragging can't reach
+	return dragRotation * axisAngle(Vector3{ 1.0f, 0.0f, 0.0f }, twistRadians);
+}
+
+PoseMathCore::Quat PoseMathCore::twoHandRotation(const Quat &startingRotation, const Vector3 &startingHandsVector, const Vector3 &currentHandsVector)
+{
+	return findBetweenNormals(startingHandsVector, flattenHandsVector(currentHandsVector)) * startingRotation;
+}
+
+PoseMathCore::Vector3 PoseMathCore::flattenHandsVector(const Vector3 &handsVector)
+{
+	return safeNormal(Vector3{ handsVector.x, handsVector.y, 0.0f });
+}
+
+void PoseMathCore::gatherBoneTrack(const ConstPoseView *poses, int32_t numPoses, int32_t boneIndex, Vector3 *outPositionKeys, Quat *outRotationKeys)
+{
+	for (int32_t poseIndex = 0; poseIndex < numPoses; poseIndex++)
+	{
+		outPositionKeys[poseIndex] = poses[poseIndex].translations[boneIndex];
+		outRotationKeys[poseIndex] = poses[poseIndex].rotations[boneIndex];
+	}
+}
+
+bool PoseMathCore::isConstantPositionTrack(const Vector3 *keys, int32_t numKeys, float tolerance, float &outMaxError)
+{
+	outMaxError = 0.0f;
+	for (int32_t keyIndex = 1; keyIndex < numKeys; keyIndex++)
+	{
+		float keyError = distance(keys[0], keys[keyIndex]);
+		if (keyError > tolerance)
+		{
+			return false;
+		}
+		outMaxError = keyError > outMaxError ? keyError : outMaxError;
+	}
+	return true;
+}
+
+bool PoseMathCore::isConstantRotationTrack(const Quat *keys, int32_t numKeys, float toleranceDegrees, float &outMaxErrorDegrees)
+{
+	outMaxErrorDegrees = 0.0f;
+	for (int32_t keyIndex = 1; keyIndex < numKeys; keyIndex++)
+	{
+		float keyErrorDegrees = angularDistance(keys[0], keys[keyIndex]) * radiansToDegrees;
+		if (keyErrorDegrees > toleranceDegrees)
+		{
+			return false;
+		}
+		outMaxErrorDegrees = keyErrorDegrees > outMaxErrorDegrees ? keyErrorDegrees : outMaxErrorDegrees;
+	}
+	return true;
+}
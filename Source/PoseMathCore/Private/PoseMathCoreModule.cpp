@@ -0,0 +1,6 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ModuleManager.h"
+
+// The only engine code in the module, the CMake build leaves this file out
+IMPLEMENT_MODULE(FDefaultModuleImpl, PoseMathCore);
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PoseMathTypes.h"
+
+// The posing math that doesn't need the engine: pose blending kernels, controller driven bone rotations and export
+// track building. It only works on plain arrays, so it builds and runs on its own with the CMakeLists.txt at the
+// root of the repository, where it's unit tested and benchmarked without starting Unreal.
+namespace PoseMathCore
+{
+	// A pose's bone rotations and translations, entry i of each array belongs to bone i
+	struct ConstPoseView
+	{
+		const Quat *rotations;
+		const Vector3 *translations;
+		int32_t numBones;
+	};
+
+	struct PoseView
+	{
+		Quat *rotations;
+		Vector3 *translations;
+		int32_t numBones;
+
+		operator ConstPoseView() const
+		{
+			return ConstPoseView{ rotations, translations, numBones };
+		}
+	};
+
+	// Blend from the first pose to the second one with shortest path normalized lerps, alpha of 0 gives the first pose
+	// and 1 gives the second. The output must already hold as many bones as the inputs and may be one of them.
+	void blendTwoPoses(const ConstPoseView &firstPose, const ConstPoseView &secondPose, float alpha, const PoseView &outPose);
+
+	// The same with spherical lerps, constant angular velocity but noticeably more expensive
+	void slerpTwoPoses(const ConstPoseView &firstPose, const ConstPoseView &secondPose, float alpha, const PoseView &outPose);
+
+	// Weighted blend of any number of poses. Weights are normalized, rotations are blended along the shortest path
+	// relative to the first pose. The output must not be one of the inputs.
+	void blendWeightedPoses(const ConstPoseView *poses, const float *weights, int32_t numPoses, const PoseView &outPose);
+
+	// Work out the spline tangents of a keyframe from its neighbours, either of which may be null at the ends of the
+	// timeline. Rotations get the SQUAD control quaternion and translations the Catmull-Rom tangent per second.
+	void computeSplineTangents(const ConstPoseView *previousPose, float previousTime, const ConstPoseView &pose, float time,
+		const ConstPoseView *nextPose, float nextTime, const PoseView &outTangents);
+
+	// Spline blend between two keyframes using their tangents from computeSplineTangents, the segment duration is the
+	// time between the keyframes. SQUAD is evaluated with normalized lerps so it stays about as cheap as the linear blend.
+	// The output must not be one of the inputs.
+	void splineBlendPoses(const ConstPoseView &firstPose, const ConstPoseView &firstTangents, const ConstPoseView &secondPose,
+		const ConstPoseView &secondTangents, float alpha, float segmentDuration, const PoseView &outPose);
+
+	// The rotation of a dragged bone. The bone starts out with the starting rotation and pointing along the starting
+	// direction, and is turned to point along the current direction before being twisted around its own forward axis.
+	// Both directions must be normalized.
+	Quat dragBoneRotation(const Quat &startingRotation, const Vector3 &startingDirection, const Vector3 &currentDirection, float twistRadians);
+
+	// The rotation of the whole mesh as the vector between the two controllers turns around the vertical axis. The
+	// starting vector must already be flattened and normalized, the current one is flattened here.
+	Quat twoHandRotation(const Quat &startingRotation, const Vector3 &startingHandsVector, const Vector3 &currentHandsVector);
+
+	// Flatten the vector between the two controllers onto the ground and normalize it
+	Vector3 flattenHandsVector(const Vector3 &handsVector);
+
+	// Copy one bone out of every pose into its export track, the key arrays hold a key per pose
+	void gatherBoneTrack(const ConstPoseView *poses, int32_t numPoses, int32_t boneIndex, Vector3 *outPositionKeys, Quat *outRotationKeys);
+
+	// Whether every key is within the tolerance of the first one, which lets the track collapse to a single key. The
+	// largest difference is handed back when it is.
+	bool isConstantPositionTrack(const Vector3 *keys, int32_t numKeys, float tolerance, float &outMaxError);
+	bool isConstantRotationTrack(const Quat *keys, int32_t numKeys, float toleranceDegrees, float &outMaxErrorDegrees);
+}
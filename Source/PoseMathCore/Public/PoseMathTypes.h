@@ -0,0 +1,222 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// The few vector and quaternion operations the pose math needs. The types are laid out exactly like the engine's
+// FVector and FQuat so engine arrays can be handed to the pose math without copying, and the operations give the
+// same answers as their engine counterparts. Nothing in here depends on Unreal.
+namespace PoseMathCore
+{
+	struct Vector3
+	{
+		float x;
+		float y;
+		float z;
+	};
+
+	// Rotation quaternion, x, y and z are the imaginary part and w the real part
+	struct Quat
+	{
+		float x;
+		float y;
+		float z;
+		float w;
+	};
+
+	// Lengths and sines below this are treated as zero
+	const float smallNumber = 1e-8f;
+
+	inline Vector3 operator+(const Vector3 &first, const Vector3 &second)
+	{
+		return Vector3{ first.x + second.x, first.y + second.y, first.z + second.z };
+	}
+
+	inline Vector3 operator-(const Vector3 &first, const Vector3 &second)
+	{
+		return Vector3{ first.x - second.x, first.y - second.y, first.z - second.z };
+	}
+
+	inline Vector3 operator*(const Vector3 &vector, float scale)
+	{
+		return Vector3{ vector.x * scale, vector.y * scale, vector.z * scale };
+	}
+
+	inline float dot(const Vector3 &first, const Vector3 &second)
+	{
+		return first.x * second.x + first.y * second.y + first.z * second.z;
+	}
+
+	inline Vector3 cross(const Vector3 &first, const Vector3 &second)
+	{
+		return Vector3{ first.y * second.z - first.z * second.y, first.z * second.x - first.x * second.z, first.x * second.y - first.y * second.x };
+	}
+
+	inline float length(const Vector3 &vector)
+	{
+		return std::sqrt(dot(vector, vector));
+	}
+
+	inline float distance(const Vector3 &first, const Vector3 &second)
+	{
+		return length(first - second);
+	}
+
+	// The vector scaled to unit length, or zero if it's too short to have a direction
+	inline Vector3 safeNormal(const Vector3 &vector)
+	{
+		const float squaredLength = dot(vector, vector);
+		if (squaredLength < smallNumber)
+		{
+			return Vector3{ 0.0f, 0.0f, 0.0f };
+		}
+		return vector * (1.0f / std::sqrt(squaredLength));
+	}
+
+	inline Quat identityQuat()
+	{
+		return Quat{ 0.0f, 0.0f, 0.0f, 1.0f };
+	}
+
+	// Rotation by an angle in radians around a normalized axis
+	inline Quat axisAngle(const Vector3 &axis, float angleRadians)
+	{
+		const float halfAngle = angleRadians * 0.5f;
+		const float sine = std::sin(halfAngle);
+		return Quat{ axis.x * sine, axis.y * sine, axis.z * sine, std::cos(halfAngle) };
+	}
+
+	inline Quat operator+(const Quat &first, const Quat &second)
+	{
+		return Quat{ first.x + second.x, first.y + second.y, first.z + second.z, first.w + second.w };
+	}
+
+	inline Quat operator*(const Quat &quat, float scale)
+	{
+		return Quat{ quat.x * scale, quat.y * scale, quat.z * scale, quat.w * scale };
+	}
+
+	// Rotating by the product is rotating by the second quaternion and then by the first, like FQuat
+	inline Quat operator*(const Quat &first, const Quat &second)
+	{
+		return Quat{
+			first.w * second.x + first.x * second.w + first.y * second.z - first.z * second.y,
+			first.w * second.y - first.x * second.z + first.y * second.w + first.z * second.x,
+			first.w * second.z + first.x * second.y - first.y * second.x + first.z * second.w,
+			first.w * second.w - first.x * second.x - first.y * second.y - first.z * second.z };
+	}
+
+	inline float dot(const Quat &first, const Quat &second)
+	{
+		return first.x * second.x + first.y * second.y + first.z * second.z + first.w * second.w;
+	}
+
+	// Inverse of a unit quaternion
+	inline Quat inverse(const Quat &quat)
+	{
+		return Quat{ -quat.x, -quat.y, -quat.z, quat.w };
+	}
+
+	// The quaternion scaled to unit length, or the identity if it's too short to be a rotation
+	inline Quat normalized(const Quat &quat)
+	{
+		const float squaredLength = dot(quat, quat);
+		if (squaredLength < smallNumber)
+		{
+			return identityQuat();
+		}
+		return quat * (1.0f / std::sqrt(squaredLength));
+	}
+
+	inline Vector3 rotateVector(const Quat &quat, const Vector3 &vector)
+	{
+		const Vector3 imaginary{ quat.x, quat.y, quat.z };
+		const Vector3 twiceCross = cross(imaginary, vector) * 2.0f;
+		return vector + twiceCross * quat.w + cross(imaginary, twiceCross);
+	}
+
+	// Flip the quaternion into the same hemisphere as the reference so blends between them take the shortest path
+	inline Quat alignToReference(const Quat &referenceQuat, const Quat &quat)
+	{
+		return dot(referenceQuat, quat) < 0.0f ? quat * -1.0f : quat;
+	}
+
+	// Shortest path normalized lerp
+	inline Quat nlerp(const Quat &first, const Quat &second, float alpha)
+	{
+		return normalized(first * (1.0f - alpha) + alignToReference(first, second) * alpha);
+	}
+
+	// Shortest path spherical lerp, the same as FQuat::Slerp
+	inline Quat slerp(const Quat &first, const Quat &second, float alpha)
+	{
+		const float rawCosine = dot(first, second);
+		const float cosine = rawCosine >= 0.0f ? rawCosine : -rawCosine;
+
+		float firstScale = 1.0f - alpha;
+		float secondScale = alpha;
+		if (cosine < 0.9999f)
+		{
+			const float omega = std::acos(cosine);
+			const float inverseSine = 1.0f / std::sin(omega);
+			firstScale = std::sin((1.0f - alpha) * omega) * inverseSine;
+			secondScale = std::sin(alpha * omega) * inverseSine;
+		}
+		secondScale = rawCosine >= 0.0f ? secondScale : -secondScale;
+
+		return normalized(first * firstScale + second * secondScale);
+	}
+
+	// Angle in radians between two unit rotations
+	inline float angularDistance(const Quat &first, const Quat &second)
+	{
+		const float innerProduct = dot(first, second);
+		const float cosine = 2.0f * innerProduct * innerProduct - 1.0f;
+		return std::acos(cosine > 1.0f ? 1.0f : (cosine < -1.0f ? -1.0f : cosine));
+	}
+
+	// Shortest rotation turning one normalized direction into another, the same as FQuat::FindBetweenNormals
+	inline Quat findBetweenNormals(const Vector3 &from, const Vector3 &to)
+	{
+		const float w = 1.0f + dot(from, to);
+		if (w >= 1e-6f)
+		{
+			const Vector3 axis = cross(from, to);
+			return normalized(Quat{ axis.x, axis.y, axis.z, w });
+		}
+
+		// Opposite directions, turn half way around any axis perpendicular to the first one
+		return std::fabs(from.x) > std::fabs(from.y) ? normalized(Quat{ -from.z, 0.0f, from.x, 0.0f }) : normalized(Quat{ 0.0f, -from.z, from.y, 0.0f });
+	}
+
+	// Quaternion logarithm of a unit quaternion, the same as FQuat::Log
+	inline Quat quatLog(const Quat &quat)
+	{
+		if (std::fabs(quat.w) < 1.0f)
+		{
+			const float angle = std::acos(quat.w);
+			const float sine = std::sin(angle);
+			if (std::fabs(sine) >= smallNumber)
+			{
+				const float scale = angle / sine;
+				return Quat{ quat.x * scale, quat.y * scale, quat.z * scale, 0.0f };
+			}
+		}
+		return Quat{ quat.x, quat.y, quat.z, 0.0f };
+	}
+
+	// Quaternion exponential of a pure quaternion, the same as FQuat::Exp
+	inline Quat quatExp(const Quat &quat)
+	{
+		const float angle = std::sqrt(quat.x * quat.x + quat.y * quat.y + quat.z * quat.z);
+		const float sine = std::sin(angle);
+		if (std::fabs(sine) >= smallNumber)
+		{
+			const float scale = sine / angle;
+			return Quat{ quat.x * scale, quat.y * scale, quat.z * scale, std::cos(angle) };
+		}
+		return Quat{ quat.x, quat.y, quat.z, std::cos(angle) };
+	}
+}
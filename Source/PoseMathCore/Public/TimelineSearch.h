@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <cstdint>
+
+// Searching keyframes sorted by time. The keys are read through getTime(index) so the search works on however the
+// caller stores them.
+namespace PoseMathCore
+{
+	// Index of the first key at or after the given time, the number of keys if there is none
+	template<typename GetTimeFunction>
+	int32_t lowerBound(int32_t numKeys, float time, const GetTimeFunction &getTime)
+	{
+		int32_t first = 0;
+		int32_t count = numKeys;
+
+		while (count > 0)
+		{
+			int32_t half = count / 2;
+			if (getTime(first + half) < time)
+			{
+				first += half + 1;
+				count -= half + 1;
+			}
+			else
+			{
+				count = half;
+			}
+		}
+
+		return first;
+	}
+
+	// Whether the lower bound of the given time is the given index
+	template<typename GetTimeFunction>
+	bool isLowerBound(int32_t keyIndex, int32_t numKeys, float time, const GetTimeFunction &getTime)
+	{
+		if (keyIndex < 0 || keyIndex > numKeys)
+		{
+			return false;
+		}
+
+		bool previousIsBefore = keyIndex == 0 || getTime(keyIndex - 1) < time;
+		bool currentIsAtOrAfter = keyIndex == numKeys || getTime(keyIndex) >= time;
+		return previousIsBefore && currentIsAtOrAfter;
+	}
+
+	// Move a cursor holding the last lower bound found to the lower bound of the given time. Playback and small scrubs
+	// land on the same key as last time or one of its neighbours, so those are checked before falling back to a
+	// binary search.
+	template<typename GetTimeFunction>
+	int32_t moveCursor(int32_t cursor, int32_t numKeys, float time, const GetTimeFunction &getTime)
+	{
+		if (isLowerBound(cursor, numKeys, time, getTime))
+		{
+			return cursor;
+		}
+		if (isLowerBound(cursor + 1, numKeys, time, getTime))
+		{
+			return cursor + 1;
+		}
+		if (isLowerBound(cursor - 1, numKeys, time, getTime))
+		{
+			return cursor - 1;
+		}
+		return lowerBound(numKeys, time, getTime);
+	}
+}
@@ -0,0 +1,339 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PoseMathCore.h"
+#include "TimelineSearch.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace PoseMathCore;
+
+// Unit tests for the engine independent pose math, run by ctest. Every check runs even after one fails so a single run
+// shows everything that's wrong.
+namespace
+{
+	const float halfPi = 1.57079632679f;
+	const float degreesToRadians = 0.0174532925f;
+	const Vector3 forwardVector{ 1.0f, 0.0f, 0.0f };
+	const Vector3 rightVector{ 0.0f, 1.0f, 0.0f };
+	const Vector3 upVector{ 0.0f, 0.0f, 1.0f };
+
+	int numFailures = 0;
+
+	void checkResult(bool passed, const char *checkName)
+	{
+		if (!passed)
+		{
+			std::printf("Check failed: %s\n", checkName);
+			numFailures++;
+		}
+	}
+
+	bool vectorsMatch(const Vector3 &first, const Vector3 &second, float tolerance = 1e-4f)
+	{
+		return std::fabs(first.x - second.x) <= tolerance && std::fabs(first.y - second.y) <= tolerance && std::fabs(first.z - second.z) <= tolerance;
+	}
+
+	bool rotationsMatch(const Quat &first, const Quat &second, float toleranceDegrees = 0.01f)
+	{
+		return angularDistance(normalized(first), normalized(second)) <= toleranceDegrees * degreesToRadians;
+	}
+
+	// Rotation from yaw, pitch and roll in degrees, only used to make test rotations that aren't axis aligned
+	Quat makeRotation(float yawDegrees, float pitchDegrees, float rollDegrees)
+	{
+		return axisAngle(upVector, yawDegrees * degreesToRadians) * axisAngle(rightVector, pitchDegrees * degreesToRadians) *
+			axisAngle(forwardVector, rollDegrees * degreesToRadians);
+	}
+
+	struct TestPose
+	{
+		explicit TestPose(int32_t numBones) :
+			rotations(numBones, identityQuat()),
+			translations(numBones, Vector3{ 0.0f, 0.0f, 0.0f })
+		{
+		}
+
+		PoseView view()
+		{
+			return PoseView{ rotations.data(), translations.data(), (int32_t)rotations.size() };
+		}
+
+		ConstPoseView view() const
+		{
+			return ConstPoseView{ rotations.data(), translations.data(), (int32_t)rotations.size() };
+		}
+
+		std::vector<Quat> rotations;
+		std::vector<Vector3> translations;
+	};
+
+	bool posesMatch(const TestPose &first, const TestPose &second, float toleranceDegrees = 0.01f, float tolerance = 1e-4f)
+	{
+		if (first.rotations.size() != second.rotations.size())
+		{
+			return false;
+		}
+
+		for (size_t boneIndex = 0; boneIndex < first.rotations.size(); boneIndex++)
+		{
+			if (!rotationsMatch(first.rotations[boneIndex], second.rotations[boneIndex], toleranceDegrees) ||
+				!vectorsMatch(first.translations[boneIndex], second.translations[boneIndex], tolerance))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void testMathTypes()
+	{
+		const Quat quarterTurn = axisAngle(upVector, halfPi);
+		checkResult(vectorsMatch(rotateVector(quarterTurn, forwardVector), rightVector), "Quarter turn around up turns forward to right");
+		checkResult(vectorsMatch(rotateVector(inverse(quarterTurn) * quarterTurn, forwardVector), forwardVector), "Inverse undoes a rotation");
+		checkResult(vectorsMatch(rotateVector(axisAngle(forwardVector, halfPi) * quarterTurn, forwardVector), upVector),
+			"Products rotate by the second quaternion first");
+
+		checkResult(vectorsMatch(rotateVector(findBetweenNormals(forwardVector, upVector), forwardVector), upVector), "Find between normals");
+		const Vector3 backwardVector{ -1.0f, 0.0f, 0.0f };
+		checkResult(vectorsMatch(rotateVector(findBetweenNormals(forwardVector, backwardVector), forwardVector), backwardVector),
+			"Find between opposite normals");
+
+		const Quat rotation = makeRotation(30.0f, 45.0f, 10.0f);
+		checkResult(rotationsMatch(quatExp(quatLog(rotation)), rotation), "Log and exp round trip");
+		checkResult(rotationsMatch(slerp(identityQuat(), quarterTurn, 0.5f), axisAngle(upVector, halfPi * 0.5f)), "Slerp halfway");
+		checkResult(rotationsMatch(nlerp(identityQuat(), quarterTurn * -1.0f, 0.5f), axisAngle(upVector, halfPi * 0.5f)),
+			"Nlerp takes the shortest path");
+		checkResult(std::fabs(angularDistance(identityQuat(), quarterTurn) - halfPi) < 1e-4f, "Angular distance");
+		checkResult(vectorsMatch(safeNormal(Vector3{ 0.0f, 0.0f, 0.0f }), Vector3{ 0.0f, 0.0f, 0.0f }), "Safe normal of zero");
+	}
+
+	void testControllerMath()
+	{
+		// Dragging a bone without moving or twisting it leaves it alone
+		const Quat startingRotation = makeRotation(30.0f, 45.0f, 10.0f);
+		checkResult(rotationsMatch(dragBoneRotation(startingRotation, forwardVector, forwardVector, 0.0f), startingRotation), "Drag without moving");
+
+		// Dragging forward to up turns the forward axis up
+		Quat draggedRotation = dragBoneRotation(identityQuat(), forwardVector, upVector, 0.0f);
+		checkResult(vectorsMatch(rotateVector(draggedRotation, forwardVector), upVector), "Drag forward to up");
+
+		// Twisting only spins around the bone's own forward axis, so the forward axis stays put
+		Quat twistedRotation = dragBoneRotation(identityQuat(), forwardVector, forwardVector, halfPi);
+		checkResult(vectorsMatch(rotateVector(twistedRotation, forwardVector), forwardVector) &&
+			vectorsMatch(rotateVector(twistedRotation, rightVector), upVector), "Drag twist");
+
+		// Dragging there and back again, twisting and untwisting, ends up where it started
+		const Vector3 otherDirection = safeNormal(Vector3{ 1.0f, -2.0f, 0.5f });
+		Quat thereRotation = dragBoneRotation(startingRotation, forwardVector, otherDirection, 0.3f);
+		Quat untwistedRotation = thereRotation * axisAngle(forwardVector, -0.3f);
+		checkResult(rotationsMatch(dragBoneRotation(untwistedRotation, otherDirection, forwardVector, 0.0f), startingRotation), "Drag round trip");
+
+		// Turning the hands a quarter turn around the vertical axis turns the mesh with them, height is ignored
+		checkResult(rotationsMatch(twoHandRotation(identityQuat(), forwardVector, Vector3{ 0.0f, 3.0f, 5.0f }), axisAngle(upVector, halfPi)),
+			"Two hand quarter turn");
+		checkResult(rotationsMatch(twoHandRotation(startingRotation, forwardVector, Vector3{ 2.0f, 0.0f, -1.0f }), startingRotation),
+			"Two hand without turning");
+		checkResult(vectorsMatch(flattenHandsVector(Vector3{ 3.0f, 4.0f, 7.0f }), Vector3{ 0.6f, 0.8f, 0.0f }), "Flatten hands vector");
+	}
+
+	void testTimelineSearch()
+	{
+		const float times[] = { 0.0f, 1.0f, 2.5f, 4.0f };
+		auto getTime = [&times](int32_t keyIndex) { return times[keyIndex]; };
+
+		checkResult(lowerBound(4, -1.0f, getTime) == 0, "Lower bound before the first key");
+		checkResult(lowerBound(4, 1.0f, getTime) == 1, "Lower bound at a key");
+		checkResult(lowerBound(4, 1.5f, getTime) == 2, "Lower bound between keys");
+		checkResult(lowerBound(4, 5.0f, getTime) == 4, "Lower bound past the last key");
+		checkResult(lowerBound(0, 1.0f, getTime) == 0, "Lower bound without keys");
+
+		checkResult(moveCursor(1, 4, 0.5f, getTime) == 1, "Cursor stays put");
+		checkResult(moveCursor(1, 4, 2.0f, getTime) == 2, "Cursor steps forward");
+		checkResult(moveCursor(2, 4, 0.5f, getTime) == 1, "Cursor steps back");
+		checkResult(moveCursor(0, 4, 3.0f, getTime) == 3, "Cursor jumps");
+		checkResult(moveCursor(3, 4, 10.0f, getTime) == 4, "Cursor runs off the end");
+		checkResult(moveCursor(7, 4, 0.5f, getTime) == 1, "Cursor out of range");
+	}
+
+	void testBlending()
+	{
+		// Two bones, the second pose turned a quarter turn around up and moved along forward
+		TestPose firstPose(2);
+		TestPose secondPose(2);
+		TestPose halfwayPose(2);
+		for (int32_t boneIndex = 0; boneIndex < 2; boneIndex++)
+		{
+			firstPose.translations[boneIndex] = Vector3{ 0.0f, 0.0f, 10.0f * boneIndex };
+			secondPose.rotations[boneIndex] = axisAngle(upVector, halfPi);
+			secondPose.translations[boneIndex] = Vector3{ 10.0f, 0.0f, 10.0f * boneIndex };
+			halfwayPose.rotations[boneIndex] = axisAngle(upVector, halfPi * 0.5f);
+			halfwayPose.translations[boneIndex] = Vector3{ 5.0f, 0.0f, 10.0f * boneIndex };
+		}
+
+		TestPose blendedPose(2);
+		blendTwoPoses(firstPose.view(), secondPose.view(), 0.0f, blendedPose.view());
+		checkResult(posesMatch(blendedPose, firstPose), "Blend at zero");
+		blendTwoPoses(firstPose.view(), secondPose.view(), 1.0f, blendedPose.view());
+		checkResult(posesMatch(blendedPose, secondPose), "Blend at one");
+		blendTwoPoses(firstPose.view(), secondPose.view(), 0.5f, blendedPose.view());
+		checkResult(posesMatch(blendedPose, halfwayPose), "Blend halfway");
+		slerpTwoPoses(firstPose.view(), secondPose.view(), 0.5f, blendedPose.view());
+		checkResult(posesMatch(blendedPose, halfwayPose), "Slerp blend halfway");
+
+		// The output may be one of the inputs
+		TestPose inPlacePose = firstPose;
+		blendTwoPoses(inPlacePose.view(), secondPose.view(), 0.5f, inPlacePose.view());
+		checkResult(posesMatch(inPlacePose, halfwayPose), "Blend in place");
+
+		// Five bones leaves translation floats that don't fill a whole group of four
+		TestPose firstLongPose(5);
+		TestPose secondLongPose(5);
+		TestPose expectedLongPose(5);
+		for (int32_t boneIndex = 0; boneIndex < 5; boneIndex++)
+		{
+			secondLongPose.translations[boneIndex] = Vector3{ 4.0f * boneIndex, -2.0f, 8.0f };
+			expectedLongPose.translations[boneIndex] = Vector3{ 1.0f * boneIndex, -0.5f, 2.0f };
+		}
+		TestPose blendedLongPose(5);
+		blendTwoPoses(firstLongPose.view(), secondLongPose.view(), 0.25f, blendedLongPose.view());
+		checkResult(posesMatch(blendedLongPose, expectedLongPose), "Blend every translation float");
+
+		// Equal weights are the halfway blend, and weights don't have to add up to one
+		const ConstPoseView weightedPoses[] = { firstPose.view(), secondPose.view() };
+		const float equalWeights[] = { 2.0f, 2.0f };
+		blendWeightedPoses(weightedPoses, equalWeights, 2, blendedPose.view());
+		checkResult(posesMatch(blendedPose, halfwayPose), "Weighted blend with equal weights");
+		const float noWeights[] = { 0.0f, 0.0f };
+		blendWeightedPoses(weightedPoses, noWeights, 2, blendedPose.view());
+		checkResult(posesMatch(blendedPose, firstPose), "Weighted blend without weights");
+	}
+
+	// Two bone pose turned around up and moved along forward by the same amount
+	TestPose makeTurnedPose(float amount)
+	{
+		TestPose pose(2);
+		for (int32_t boneIndex = 0; boneIndex < 2; boneIndex++)
+		{
+			pose.rotations[boneIndex] = axisAngle(upVector, amount * degreesToRadians);
+			pose.translations[boneIndex] = Vector3{ amount, 0.0f, 10.0f * boneIndex };
+		}
+		return pose;
+	}
+
+	// Spline between the middle two of four keys a second apart, turned and moved by the given amounts. Checks the
+	// sample at alpha against the expected amount, or against the linear blend if there isn't one.
+	void checkSplineSamples(const float *amounts, float alpha, const float *expectedAmount, const char *checkName)
+	{
+		std::vector<TestPose> keys;
+		std::vector<ConstPoseView> keyViews;
+		for (int32_t keyIndex = 0; keyIndex < 4; keyIndex++)
+		{
+			keys.push_back(makeTurnedPose(amounts[keyIndex]));
+		}
+		for (const TestPose &key : keys)
+		{
+			keyViews.push_back(key.view());
+		}
+
+		TestPose firstTangents(2);
+		TestPose secondTangents(2);
+		computeSplineTangents(&keyViews[0], 0.0f, keyViews[1], 1.0f, &keyViews[2], 2.0f, firstTangents.view());
+		computeSplineTangents(&keyViews[1], 1.0f, keyViews[2], 2.0f, &keyViews[3], 3.0f, secondTangents.view());
+
+		TestPose splinePose(2);
+		splineBlendPoses(keyViews[1], firstTangents.view(), keyViews[2], secondTangents.view(), alpha, 1.0f, splinePose.view());
+
+		TestPose expectedPose(2);
+		if (expectedAmount != nullptr)
+		{
+			expectedPose = makeTurnedPose(*expectedAmount);
+		}
+		else
+		{
+			blendTwoPoses(keyViews[1], keyViews[2], alpha, expectedPose.view());
+		}
+		checkResult(posesMatch(splinePose, expectedPose, 0.01f, 1e-3f), checkName);
+	}
+
+	void testSplines()
+	{
+		TestPose firstPose(2);
+		TestPose secondPose(2);
+		for (int32_t boneIndex = 0; boneIndex < 2; boneIndex++)
+		{
+			firstPose.rotations[boneIndex] = makeRotation(10.0f, 20.0f, 0.0f);
+			firstPose.translations[boneIndex] = Vector3{ 0.0f, 0.0f, 10.0f * boneIndex };
+			secondPose.rotations[boneIndex] = makeRotation(80.0f, -10.0f, 30.0f);
+			secondPose.translations[boneIndex] = Vector3{ 10.0f, 0.0f, 10.0f * boneIndex };
+		}
+
+		// A lone key has nowhere to go, its tangents are flat
+		TestPose firstTangents(2);
+		computeSplineTangents(nullptr, 0.0f, firstPose.view(), 0.0f, nullptr, 0.0f, firstTangents.view());
+		checkResult(rotationsMatch(firstTangents.rotations[1], firstPose.rotations[1]) &&
+			vectorsMatch(firstTangents.translations[1], Vector3{ 0.0f, 0.0f, 0.0f }), "Lone key tangents");
+
+		// At the ends of the timeline the translation tangent is one sided
+		const ConstPoseView firstView = firstPose.view();
+		const ConstPoseView secondView = secondPose.view();
+		TestPose secondTangents(2);
+		computeSplineTangents(nullptr, 0.0f, firstPose.view(), 0.0f, &secondView, 2.0f, firstTangents.view());
+		computeSplineTangents(&firstView, 0.0f, secondPose.view(), 2.0f, nullptr, 0.0f, secondTangents.view());
+		checkResult(vectorsMatch(firstTangents.translations[0], Vector3{ 5.0f, 0.0f, 0.0f }) &&
+			vectorsMatch(secondTangents.translations[0], Vector3{ 5.0f, 0.0f, 0.0f }), "End key tangents");
+
+		// Splines pass through every key
+		TestPose splinePose(2);
+		splineBlendPoses(firstPose.view(), firstTangents.view(), secondPose.view(), secondTangents.view(), 0.0f, 2.0f, splinePose.view());
+		checkResult(posesMatch(splinePose, firstPose), "Spline at first key");
+		splineBlendPoses(firstPose.view(), firstTangents.view(), secondPose.view(), secondTangents.view(), 1.0f, 2.0f, splinePose.view());
+		checkResult(posesMatch(splinePose, secondPose), "Spline at second key");
+
+		// Evenly spaced keys turning around one axis and moving along one line leave the spline nothing to smooth out,
+		// so between the keys it has to match the linear blend
+		const float evenAmounts[] = { 0.0f, 30.0f, 60.0f, 90.0f };
+		checkSplineSamples(evenAmounts, 0.25f, nullptr, "Spline through evenly spaced keys");
+
+		// Unevenly spaced keys at 0, 20, 80 and 90. Halfway between the middle two keys the SQUAD control points are at
+		// 10 and 92.5 degrees, which puts the rotation at 50.625 degrees, and the Catmull-Rom tangents of 40 and 35 a
+		// second put the translation at 50.625 as well. The linear blend would give 50.
+		const float unevenAmounts[] = { 0.0f, 20.0f, 80.0f, 90.0f };
+		const float unevenExpected = 50.625f;
+		checkSplineSamples(unevenAmounts, 0.5f, &unevenExpected, "Spline between unevenly spaced keys");
+	}
+
+	void testTracks()
+	{
+		TestPose firstPose(2);
+		TestPose secondPose(2);
+		secondPose.rotations[1] = axisAngle(upVector, halfPi);
+		secondPose.translations[1] = Vector3{ 0.0f, 3.0f, 0.0f };
+		const ConstPoseView poses[] = { firstPose.view(), secondPose.view() };
+
+		Vector3 positionKeys[2];
+		Quat rotationKeys[2];
+		gatherBoneTrack(poses, 2, 1, positionKeys, rotationKeys);
+		checkResult(vectorsMatch(positionKeys[1], Vector3{ 0.0f, 3.0f, 0.0f }) && rotationsMatch(rotationKeys[1], axisAngle(upVector, halfPi)),
+			"Gather bone track");
+
+		float maxError;
+		checkResult(!isConstantPositionTrack(positionKeys, 2, 1.0f, maxError), "Moving position track");
+		checkResult(isConstantPositionTrack(positionKeys, 2, 5.0f, maxError) && std::fabs(maxError - 3.0f) < 1e-4f, "Constant position track");
+		checkResult(!isConstantRotationTrack(rotationKeys, 2, 10.0f, maxError), "Moving rotation track");
+		checkResult(isConstantRotationTrack(rotationKeys, 2, 95.0f, maxError) && std::fabs(maxError - 90.0f) < 1e-2f, "Constant rotation track");
+	}
+}
+
+int main()
+{
+	testMathTypes();
+	testControllerMath();
+	testTimelineSearch();
+	testBlending();
+	testSplines();
+	testTracks();
+
+	std::printf("Pose math core tests %s, %d failed\n", numFailures == 0 ? "passed" : "FAILED", numFailures);
+	return numFailures == 0 ? 0 : 1;
+}